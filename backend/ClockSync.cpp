@@ -0,0 +1,83 @@
+#include "ClockSync.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+int64_t ClockSync::nowUs(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ClockSync::reset(){
+    std::lock_guard<std::mutex> lk(mtx_);
+    samples_.clear();
+    valid_ = false;
+    offset_ = drift_ = 0;
+    bestRtt_ = 0;
+}
+
+void ClockSync::add(int64_t sendUs, uint32_t boardUs, int64_t recvUs){
+    if (recvUs < sendUs || recvUs - sendUs > kMaxRttUs) return;
+    std::lock_guard<std::mutex> lk(mtx_);
+    Sample s;
+    s.hostUs = sendUs + (recvUs - sendUs) / 2;
+    s.rttUs = (uint32_t)(recvUs - sendUs);
+    if (samples_.empty()) s.boardUs = boardUs;
+    else {
+        const Sample &last = samples_.back();
+        s.boardUs = last.boardUs + (int32_t)(boardUs - (uint32_t)last.boardUs);
+    }
+    samples_.push_back(s);
+    if (samples_.size() > kWindow) samples_.pop_front();
+    fit();
+}
+
+// The better half of the window by round trip (at least 3 samples), then
+// offset = board - host as a line over host time.
+void ClockSync::fit(){
+    std::vector<Sample> best(samples_.begin(), samples_.end());
+    std::sort(best.begin(), best.end(), [](const Sample &a, const Sample &b){ return a.rttUs < b.rttUs; });
+    best.resize(std::max<size_t>(std::min<size_t>(best.size(), 3), best.size() / 2));
+    bestRtt_ = best.front().rttUs;
+    x0_ = samples_.back().hostUs;
+
+    int64_t lo = best.front().hostUs, hi = lo;
+    for (const auto &s : best) { lo = std::min(lo, s.hostUs); hi = std::max(hi, s.hostUs); }
+    drift_ = 0;
+    offset_ = (double)(best.front().boardUs - best.front().hostUs);
+    if (best.size() >= 3 && hi - lo >= kMinSpanUs){
+        double n = (double)best.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (const auto &s : best){
+            double x = (double)(s.hostUs - x0_), y = (double)(s.boardUs - s.hostUs);
+            sx += x; sy += y; sxx += x * x; sxy += x * y;
+        }
+        double den = n * sxx - sx * sx;
+        double b = den > 0 ? (n * sxy - sx * sy) / den : 0;
+        if (std::fabs(b) <= kMaxDrift){
+            drift_ = b;
+            offset_ = (sy - b * sx) / n;
+        }
+    }
+    valid_ = true;
+}
+
+bool ClockSync::toBoard(int64_t hostUs, uint32_t &boardUs) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!valid_) return false;
+    double board = (double)hostUs + offset_ + drift_ * (double)(hostUs - x0_);
+    boardUs = (uint32_t)(uint64_t)(int64_t)std::llround(board);
+    return true;
+}
+
+ClockSync::Estimate ClockSync::estimate() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    Estimate e;
+    if (!valid_) return e;
+    e.valid = true;
+    int64_t now = nowUs();
+    e.offsetUs = std::llround(offset_ + drift_ * (double)(now - x0_));
+    e.driftPpm = drift_ * 1e6;
+    e.uncertaintyUs = bestRtt_ / 2;
+    e.samples = (int)samples_.size();
+    return e;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Maps the host's steady clock onto a board's micros(), NTP style. A TIME
+// round trip gives (host send, board time, host receive); the board read its
+// clock somewhere in between, at the midpoint if the link is symmetric, so a
+// sample is good to half its round trip. Offset and drift come from a
+// least-squares line through the recent samples with the shortest round
+// trips (the ones queueing delayed least); until the samples span a few
+// seconds only the offset of the best one is used.
+//
+// Board times are unwrapped from 32 bits against the previous sample, so
+// samples must come less than ~35 min apart. reset() after the board may
+// have restarted its clock.
+class ClockSync {
+public:
+    struct Estimate {
+        bool valid = false;
+        int64_t offsetUs = 0;           // board - host, now
+        double driftPpm = 0;            // board clock rate error
+        uint32_t uncertaintyUs = 0;     // half the best round trip in the window
+        int samples = 0;
+    };
+
+    static constexpr size_t kWindow = 32;
+    static constexpr uint32_t kMaxRttUs = 50000;        // slower answers say nothing
+    static constexpr int64_t kMinSpanUs = 5000000;      // history needed to fit drift
+    static constexpr double kMaxDrift = 0.005;          // beyond this the fit is noise
+
+    static int64_t nowUs();     // host steady clock, the scale of every host time here
+
+    void reset();
+    void add(int64_t sendUs, uint32_t boardUs, int64_t recvUs);
+    // Board micros() at host time `hostUs`; false before the first sample.
+    bool toBoard(int64_t hostUs, uint32_t &boardUs) const;
+    Estimate estimate() const;
+
+private:
+    struct Sample {
+        int64_t hostUs;         // midpoint of the round trip
+        int64_t boardUs;        // unwrapped
+        uint32_t rttUs;
+    };
+
+    void fit();     // caller holds mtx_
+
+    mutable std::mutex mtx_;
+    std::deque<Sample> samples_;
+    // board = host + offset_ + drift_ * (host - x0_)
+    int64_t x0_ = 0;
+    double offset_ = 0, drift_ = 0;
+    uint32_t bestRtt_ = 0;
+    bool valid_ = false;
+};
@@ -0,0 +1,49 @@
+#include "CommandCoalescer.hpp"
+
+CommandCoalescer::CommandCoalescer(int motors, Sender send): send_(std::move(send)), slots_(motors) {}
+
+std::future<bool> CommandCoalescer::submit(const MotorCommand &cmd){
+    auto waiter = std::make_shared<std::promise<bool>>();
+    auto f = waiter->get_future();
+    ++submitted_;
+    if (cmd.id < 1 || cmd.id > (int)slots_.size()) { waiter->set_value(false); return f; }
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    Slot &s = slots_[cmd.id - 1];
+    if (cmd.action == MotorAction::Set && !s.queue.empty() && s.queue.back().cmd.action == MotorAction::Set){
+        // Latest wins: the older SET never reaches the link, its caller gets the newer one's outcome.
+        Pending &last = s.queue.back();
+        last.cmd = cmd;
+        last.waiters.push_back(std::move(waiter));
+        ++coalesced_;
+        return f;
+    }
+    s.queue.push_back(Pending{cmd, {std::move(waiter)}});
+    pump(cmd.id, lk);
+    return f;
+}
+
+void CommandCoalescer::pump(int id, std::unique_lock<std::mutex> &lk){
+    Slot &s = slots_[id - 1];
+    if (s.busy || s.queue.empty()) return;
+    Pending p = std::move(s.queue.front());
+    s.queue.pop_front();
+    s.busy = true;
+    ++sent_;
+    lk.unlock();
+    // The callback may run on the serial reader thread; it hands the slot to the next command.
+    send_(p.cmd, [this, id, waiters = std::move(p.waiters)](bool ok){
+        for (const auto &w : waiters) w->set_value(ok);
+        std::unique_lock<std::mutex> relk(mtx_);
+        slots_[id - 1].busy = false;
+        pump(id, relk);
+    });
+}
+
+CommandCoalescer::Stats CommandCoalescer::stats() const {
+    Stats st;
+    st.submitted = submitted_.load();
+    st.coalesced = coalesced_.load();
+    st.sent = sent_.load();
+    return st;
+}
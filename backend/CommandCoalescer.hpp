@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Protocol.hpp"
+
+// Per-motor latest-wins stage in front of the serial writer. Each motor has
+// at most one command on the link; commands arriving meanwhile wait in a
+// per-motor FIFO. A SET that lands behind another waiting SET replaces it
+// (the superseded caller then waits on, and is answered with, the newer
+// one), so a slider drag costs one round-trip however fast it sends. START/STOP are never merged or reordered.
+class CommandCoalescer {
+public:
+    // `send` puts one command on the link and calls `done(ok)` when it is acked or expires.
+    using Sender = std::function<void(const MotorCommand&, std::function<void(bool)> done)>;
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t coalesced = 0;     // SETs replaced by a newer one before they were sent
+        uint64_t sent = 0;
+    };
+
+    CommandCoalescer(int motors, Sender send);
+
+    // ids are 1-based. Resolves true when the command (or the SET that superseded it) was accepted.
+    std::future<bool> submit(const MotorCommand &cmd);
+
+    Stats stats() const;
+
+private:
+    struct Pending {
+        MotorCommand cmd;
+        std::vector<std::shared_ptr<std::promise<bool>>> waiters;  // its caller, then those of the SETs it replaced
+    };
+    struct Slot {
+        bool busy = false;          // a command for this motor is on the link
+        std::deque<Pending> queue;
+    };
+
+    void pump(int id, std::unique_lock<std::mutex> &lk);   // sends the head of slot id if idle
+
+    Sender send_;
+    std::mutex mtx_;
+    std::vector<Slot> slots_;
+
+    std::atomic<uint64_t> submitted_{0}, coalesced_{0}, sent_{0};
+};
@@ -0,0 +1,316 @@
+#include "ControllerPool.hpp"
+#include "Log.hpp"
+#include "WireProtocol.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <thread>
+
+static_assert(ControllerPool::kMaxBatchPerPort == WIRE_MAX_ITEMS, "one batch frame per port");
+
+bool ControllerPool::loadConfig(const std::string &path, const PortConfig &defaults, std::vector<PortConfig> &out, std::string &err){
+    std::ifstream in(path);
+    if (!in) { err = "cannot open " + path; return false; }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)){
+        ++lineNo;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ls(line);
+        PortConfig pc = defaults;
+        std::string ids, opt;
+        if (!(ls >> pc.device)) continue;   // blank or comment
+        int first = 0, last = 0;
+        char dash = 0;
+        if (!(ls >> ids) || !(std::istringstream(ids) >> first >> dash >> last) || dash != '-'){
+            err = path + ":" + std::to_string(lineNo) + ": expected <device> <first>-<last>";
+            return false;
+        }
+        pc.firstId = first;
+        pc.count = last - first + 1;
+        while (ls >> opt){
+            if (opt.rfind("baud=", 0) == 0) pc.baud = std::atoi(opt.c_str() + 5);
+            else if (opt.rfind("maxbaud=", 0) == 0) pc.maxBaud = std::atoi(opt.c_str() + 8);
+            else if (opt == "protocol=ascii") pc.preferBinary = false;
+            else if (opt == "protocol=binary") pc.preferBinary = true;
+            else { err = path + ":" + std::to_string(lineNo) + ": unknown option " + opt; return false; }
+        }
+        out.push_back(pc);
+    }
+    if (out.empty()) { err = path + ": no ports"; return false; }
+    return validate(out, err);
+}
+
+bool ControllerPool::validate(const std::vector<PortConfig> &ports, std::string &err){
+    std::vector<bool> used(kMaxId + 1, false);
+    for (const auto &pc : ports){
+        std::string where = pc.device + " " + std::to_string(pc.firstId) + "-" + std::to_string(pc.firstId + pc.count - 1);
+        if (pc.count < 1 || pc.count > kMaxMotorsPerPort) { err = where + ": 1.." + std::to_string(kMaxMotorsPerPort) + " motors per port"; return false; }
+        if (pc.firstId < 1 || pc.firstId + pc.count - 1 > kMaxId) { err = where + ": ids must be in 1.." + std::to_string(kMaxId); return false; }
+        for (int id = pc.firstId; id < pc.firstId + pc.count; ++id){
+            if (used[id]) { err = where + ": id " + std::to_string(id) + " is already mapped"; return false; }
+            used[id] = true;
+        }
+    }
+    return true;
+}
+
+ControllerPool::ControllerPool(std::vector<PortConfig> ports): cfg_(std::move(ports)) {
+    int maxId = 0;
+    for (const auto &pc : cfg_) maxId = std::max(maxId, pc.firstId + pc.count - 1);
+    map_.assign(maxId + 1, Slot{});
+    for (size_t p = 0; p < cfg_.size(); ++p){
+        ctrls_.push_back(std::make_unique<MotorController>(cfg_[p].count));
+        for (int i = 0; i < cfg_[p].count; ++i) map_[cfg_[p].firstId + i] = Slot{(int)p, i + 1};
+    }
+}
+
+int ControllerPool::connect(){
+    // Each connect waits up to a few seconds for READY; do them side by side.
+    std::vector<std::thread> th;
+    for (size_t p = 0; p < ctrls_.size(); ++p)
+        th.emplace_back([this, p]{ ctrls_[p]->connect(cfg_[p].device, cfg_[p].baud, cfg_[p].preferBinary, cfg_[p].maxBaud); });
+    for (auto &t : th) t.join();
+    int n = 0;
+    for (size_t p = 0; p < ctrls_.size(); ++p){
+        if (ctrls_[p]->connected()) ++n;
+        else LOG_ERROR("pool", "port %zu (%s) not connected; motors %d-%d unavailable until it answers", p, cfg_[p].device.c_str(),
+                       cfg_[p].firstId, cfg_[p].firstId + cfg_[p].count - 1);
+    }
+    return n;
+}
+
+// Every port, connected or not: a port that comes up later gets reconciled too.
+void ControllerPool::startReconciler(int intervalMs){
+    std::vector<std::thread> th;
+    for (auto &c : ctrls_) th.emplace_back([&c, intervalMs]{ c->startReconciler(intervalMs); });
+    for (auto &t : th) t.join();
+}
+
+void ControllerPool::supervise(MotorController::LinkPolicy policy){
+    for (auto &c : ctrls_) c->supervise(policy);
+}
+
+void ControllerPool::setOnLink(std::function<void(size_t, bool, int64_t)> cb){
+    for (size_t p = 0; p < ctrls_.size(); ++p)
+        ctrls_[p]->setOnLink([cb, p](bool up, int64_t outageMs){ cb(p, up, outageMs); });
+}
+
+void ControllerPool::probe(int count){
+    std::vector<std::thread> th;
+    for (auto &c : ctrls_)
+        if (c->connected()) th.emplace_back([&c, count]{ c->probe(count); });
+    for (auto &t : th) t.join();
+}
+
+void ControllerPool::setOnChange(std::function<void()> cb){
+    for (auto &c : ctrls_) c->setOnChange(cb);
+}
+
+void ControllerPool::setClockSync(int periodMs){
+    for (auto &c : ctrls_) c->setClockSync(periodMs);
+}
+
+void ControllerPool::setJournal(Journal *journal){
+    for (size_t p = 0; p < ctrls_.size() && p < Journal::kMaxPorts; ++p){
+        journal->setPort(p, cfg_[p].device, cfg_[p].baud, cfg_[p].firstId, cfg_[p].count);
+        ctrls_[p]->setJournal(journal, (uint8_t)p);
+    }
+}
+
+bool ControllerPool::read(int id, MotorSnapshot &out) const {
+    if (!has(id)) return false;
+    const Slot &s = map_[id];
+    if (!ctrls_[s.port]->state().read(s.local, out)) return false;
+    out.id = id;
+    return true;
+}
+
+std::vector<MotorSnapshot> ControllerPool::readAll() const {
+    std::vector<MotorSnapshot> v;
+    MotorSnapshot m;
+    for (int id = 1; id <= size(); ++id) if (read(id, m)) v.push_back(m);
+    return v;
+}
+
+uint64_t ControllerPool::version() const {
+    uint64_t v = 0;
+    for (const auto &c : ctrls_) v += c->state().version();
+    return v;
+}
+
+bool ControllerPool::linkFresh(int64_t nowMs) const {
+    for (const auto &c : ctrls_) if (!c->linkFresh(nowMs)) return false;
+    return !ctrls_.empty();
+}
+
+int64_t ControllerPool::lastSyncMs() const {
+    int64_t oldest = 0;
+    for (const auto &c : ctrls_){
+        int64_t s = c->lastSyncMs();
+        if (!s) return 0;
+        oldest = oldest ? std::min(oldest, s) : s;
+    }
+    return oldest;
+}
+
+const char *ControllerPool::protocolName() const {
+    bool bin = false, ascii = false;
+    for (const auto &c : ctrls_){
+        if (!c->connected()) continue;
+        (c->binaryProtocol() ? bin : ascii) = true;
+    }
+    return bin && ascii ? "mixed" : bin ? "binary" : "ascii";
+}
+
+bool ControllerPool::start(int id, int speedPercent, Direction dir){
+    if (!has(id)) return false;
+    return ctrls_[map_[id].port]->start(map_[id].local, speedPercent, dir);
+}
+
+bool ControllerPool::stop(int id){
+    if (!has(id)) return false;
+    return ctrls_[map_[id].port]->stop(map_[id].local);
+}
+
+bool ControllerPool::set(int id, int speedPercent, Direction dir){
+    if (!has(id)) return false;
+    return ctrls_[map_[id].port]->set(map_[id].local, speedPercent, dir);
+}
+
+bool ControllerPool::fitsBatch(const std::vector<MotorCommand> &cmds) const {
+    std::vector<size_t> perPort(ctrls_.size());
+    for (const auto &c : cmds)
+        if (has(c.id) && ++perPort[map_[c.id].port] > kMaxBatchPerPort) return false;
+    return true;
+}
+
+bool ControllerPool::batch(const std::vector<MotorCommand> &cmds){
+    auto p = std::make_shared<std::promise<bool>>();
+    auto f = p->get_future();
+    batch(cmds, 800, [p](bool ok){ p->set_value(ok); });
+    return f.get();
+}
+
+void ControllerPool::batch(const std::vector<MotorCommand> &cmds, int timeoutMs, std::function<void(bool)> done){
+    fanOut(cmds, false, 0, timeoutMs, std::move(done));
+}
+
+bool ControllerPool::batchAt(const std::vector<MotorCommand> &cmds, int64_t atUs){
+    auto p = std::make_shared<std::promise<bool>>();
+    auto f = p->get_future();
+    fanOut(cmds, true, atUs, 800, [p](bool ok){ p->set_value(ok); });
+    return f.get();
+}
+
+void ControllerPool::fanOut(const std::vector<MotorCommand> &cmds, bool timed, int64_t atUs, int timeoutMs,
+                            std::function<void(bool)> done){
+    std::vector<std::vector<MotorCommand>> perPort(ctrls_.size());
+    for (const auto &c : cmds){
+        if (!has(c.id)) { done(false); return; }
+        MotorCommand local = c;
+        local.id = map_[c.id].local;
+        perPort[map_[c.id].port].push_back(local);
+    }
+
+    // One frame per port: the firmware validates it as a whole and applies
+    // it in one pass, which several frames could not promise.
+    std::vector<std::pair<size_t, std::vector<MotorCommand>>> frames;
+    for (size_t p = 0; p < perPort.size(); ++p){
+        if (perPort[p].size() > kMaxBatchPerPort) { done(false); return; }
+        if (!perPort[p].empty()) frames.emplace_back(p, std::move(perPort[p]));
+    }
+    if (frames.empty()) { done(true); return; }
+
+    struct Join {
+        std::atomic<size_t> left;
+        std::atomic<bool> ok{true};
+        std::function<void(bool)> done;
+    };
+    auto join = std::make_shared<Join>();
+    join->left = frames.size();
+    join->done = std::move(done);
+    for (auto &f : frames){
+        auto part = [join](bool ok){
+            if (!ok) join->ok = false;
+            if (join->left.fetch_sub(1) == 1) join->done(join->ok.load());
+        };
+        if (timed) ctrls_[f.first]->batchAt(f.second, atUs, timeoutMs, part);
+        else ctrls_[f.first]->batch(f.second, timeoutMs, part);
+    }
+}
+
+std::optional<std::string> ControllerPool::status(){
+    std::optional<std::string> first;
+    for (auto &c : ctrls_){
+        if (!c->connected()) return std::nullopt;
+        auto s = c->status();
+        if (!s) return std::nullopt;
+        if (!first) first = s;
+    }
+    return first;
+}
+
+CommandCoalescer::Stats ControllerPool::coalescerStats() const {
+    CommandCoalescer::Stats sum;
+    for (const auto &c : ctrls_){
+        auto s = c->coalescerStats();
+        sum.submitted += s.submitted; sum.coalesced += s.coalesced; sum.sent += s.sent;
+    }
+    return sum;
+}
+
+std::string ControllerPool::healthJson(int64_t now) const {
+    std::string out = "[";
+    for (size_t p = 0; p < ctrls_.size(); ++p){
+        const MotorController &c = *ctrls_[p];
+        const PortConfig &pc = cfg_[p];
+        int64_t reply = c.lastReplyMs(), sync = c.lastSyncMs();
+        auto st = c.coalescerStats();
+        if (p) out += ",";
+        out += "{\"port\":" + std::to_string(p)
+             + ",\"device\":\"" + pc.device + "\""
+             + ",\"ids\":\"" + std::to_string(pc.firstId) + "-" + std::to_string(pc.firstId + pc.count - 1) + "\""
+             + ",\"connected\":" + (c.connected() ? "true" : "false")
+             + ",\"protocol\":\"" + (c.binaryProtocol() ? "binary" : "ascii") + "\""
+             + ",\"fresh\":" + (c.linkFresh(now) ? "true" : "false")
+             + ",\"last_reply_ms\":" + std::to_string(reply ? now - reply : -1)
+             + ",\"stale_ms\":" + std::to_string(sync ? now - sync : -1)
+             + ",\"queued\":" + std::to_string(c.queued())
+             + ",\"in_flight\":" + std::to_string(c.inFlight())
+             + ",\"commands\":" + std::to_string(st.submitted)
+             + ",\"coalesced\":" + std::to_string(st.coalesced)
+             + ",\"baud\":" + std::to_string(c.baud())
+             + ",\"link_downs\":" + std::to_string(c.linkDowns())
+             + ",\"down_ms\":" + std::to_string(c.downSinceMs() ? now - c.downSinceMs() : -1)
+             + ",\"last_outage_ms\":" + std::to_string(c.lastOutageMs())
+             + ",\"held\":" + std::to_string(c.held())
+             + ",\"clock\":";
+        ClockSync::Estimate ce = c.clock();
+        if (ce.valid){
+            char drift[32];
+            std::snprintf(drift, sizeof(drift), "%.1f", ce.driftPpm);
+            out += "{\"offset_us\":" + std::to_string(ce.offsetUs)
+                 + ",\"drift_ppm\":" + drift
+                 + ",\"uncertainty_us\":" + std::to_string(ce.uncertaintyUs)
+                 + ",\"samples\":" + std::to_string(ce.samples) + "}";
+        } else out += "null";
+        out += ",\"probe\":";
+        LinkProbe lp = c.lastProbe();
+        if (!lp.atMs) { out += "null}"; continue; }
+        char rate[32];
+        std::snprintf(rate, sizeof(rate), "%.1f", lp.commandsPerSec);
+        out += "{\"commands\":" + std::to_string(lp.commands)
+             + ",\"lost\":" + std::to_string(lp.lost)
+             + ",\"rtt_us\":" + std::to_string(lp.rttUs)
+             + ",\"rtt_max_us\":" + std::to_string(lp.rttMaxUs)
+             + ",\"commands_per_s\":" + rate
+             + ",\"baud\":" + std::to_string(lp.baud)
+             + ",\"age_ms\":" + std::to_string(now - lp.atMs) + "}}";
+    }
+    return out + "]";
+}
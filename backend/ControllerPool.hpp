@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "MotorController.hpp"
+
+// One serial port of the pool: `count` motors with global ids
+// firstId..firstId+count-1, local ids 1..count on the board.
+struct PortConfig {
+    std::string device;
+    int baud = 115200;
+    int maxBaud = 0;            // negotiate up to this rate; 0 stays at `baud`
+    bool preferBinary = true;
+    int firstId = 1;
+    int count = 9;
+};
+
+// Several MotorControlNine boards behind one global motor id space. Each
+// port is a MotorController with its own I/O threads, command queue,
+// coalescer and shadow table; the pool only translates ids and fans commands
+// out. A batch is split per port, one frame each, and sent to all ports at
+// once, so the ports' round-trips overlap. Atomicity holds per port only; a
+// batch with more than kMaxBatchPerPort commands for one port is refused
+// rather than split across frames. batchAt() gets
+// the ports to act together anyway, each at the same instant on its own
+// board clock.
+class ControllerPool {
+public:
+    static constexpr int kMaxMotorsPerPort = 9;    // two PCA9685s per board
+    static constexpr int kMaxId = 1024;
+    static constexpr size_t kMaxBatchPerPort = 16;  // WIRE_MAX_ITEMS: one frame per port
+
+    // Config file, one port per line ('#' starts a comment):
+    //   <device> <first>-<last> [baud=<n>] [maxbaud=<n>] [protocol=binary|ascii]
+    // e.g. "/dev/ttyACM1 10-18 protocol=ascii". Options not given come from `defaults`.
+    static bool loadConfig(const std::string &path, const PortConfig &defaults, std::vector<PortConfig> &out, std::string &err);
+    // Ids must be in 1..kMaxId, at most kMaxMotorsPerPort per port, not overlapping.
+    static bool validate(const std::vector<PortConfig> &ports, std::string &err);
+
+    explicit ControllerPool(std::vector<PortConfig> ports);
+
+    // Opens all ports in parallel; returns how many connected. Ports that
+    // failed stay in the pool and report connected=false.
+    int connect();
+    void startReconciler(int intervalMs);
+    // Link supervisor on every port (MotorController::supervise), after connect().
+    void supervise(MotorController::LinkPolicy policy);
+    // Link down/up per port, from the supervisor threads; before supervise().
+    void setOnLink(std::function<void(size_t port, bool up, int64_t outageMs)> cb);
+    // Link probe (MotorController::probe) on every connected port at once.
+    void probe(int count);
+    void setOnChange(std::function<void()> cb);   // before connect()
+    void setJournal(Journal *journal);            // before connect(); records carry the port index
+    void setClockSync(int periodMs);              // before connect(); MotorController::setClockSync
+
+    int size() const { return (int)map_.size() - 1; }    // highest global id
+    bool has(int id) const { return id >= 1 && id <= size() && map_[id].port >= 0; }
+    size_t ports() const { return ctrls_.size(); }
+    const MotorController &port(size_t i) const { return *ctrls_[i]; }
+    const PortConfig &portConfig(size_t i) const { return cfg_[i]; }
+
+    // Shadow state in global ids.
+    bool read(int id, MotorSnapshot &out) const;
+    std::vector<MotorSnapshot> readAll() const;
+    uint64_t version() const;                   // moves whenever any port's table changes
+
+    bool linkFresh(int64_t nowMs) const;        // every port answered recently
+    bool linkUp(int id) const { return has(id) && ctrls_[map_[id].port]->connected(); }
+    bool clockSynced(int id) const { return has(id) && ctrls_[map_[id].port]->clockSynced(); }
+    int64_t lastSyncMs() const;                 // oldest reconcile over the ports, 0 = some never
+    const char *protocolName() const;           // "binary", "ascii" or "mixed"
+
+    bool start(int id, int speedPercent, Direction dir);
+    bool stop(int id);
+    bool set(int id, int speedPercent, Direction dir);
+    // False if some port would get more than kMaxBatchPerPort of `cmds`.
+    bool fitsBatch(const std::vector<MotorCommand> &cmds) const;
+    bool batch(const std::vector<MotorCommand> &cmds);
+    // `done(ok)` runs once every port involved has answered or timed out.
+    void batch(const std::vector<MotorCommand> &cmds, int timeoutMs, std::function<void(bool)> done);
+    // Held by every board until host steady time `atUs` (ClockSync::nowUs());
+    // true once all ports involved have acked.
+    bool batchAt(const std::vector<MotorCommand> &cmds, int64_t atUs);
+
+    // Probes every port; the first reply, or nullopt if any port is silent.
+    std::optional<std::string> status();
+
+    CommandCoalescer::Stats coalescerStats() const;     // summed over the ports
+
+    // [{"port":0,"device":..,"ids":"1-9","connected":..,"protocol":..,"fresh":..,
+    //   "last_reply_ms":..,"stale_ms":..,"queued":..,"in_flight":..,"commands":..,"coalesced":..,
+    //   "baud":..,"link_downs":..,"down_ms":..,"last_outage_ms":..,"held":..,
+    //   "clock":{"offset_us":..,"drift_ppm":..,"uncertainty_us":..,"samples":..}|null,
+    //   "probe":{"commands":..,"lost":..,"rtt_us":..,"rtt_max_us":..,"commands_per_s":..,
+    //   "baud":..,"age_ms":..}|null},..]   (down_ms -1 while up, last_outage_ms -1 if none)
+    std::string healthJson(int64_t nowMs) const;
+
+private:
+    struct Slot { int port = -1; int local = 0; };
+
+    // batch() and batchAt(): split per port, `done` once every port has answered.
+    void fanOut(const std::vector<MotorCommand> &cmds, bool timed, int64_t atUs, int timeoutMs, std::function<void(bool)> done);
+
+    std::vector<PortConfig> cfg_;
+    std::vector<std::unique_ptr<MotorController>> ctrls_;
+    std::vector<Slot> map_;         // indexed by global id; [0] unused
+};
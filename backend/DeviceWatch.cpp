@@ -0,0 +1,68 @@
+#include "DeviceWatch.hpp"
+#include "Log.hpp"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+static void splitPath(const std::string &path, std::string &dir, std::string &name){
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) { dir = "."; name = path; }
+    else { dir = slash ? path.substr(0, slash) : "/"; name = path.substr(slash + 1); }
+}
+
+DeviceWatch::DeviceWatch(const std::string &path): path_(path) {
+    splitPath(path_, dir_, name_);
+    splitPath(dir_, parent_, dirName_);
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0) { LOG_WARN("serial", "inotify: %s; %s is polled instead", std::strerror(errno), path_.c_str()); return; }
+    if (parent_ != dir_) parentWd_ = inotify_add_watch(fd_, parent_.c_str(), IN_CREATE | IN_MOVED_TO);
+    watchDir();
+}
+
+DeviceWatch::~DeviceWatch(){
+    if (fd_ >= 0) ::close(fd_);
+    if (wakeFd_ >= 0) ::close(wakeFd_);
+}
+
+void DeviceWatch::watchDir(){
+    if (fd_ < 0 || dirWd_ >= 0) return;
+    dirWd_ = inotify_add_watch(fd_, dir_.c_str(), IN_CREATE | IN_MOVED_TO | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM);
+}
+
+bool DeviceWatch::exists() const {
+    return ::access(path_.c_str(), F_OK) == 0;
+}
+
+void DeviceWatch::wake(){
+    uint64_t one = 1;
+    if (wakeFd_ >= 0 && ::write(wakeFd_, &one, sizeof(one)) < 0) {}
+}
+
+int DeviceWatch::wait(int timeoutMs){
+    watchDir();   // the directory may have come back without us seeing it
+    pollfd pfd[2] = {{fd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    if (poll(pfd, 2, timeoutMs) <= 0) return 0;
+    if (pfd[1].revents & POLLIN) { uint64_t n; if (::read(wakeFd_, &n, sizeof(n)) < 0) {} }
+    if (!(pfd[0].revents & POLLIN)) return 0;
+
+    int events = 0;
+    alignas(inotify_event) char buf[4096];
+    ssize_t len;
+    while ((len = ::read(fd_, buf, sizeof(buf))) > 0){
+        for (char *p = buf; p < buf + len; p += sizeof(inotify_event) + ((inotify_event *)p)->len){
+            const inotify_event *e = (const inotify_event *)p;
+            if (e->wd == dirWd_ && (e->mask & IN_IGNORED)) { dirWd_ = -1; events |= Gone; continue; }
+            if (!e->len) continue;
+            if (e->wd == parentWd_ && dirName_ == e->name) { watchDir(); if (exists()) events |= Appeared; continue; }
+            if (e->wd != dirWd_ || name_ != e->name) continue;
+            if (e->mask & (IN_DELETE | IN_MOVED_FROM)) events |= Gone;
+            else events |= Appeared;
+        }
+    }
+    return events;
+}
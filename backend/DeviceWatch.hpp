@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+// Watches one device path (a /dev/serial/by-id symlink, /dev/ttyACM0, a
+// fake_arduino link) with inotify: its directory for the entry coming and
+// going, and that directory's parent for the directory itself, which udev
+// removes together with the last device in it. Linux only.
+class DeviceWatch {
+public:
+    enum Event { Appeared = 1, Gone = 2 };
+
+    explicit DeviceWatch(const std::string &path);
+    ~DeviceWatch();
+    DeviceWatch(const DeviceWatch &) = delete;
+    DeviceWatch &operator=(const DeviceWatch &) = delete;
+
+    // Waits up to timeoutMs for changes (or wake()); returns the Event bits seen.
+    int wait(int timeoutMs);
+    // Ends a wait() from another thread.
+    void wake();
+
+    bool exists() const;
+
+private:
+    void watchDir();
+
+    std::string path_, dir_, name_, parent_, dirName_;
+    int fd_ = -1, wakeFd_ = -1;
+    int dirWd_ = -1, parentWd_ = -1;
+};
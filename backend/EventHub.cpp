@@ -0,0 +1,177 @@
+#include "EventHub.hpp"
+#include "Log.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+constexpr size_t kMaxBacklog = 256 * 1024;     // per subscriber, then it is dropped
+constexpr int kKeepAliveMs = 15000;
+
+}
+
+EventHub::EventHub() {}
+EventHub::~EventHub(){ stop(); }
+
+bool EventHub::start(){
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ < 0 || wakefd_ < 0) { LOG_ERROR("events", "epoll/eventfd: %s", std::strerror(errno)); stop(); return false; }
+    epoll_event ev{}; ev.events = EPOLLIN; ev.data.fd = wakefd_;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+    running_ = true;
+    th_ = std::thread([this]{ loop(); });
+    return true;
+}
+
+void EventHub::stop(){
+    if (running_.exchange(false) && wakefd_ >= 0){
+        uint64_t one = 1; ssize_t r = ::write(wakefd_, &one, sizeof(one)); (void)r;
+    }
+    if (th_.joinable()) th_.join();
+    for (auto &kv : subs_) ::close(kv.first);
+    subs_.clear();
+    {
+        std::lock_guard<std::mutex> lk(inboxMtx_);
+        for (auto &ns : newSubs_) ::close(ns.first);
+        newSubs_.clear(); events_.clear();
+    }
+    count_ = 0;
+    subsGauge_.set(0);
+    if (epfd_ >= 0) { ::close(epfd_); epfd_ = -1; }
+    if (wakefd_ >= 0) { ::close(wakefd_); wakefd_ = -1; }
+}
+
+std::string EventHub::format(const std::string &event, const std::string &data){
+    std::string s = "event: " + event + "\n";
+    size_t start = 0;
+    while (true){   // a data field per line, as required by the SSE format
+        size_t nl = data.find('\n', start);
+        s += "data: "; s.append(data, start, nl == std::string::npos ? std::string::npos : nl - start); s += "\n";
+        if (nl == std::string::npos) break;
+        start = nl + 1;
+    }
+    s += "\n";
+    return s;
+}
+
+void EventHub::subscribe(int fd, std::string pending){
+    if (!running_) { ::close(fd); return; }
+    {
+        std::lock_guard<std::mutex> lk(inboxMtx_);
+        newSubs_.emplace_back(fd, std::move(pending));
+    }
+    ++count_;
+    uint64_t one = 1; ssize_t r = ::write(wakefd_, &one, sizeof(one)); (void)r;
+}
+
+void EventHub::publish(const std::string &event, const std::string &data){
+    if (!running_ || count_ == 0) return;
+    {
+        std::lock_guard<std::mutex> lk(inboxMtx_);
+        events_.push_back(format(event, data));
+    }
+    uint64_t one = 1; ssize_t r = ::write(wakefd_, &one, sizeof(one)); (void)r;
+}
+
+void EventHub::loop(){
+    epoll_event events[64];
+    while (running_){
+        int n = epoll_wait(epfd_, events, 64, 1000);
+        if (n < 0) { if (errno == EINTR) continue; LOG_ERROR("events", "epoll_wait: %s", std::strerror(errno)); return; }
+        for (int i=0;i<n;++i){
+            int fd = events[i].data.fd;
+            if (fd == wakefd_){
+                uint64_t v; ssize_t r = ::read(wakefd_, &v, sizeof(v)); (void)r;
+                continue;
+            }
+            auto it = subs_.find(fd);
+            if (it == subs_.end()) continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) { drop(fd); continue; }
+            if (events[i].events & EPOLLIN){
+                // Clients do not talk on an event stream; read to detect EOF.
+                char buf[512]; ssize_t r = ::read(fd, buf, sizeof(buf));
+                if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) { drop(fd); continue; }
+            }
+            if (events[i].events & EPOLLOUT){
+                if (!flush(it->second)) { drop(fd); continue; }
+                updateInterest(it->second);
+            }
+        }
+        drainInbox();
+
+        // Only streams that had nothing for a while
+        auto now = std::chrono::steady_clock::now();
+        std::vector<int> dead;
+        for (auto &kv : subs_){
+            Sub &s = kv.second;
+            if (now - s.lastSend < std::chrono::milliseconds(kKeepAliveMs)) continue;
+            s.lastSend = now;
+            s.out += ": keep-alive\n\n";
+            if (!flush(s)) dead.push_back(kv.first); else updateInterest(s);
+        }
+        for (int fd : dead) drop(fd);
+    }
+}
+
+void EventHub::drainInbox(){
+    std::deque<std::pair<int, std::string>> subs;
+    std::deque<std::string> evs;
+    {
+        std::lock_guard<std::mutex> lk(inboxMtx_);
+        subs.swap(newSubs_);
+        evs.swap(events_);
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (auto &ns : subs){
+        Sub s; s.fd = ns.first; s.out = std::move(ns.second); s.lastSend = now;
+        epoll_event ev{}; ev.events = EPOLLIN | EPOLLRDHUP; ev.data.fd = s.fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, s.fd, &ev) < 0) { ::close(s.fd); --count_; continue; }
+        subs_[s.fd] = std::move(s);
+    }
+    subsGauge_.set((int64_t)subs_.size());
+    if (subs_.empty()) return;
+
+    std::vector<int> dead;
+    for (auto &kv : subs_){
+        Sub &s = kv.second;
+        for (auto &e : evs) s.out += e;
+        if (!evs.empty()) s.lastSend = now;
+        if (s.out.size() - s.off > kMaxBacklog || !flush(s)) { dead.push_back(kv.first); continue; }
+        updateInterest(s);
+    }
+    for (int fd : dead) drop(fd);
+}
+
+bool EventHub::flush(Sub &s){
+    while (s.off < s.out.size()){
+        ssize_t n = ::send(s.fd, s.out.data() + s.off, s.out.size() - s.off, MSG_NOSIGNAL);
+        if (n > 0) { s.off += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false;
+    }
+    s.out.clear(); s.off = 0;
+    return true;
+}
+
+void EventHub::updateInterest(Sub &s){
+    bool want = s.off < s.out.size();
+    if (want == s.wantOut) return;
+    s.wantOut = want;
+    epoll_event ev{}; ev.events = EPOLLIN | EPOLLRDHUP | (want ? (uint32_t)EPOLLOUT : 0u); ev.data.fd = s.fd;
+    epoll_ctl(epfd_, EPOLL_CTL_MOD, s.fd, &ev);
+}
+
+void EventHub::drop(int fd){
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    if (subs_.erase(fd)) --count_;
+    subsGauge_.set((int64_t)subs_.size());
+}
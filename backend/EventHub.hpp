@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include "Metrics.hpp"
+
+// Server-Sent Events fan-out. HttpServer hands a subscribed socket over to
+// the hub, after which only the hub thread touches it: published events are
+// appended to every subscriber's buffer and flushed with non-blocking writes
+// (EPOLLOUT when the socket is full). Subscribers that fall too far behind
+// or hang up are dropped. A comment line is sent as keep-alive when idle.
+class EventHub {
+public:
+    EventHub();
+    ~EventHub();
+
+    bool start();
+    void stop();
+
+    // Takes ownership of a non-blocking socket; `pending` is written first
+    // (response headers, any earlier pipelined responses, initial snapshot).
+    void subscribe(int fd, std::string pending);
+
+    // Thread-safe. Formats "event: <event>\ndata: <data>\n\n" once and queues it
+    // for every subscriber.
+    void publish(const std::string &event, const std::string &data);
+
+    size_t subscribers() const { return count_.load(); }
+
+    static std::string format(const std::string &event, const std::string &data);
+
+private:
+    struct Sub {
+        int fd = -1;
+        std::string out;
+        size_t off = 0;
+        bool wantOut = false;
+        std::chrono::steady_clock::time_point lastSend;    // last event or keep-alive queued
+    };
+
+    void loop();
+    void drainInbox();
+    bool flush(Sub &s);              // false: drop the subscriber
+    void updateInterest(Sub &s);
+    void drop(int fd);
+
+    int epfd_ = -1;
+    int wakefd_ = -1;
+    std::thread th_;
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> count_{0};
+
+    std::mutex inboxMtx_;
+    std::deque<std::pair<int, std::string>> newSubs_;
+    std::deque<std::string> events_;
+
+    std::unordered_map<int, Sub> subs_;     // hub thread only
+    metrics::Gauge &subsGauge_ = metrics::gauge("http_event_subscribers", "Open /api/events streams");
+};
@@ -0,0 +1,222 @@
+#include "HttpParser.hpp"
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMaxChunkLine = 1024;   // size + extensions, or one trailer line
+
+bool ieq(std::string_view a, std::string_view b){
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i){
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = (char)(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = (char)(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
+}
+
+// RFC 9110 token characters (method, header names).
+struct TcharTable {
+    bool ok[256] = {};
+    TcharTable(){
+        for (int c = '0'; c <= '9'; ++c) ok[c] = true;
+        for (int c = 'a'; c <= 'z'; ++c) ok[c] = ok[c - 'a' + 'A'] = true;
+        for (const char *p = "!#$%&'*+-.^_`|~"; *p; ++p) ok[(unsigned char)*p] = true;
+    }
+};
+const TcharTable kTchar;
+
+bool isTchar(char c){ return kTchar.ok[(unsigned char)c]; }
+
+// Does the comma-separated `list` contain `token` (case-insensitive)?
+bool hasToken(std::string_view list, std::string_view token){
+    while (!list.empty()){
+        size_t comma = list.find(',');
+        std::string_view t = list.substr(0, comma);
+        while (!t.empty() && (t.front() == ' ' || t.front() == '\t')) t.remove_prefix(1);
+        while (!t.empty() && (t.back() == ' ' || t.back() == '\t')) t.remove_suffix(1);
+        if (ieq(t, token)) return true;
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+size_t findCrlf(const char *buf, size_t from, size_t len){
+    std::string_view v(buf, len);
+    size_t p = v.find("\r\n", from);
+    return p == std::string_view::npos ? len : p;
+}
+
+}
+
+std::string_view HttpParser::Request::header(std::string_view name) const {
+    for (size_t i = 0; i < nheaders; ++i) if (ieq(headers[i].name, name)) return headers[i].value;
+    return {};
+}
+
+void HttpParser::reset(){
+    state_ = State::Head;
+    scanned_ = bodyStart_ = contentLength_ = pos_ = bodyLen_ = chunkLeft_ = consumed_ = 0;
+    error_ = 0;
+    nheaders_ = 0;
+    minor_ = 1;
+    keepAlive_ = true; chunked_ = false;
+}
+
+HttpParser::Status HttpParser::parse(char *buf, size_t len, Request &req){
+    if (state_ == State::Head){
+        std::string_view v(buf, len);
+        size_t p = v.find("\r\n\r\n", scanned_ >= 3 ? scanned_ - 3 : 0);
+        if (p == std::string_view::npos){
+            scanned_ = len;
+            return len > kMaxHeaderBytes ? fail(431) : Status::Incomplete;
+        }
+        size_t headEnd = p + 4;
+        if (headEnd > kMaxHeaderBytes) return fail(431);
+        if (parseHead(buf, headEnd) == Status::Error) return Status::Error;
+        bodyStart_ = headEnd;
+        if (chunked_) { state_ = State::ChunkSize; pos_ = bodyStart_; bodyLen_ = 0; }
+        else state_ = State::Body;
+    }
+    if (state_ == State::Body){
+        if (len - bodyStart_ < contentLength_) return Status::Incomplete;
+        bodyLen_ = contentLength_;
+        consumed_ = bodyStart_ + contentLength_;
+        return finish(buf, req);
+    }
+    Status s = parseChunks(buf, len);
+    return s == Status::Complete ? finish(buf, req) : s;
+}
+
+HttpParser::Status HttpParser::parseHead(const char *buf, size_t headEnd){
+    // Request line: method SP target SP HTTP/1.x CRLF
+    size_t eol = findCrlf(buf, 0, headEnd);
+    std::string_view line(buf, eol);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1) return fail(400);
+    for (size_t i = 0; i < sp1; ++i) if (!isTchar(line[i])) return fail(400);
+    for (size_t i = sp1 + 1; i < sp2; ++i) if ((unsigned char)line[i] <= ' ' || line[i] == 0x7f) return fail(400);
+    std::string_view version = line.substr(sp2 + 1);
+    if (version.size() != 8 || version.substr(0, 7) != "HTTP/1." || version[7] < '0' || version[7] > '9') return fail(400);
+
+    method_ = Span{0, (uint32_t)sp1};
+    target_ = Span{(uint32_t)(sp1 + 1), (uint32_t)(sp2 - sp1 - 1)};
+    size_t q = line.substr(0, sp2).find('?', sp1 + 1);
+    if (q == std::string_view::npos) { path_ = target_; query_ = Span{(uint32_t)sp2, 0}; }
+    else { path_ = Span{target_.off, (uint32_t)(q - target_.off)}; query_ = Span{(uint32_t)(q + 1), (uint32_t)(sp2 - q - 1)}; }
+    minor_ = version[7] - '0';
+    keepAlive_ = minor_ >= 1;
+
+    // Header fields up to the empty line
+    bool haveLength = false, haveTe = false;
+    nheaders_ = 0;
+    size_t pos = eol + 2;
+    while (pos < headEnd - 2){
+        eol = findCrlf(buf, pos, headEnd);
+        std::string_view h(buf + pos, eol - pos);
+        size_t colon = h.find(':');
+        if (colon == 0 || colon == std::string_view::npos) return fail(400);   // also rejects obs-fold
+        for (size_t i = 0; i < colon; ++i) if (!isTchar(h[i])) return fail(400);
+        size_t vb = colon + 1, ve = h.size();
+        while (vb < ve && (h[vb] == ' ' || h[vb] == '\t')) ++vb;
+        while (ve > vb && (h[ve - 1] == ' ' || h[ve - 1] == '\t')) --ve;
+        if (nheaders_ == kMaxHeaders) return fail(431);
+        headers_[nheaders_++] = {Span{(uint32_t)pos, (uint32_t)colon}, Span{(uint32_t)(pos + vb), (uint32_t)(ve - vb)}};
+
+        std::string_view name = h.substr(0, colon), value = h.substr(vb, ve - vb);
+        if (ieq(name, "Content-Length")){
+            if (value.empty() || value.size() > 15) return fail(value.empty() ? 400 : 413);
+            size_t n = 0;
+            for (char c : value) { if (c < '0' || c > '9') return fail(400); n = n * 10 + (size_t)(c - '0'); }
+            if (haveLength && n != contentLength_) return fail(400);
+            contentLength_ = n;
+            haveLength = true;
+        } else if (ieq(name, "Transfer-Encoding")){
+            if (!ieq(value, "chunked")) return fail(501);
+            haveTe = true;
+        } else if (ieq(name, "Connection")){
+            if (hasToken(value, "close")) keepAlive_ = false;
+            else if (hasToken(value, "keep-alive")) keepAlive_ = true;
+        }
+        pos = eol + 2;
+    }
+    if (haveLength && haveTe) return fail(400);    // ambiguous framing
+    if (contentLength_ > maxBody_) return fail(413);
+    chunked_ = haveTe;
+    return Status::Complete;
+}
+
+// Decodes chunks in place: data is moved down to bodyStart_ + bodyLen_, which
+// never passes pos_, so unread input is never overwritten.
+HttpParser::Status HttpParser::parseChunks(char *buf, size_t len){
+    while (true){
+        switch (state_){
+        case State::ChunkSize: {
+            size_t eol = findCrlf(buf, pos_, len);
+            if (eol == len) return len - pos_ > kMaxChunkLine ? fail(400) : Status::Incomplete;
+            if (eol - pos_ > kMaxChunkLine) return fail(400);
+            size_t n = 0, i = pos_, digits = 0;
+            for (; i < eol; ++i, ++digits){
+                char c = buf[i];
+                int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (d < 0) break;
+                if (n > (maxBody_ >> 4)) return fail(413);
+                n = n * 16 + (size_t)d;
+            }
+            if (digits == 0 || (i < eol && buf[i] != ';' && buf[i] != ' ' && buf[i] != '\t')) return fail(400);
+            if (n > maxBody_ - bodyLen_) return fail(413);
+            pos_ = eol + 2;
+            if (n == 0) { state_ = State::Trailers; break; }
+            chunkLeft_ = n;
+            state_ = State::ChunkData;
+            break;
+        }
+        case State::ChunkData: {
+            size_t avail = len - pos_ < chunkLeft_ ? len - pos_ : chunkLeft_;
+            if (bodyStart_ + bodyLen_ != pos_) std::memmove(buf + bodyStart_ + bodyLen_, buf + pos_, avail);
+            bodyLen_ += avail; pos_ += avail; chunkLeft_ -= avail;
+            if (chunkLeft_) return Status::Incomplete;
+            state_ = State::ChunkEnd;
+            break;
+        }
+        case State::ChunkEnd:
+            if (len - pos_ < 2) return Status::Incomplete;
+            if (buf[pos_] != '\r' || buf[pos_ + 1] != '\n') return fail(400);
+            pos_ += 2;
+            state_ = State::ChunkSize;
+            break;
+        case State::Trailers: {
+            // Trailer fields are read and dropped; an empty line ends the request.
+            size_t eol = findCrlf(buf, pos_, len);
+            if (eol == len) return len - pos_ > kMaxChunkLine ? fail(431) : Status::Incomplete;
+            if (eol - pos_ > kMaxChunkLine) return fail(431);
+            bool last = eol == pos_;
+            pos_ = eol + 2;
+            if (last) { consumed_ = pos_; return Status::Complete; }
+            break;
+        }
+        default:
+            return fail(400);
+        }
+    }
+}
+
+HttpParser::Status HttpParser::finish(const char *buf, Request &req){
+    req.method = view(buf, method_);
+    req.target = view(buf, target_);
+    req.path = view(buf, path_);
+    req.query = view(buf, query_);
+    req.minorVersion = minor_;
+    req.nheaders = nheaders_;
+    for (size_t i = 0; i < nheaders_; ++i) req.headers[i] = Header{view(buf, headers_[i].first), view(buf, headers_[i].second)};
+    req.body = std::string_view(buf + bodyStart_, bodyLen_);
+    req.keepAlive = keepAlive_;
+    req.chunked = chunked_;
+    size_t consumed = consumed_;
+    reset();
+    consumed_ = consumed;
+    return Status::Complete;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Incremental HTTP/1.1 request parser for one connection. Call parse() with
+// the connection's unconsumed bytes every time more arrive; work already done
+// is kept (scan position, header offsets, chunk state), so a request split
+// over many reads is scanned once. Only offsets are stored until the request
+// is complete, so the caller's buffer may move between calls; on Complete the
+// Request holds string_views into the buffer and stays valid until the
+// buffer is modified. Chunked bodies are decoded in place: chunk data is
+// moved down over the size lines, so `body` is contiguous too.
+class HttpParser {
+public:
+    static constexpr size_t kMaxHeaders = 64;
+    static constexpr size_t kMaxHeaderBytes = 16 * 1024;   // request line + headers
+
+    enum class Status { Incomplete, Complete, Error };
+
+    struct Header {
+        std::string_view name, value;
+    };
+
+    struct Request {
+        std::string_view method, target, path, query;   // query excludes '?'
+        int minorVersion = 1;                            // HTTP/1.x
+        std::array<Header, kMaxHeaders> headers{};
+        size_t nheaders = 0;
+        std::string_view body;
+        bool keepAlive = true;
+        bool chunked = false;
+
+        // Case-insensitive lookup of the first header called `name`; empty if absent.
+        std::string_view header(std::string_view name) const;
+    };
+
+    explicit HttpParser(size_t maxBody = 1 << 20): maxBody_(maxBody) {}
+
+    // `buf` starts at the first byte of the request. On Complete, consumed()
+    // is the request's length in `buf` and the parser is ready for the next one.
+    // On Error, errorStatus() is the response code (400, 413, 431, 501).
+    Status parse(char *buf, size_t len, Request &req);
+
+    size_t consumed() const { return consumed_; }
+    int errorStatus() const { return error_; }
+    void reset();
+
+private:
+    enum class State { Head, Body, ChunkSize, ChunkData, ChunkEnd, Trailers };
+    struct Span { uint32_t off = 0, len = 0; };
+
+    Status fail(int status) { error_ = status; return Status::Error; }
+    Status parseHead(const char *buf, size_t headEnd);
+    Status parseChunks(char *buf, size_t len);
+    Status finish(const char *buf, Request &req);
+    static std::string_view view(const char *buf, Span s) { return std::string_view(buf + s.off, s.len); }
+
+    size_t maxBody_;
+    State state_ = State::Head;
+    size_t scanned_ = 0;            // bytes searched for the end of the head
+    size_t bodyStart_ = 0;
+    size_t contentLength_ = 0;
+    size_t pos_ = 0;                // chunked: next raw byte to read
+    size_t bodyLen_ = 0;            // chunked: decoded bytes at bodyStart_
+    size_t chunkLeft_ = 0;
+    size_t consumed_ = 0;
+    int error_ = 0;
+
+    Span method_, target_, path_, query_;
+    int minor_ = 1;
+    std::array<std::pair<Span, Span>, kMaxHeaders> headers_{};
+    size_t nheaders_ = 0;
+    bool keepAlive_ = true, chunked_ = false;
+};
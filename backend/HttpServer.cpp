@@ -1,99 +1,409 @@
 #include "HttpServer.hpp"
+#include "Log.hpp"
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
-#include <iostream>
-#include <sstream>
-#include <fstream>
-#include <map>
+#include <cstdio>
 
-static std::string urlDecode(const std::string &s){
+namespace {
+
+constexpr size_t kReadChunk = 16384;
+constexpr size_t kMaxRequestBytes = 1 << 20;   // headers + body of a single request
+constexpr int kMaxEvents = 64;
+
+}
+
+// Per-connection state. Only the worker that received the (one-shot) event
+// touches it, so no locking is needed here. While a request is deferred to the
+// WorkQueue the task writes `apiOut` only; `park` counts the two parties
+// (I/O worker done, task done) and the second one resumes the connection.
+struct HttpServer::Conn {
+    int fd = -1;
+    std::string in;                 // unparsed inbound bytes
+    HttpParser parser{kMaxRequestBytes};
+    std::string out;                // pending response bytes
+    size_t outOff = 0;              // bytes of `out` already written
+    int fileFd = -1;                // body streamed with sendfile() after `out`
+    off_t fileOff = 0, fileEnd = 0;
+    bool closeAfterFlush = false;   // Connection: close or protocol error
+    bool peerClosed = false;
+    bool handOff = false;           // became an event-stream subscriber
+    bool deferred = false;          // an API request is on the WorkQueue
+    std::string apiOut;             // its response, written by the task
+    std::atomic<int> park{0};
+};
+
+static int hexDigit(char c){
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string urlDecode(std::string_view s){
     std::string o; o.reserve(s.size());
     for(size_t i=0;i<s.size();++i){
-        if(s[i]=='%' && i+2<s.size()){
-            int v = 0; std::stringstream ss; ss << std::hex << s.substr(i+1,2); ss >> v; o.push_back((char)v); i+=2;
+        if(s[i]=='%' && i+2<s.size() && hexDigit(s[i+1]) >= 0 && hexDigit(s[i+2]) >= 0){
+            o.push_back((char)(hexDigit(s[i+1]) * 16 + hexDigit(s[i+2]))); i+=2;
         } else if (s[i]=='+') o.push_back(' ');
         else o.push_back(s[i]);
     }
     return o;
 }
 
-static std::string guessType(const std::string &path){
-    if (path.rfind(".html")!=std::string::npos) return "text/html";
-    if (path.rfind(".js")!=std::string::npos) return "application/javascript";
-    if (path.rfind(".css")!=std::string::npos) return "text/css";
-    return "text/plain";
+static const char *statusText(int status){
+    switch(status){
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default:  return "";
+    }
+}
+
+static bool contains(std::string_view list, std::string_view token){
+    return list.find(token) != std::string_view::npos;
+}
+
+static void appendResponse(std::string &out, int status, const std::string &contentType, const std::string &body, bool keepAlive,
+                           const char *extraHeaders = ""){
+    out += "HTTP/1.1 "; out += std::to_string(status); out += ' '; out += statusText(status); out += "\r\n";
+    out += extraHeaders;
+    out += "Content-Type: "; out += contentType; out += "\r\n";
+    out += "Content-Length: "; out += std::to_string(body.size()); out += "\r\n";
+    out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    out += body;
 }
 
 HttpServer::HttpServer() {}
 HttpServer::~HttpServer(){ stop(); }
 
-bool HttpServer::start(unsigned short port, const std::string &staticDir, Handler handler){
+bool HttpServer::start(unsigned short port, const std::string &staticDir, Handler handler, int workers){
     staticDir_ = staticDir; handler_ = handler;
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ < 0) { perror("socket"); return false; }
+    if (!cache_.load(staticDir_))
+        LOG_WARN("http", "no static files from %s, serving the API only", staticDir_.c_str());
+    if (!eventsPath_.empty()) events_.start();
+    if (!apiLanes_.empty()) queue_.start(apiThreads_, apiLanes_);
+    server_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server_fd_ < 0) { LOG_ERROR("http", "socket: %s", std::strerror(errno)); return false; }
 
     int opt=1; setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
     sockaddr_in addr{}; addr.sin_family = AF_INET; addr.sin_addr.s_addr = htonl(INADDR_ANY); addr.sin_port = htons(port);
-    if (bind(server_fd_, (sockaddr*)&addr, sizeof(addr))<0){ perror("bind"); ::close(server_fd_); return false; }
-    if (listen(server_fd_, 16)<0){ perror("listen"); ::close(server_fd_); return false; }
+    if (bind(server_fd_, (sockaddr*)&addr, sizeof(addr))<0){ LOG_ERROR("http", "bind: %s", std::strerror(errno)); ::close(server_fd_); server_fd_ = -1; return false; }
+    if (listen(server_fd_, 128)<0){ LOG_ERROR("http", "listen: %s", std::strerror(errno)); ::close(server_fd_); server_fd_ = -1; return false; }
+
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ < 0 || wakefd_ < 0) { LOG_ERROR("http", "epoll/eventfd: %s", std::strerror(errno)); stop(); return false; }
+
+    // Listening socket: edge-triggered, shared by all workers; whoever wakes accepts until EAGAIN.
+    epoll_event ev{}; ev.events = EPOLLIN | EPOLLET; ev.data.ptr = &server_fd_;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, server_fd_, &ev);
+    // Wake fd: level-triggered so every worker observes shutdown.
+    epoll_event wev{}; wev.events = EPOLLIN; wev.data.ptr = &wakefd_;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &wev);
 
     running_ = true;
-    th_ = std::thread([this, port]{
-        std::cerr << "HTTP listening on http://127.0.0.1:" << port << "\n";
-        while(running_){
-            int cfd = accept(server_fd_, nullptr, nullptr);
-            if (cfd < 0) { if (running_) perror("accept"); continue; }
-            std::thread([this, cfd]{
-                char buf[8192];
-                ssize_t n = read(cfd, buf, sizeof(buf)-1);
-                if (n<=0){ ::close(cfd); return; }
-                buf[n]=0;
-                std::string req(buf);
-                std::istringstream is(req);
-                std::string method, path, version; is >> method >> path >> version;
-                std::string headers, line; std::getline(is, line); // rest of first line
-                size_t pos = req.find("\r\n\r\n");
-                std::string body = (pos!=std::string::npos) ? req.substr(pos+4) : std::string();
-
-                int status=200; std::string contentType="text/plain"; std::string out;
-
-                // API routes under /api
-                if (path.rfind("/api",0)==0 && handler_){
-                    out = handler_(method, urlDecode(path), body, status, contentType);
-                } else {
-                    std::string spath = path;
-                    if (spath=="/") spath = "/index.html";
-                    std::ifstream f(staticDir_ + spath, std::ios::binary);
-                    if (f){
-                        std::ostringstream ss; ss << f.rdbuf(); out = ss.str();
-                        contentType = guessType(spath);
+    if (workers < 1) workers = 1;
+    for (int i=0;i<workers;++i) workers_.emplace_back([this]{ workerLoop(); });
+    LOG_INFO("http", "HTTP listening on http://127.0.0.1:%u (%d workers)", (unsigned)port, workers);
+    return true;
+}
+
+void HttpServer::stop(){
+    bool wasRunning = running_.exchange(false);
+    if (wasRunning && wakefd_ >= 0) { uint64_t one = 1; ssize_t r = ::write(wakefd_, &one, sizeof(one)); (void)r; }
+    for (auto &t : workers_) if (t.joinable()) t.join();
+    workers_.clear();
+    queue_.stop();      // running tasks finish and resume their connections
+    {
+        std::lock_guard<std::mutex> lk(connMtx_);
+        for (auto &kv : conns_) { if (kv.second->fileFd >= 0) ::close(kv.second->fileFd); ::close(kv.first); }
+        conns_.clear();
+    }
+    if (server_fd_>=0) { ::close(server_fd_); server_fd_ = -1; }
+    if (epfd_>=0) { ::close(epfd_); epfd_ = -1; }
+    if (wakefd_>=0) { ::close(wakefd_); wakefd_ = -1; }
+    cache_.stop();
+    events_.stop();
+}
+
+void HttpServer::setApiLanes(std::vector<WorkQueue::Lane> lanes, Classifier classify, int threads, int deadlineMs){
+    apiLanes_ = std::move(lanes);
+    classify_ = std::move(classify);
+    apiThreads_ = threads;
+    apiDeadlineMs_ = deadlineMs;
+}
+
+void HttpServer::setEventStream(const std::string &path, std::function<std::string()> snapshot){
+    eventsPath_ = path;
+    eventsSnapshot_ = std::move(snapshot);
+}
+
+void HttpServer::workerLoop(){
+    epoll_event events[kMaxEvents];
+    while (running_){
+        int n = epoll_wait(epfd_, events, kMaxEvents, -1);
+        if (n < 0) { if (errno == EINTR) continue; LOG_ERROR("http", "epoll_wait: %s", std::strerror(errno)); break; }
+        for (int i=0;i<n && running_;++i){
+            void *p = events[i].data.ptr;
+            if (p == &wakefd_) continue;
+            if (p == &server_fd_) { acceptAll(); continue; }
+            onEvent(static_cast<Conn*>(p), events[i].events);
+        }
+    }
+}
+
+void HttpServer::acceptAll(){
+    while (true){
+        int cfd = accept4(server_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0){
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && running_) LOG_ERROR("http", "accept: %s", std::strerror(errno));
+            return;
+        }
+        int one = 1; setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto conn = std::make_unique<Conn>();
+        conn->fd = cfd;
+        Conn *c = conn.get();
+        {
+            std::lock_guard<std::mutex> lk(connMtx_);
+            conns_[cfd] = std::move(conn);
+        }
+        connGauge_.add(1);
+        epoll_event ev{}; ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT; ev.data.ptr = c;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, cfd, &ev) < 0) { LOG_ERROR("http", "epoll_ctl: %s", std::strerror(errno)); closeConn(c); }
+    }
+}
+
+void HttpServer::onEvent(Conn *c, uint32_t events){
+    if ((events & EPOLLERR) || ((events & EPOLLHUP) && !(events & EPOLLIN))) { closeConn(c); return; }
+
+    if (events & (EPOLLIN | EPOLLRDHUP)) {
+        if (!readAll(*c)) c->peerClosed = true;
+    }
+    // A sendfile() body blocks further parsing on this connection (responses must
+    // stay in order), so keep going while requests are consumed and fully flushed.
+    bool pending;
+    do {
+        bool progressed = !c->closeAfterFlush && c->fileFd < 0 && processRequests(*c);
+        if (c->handOff) { handOff(c); return; }
+        if (!flush(*c)) {
+            if (!c->deferred) { closeConn(c); return; }
+            c->peerClosed = true;   // closed once the task has let go
+            break;
+        }
+        pending = c->outOff < c->out.size() || c->fileFd >= 0;
+        if (!progressed) break;
+    } while (!pending);
+
+    if (c->deferred) {
+        if (c->park.fetch_add(1) == 1) resume(c);
+        return;
+    }
+
+    if (pending) { rearm(*c, EPOLLOUT); return; }
+    if (c->closeAfterFlush || c->peerClosed) { closeConn(c); return; }
+    rearm(*c, EPOLLIN | EPOLLRDHUP);
+}
+
+bool HttpServer::readAll(Conn &c){
+    char buf[kReadChunk];
+    while (true){
+        ssize_t n = ::read(c.fd, buf, sizeof(buf));
+        if (n > 0) {
+            c.in.append(buf, (size_t)n);
+            if (c.in.size() > kMaxRequestBytes) return true;   // processRequests rejects it
+            continue;
+        }
+        if (n == 0) return false;
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+bool HttpServer::flush(Conn &c){
+    while (c.outOff < c.out.size()){
+        ssize_t n = ::send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n > 0) { c.outOff += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false;
+    }
+    c.out.clear(); c.outOff = 0;
+
+    while (c.fileFd >= 0 && c.fileOff < c.fileEnd){
+        ssize_t n = ::sendfile(c.fd, c.fileFd, &c.fileOff, (size_t)(c.fileEnd - c.fileOff));
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false;   // includes a file truncated underneath us (n == 0)
+    }
+    if (c.fileFd >= 0) { ::close(c.fileFd); c.fileFd = -1; }
+    return true;
+}
+
+// Parses every complete request in c.in (pipelining) and queues the responses in
+// order. The parser keeps its progress across calls, so a request arriving in
+// pieces is not rescanned from the start each time.
+bool HttpServer::processRequests(Conn &c){
+    size_t off = 0;
+    while (!c.closeAfterFlush && c.fileFd < 0 && !c.handOff && !c.deferred && off < c.in.size()){
+        Request req;
+        auto st = c.parser.parse(&c.in[off], c.in.size() - off, req);
+        if (st == HttpParser::Status::Incomplete) break;
+        if (st == HttpParser::Status::Error){
+            int status = c.parser.errorStatus();
+            appendResponse(c.out, status, "text/plain", statusText(status), false);
+            c.closeAfterFlush = true;
+            break;
+        }
+        off += c.parser.consumed();
+        respond(c, req);
+        if (!req.keepAlive) c.closeAfterFlush = true;
+    }
+    if (off) c.in.erase(0, off);
+    return off != 0;
+}
+
+void HttpServer::respond(Conn &c, const Request &req){
+    if (!eventsPath_.empty() && req.method == "GET" && req.path == eventsPath_){
+        c.out += "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/event-stream\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "X-Accel-Buffering: no\r\n"
+                 "Connection: keep-alive\r\n\r\n"
+                 "retry: 2000\n\n";
+        if (eventsSnapshot_) c.out += eventsSnapshot_();
+        c.handOff = true;
+        return;
+    }
+    // API routes under /api
+    if (req.target.rfind("/api",0)==0 && handler_){
+        std::string method(req.method);
+        int lane = classify_ && queue_.running() ? classify_(method, std::string(req.target)) : -1;
+        if (lane >= 0) {
+            auto deadline = WorkQueue::Clock::now() + std::chrono::milliseconds(apiDeadlineMs_);
+            Conn *cp = &c;
+            auto admit = queue_.submit(lane, deadline,
+                [this, cp, method, target = urlDecode(req.target), body = std::string(req.body), keepAlive = req.keepAlive](bool expired){
+                    if (expired) {
+                        // Never reached the handler, so nothing went to the serial port.
+                        appendResponse(cp->apiOut, 503, "application/json", "{\"error\":\"deadline exceeded\"}", keepAlive, "Retry-After: 1\r\n");
                     } else {
-                        status = 404; out = "Not Found";
+                        int status=200; std::string contentType="text/plain";
+                        std::string out = handler_(method, target, body, status, contentType);
+                        appendResponse(cp->apiOut, status, contentType, out, keepAlive);
                     }
-                }
-
-                std::ostringstream resp;
-                resp << "HTTP/1.1 " << status << "\r\n";
-                resp << "Content-Type: " << contentType << "\r\n";
-                resp << "Content-Length: " << out.size() << "\r\n";
-                resp << "Connection: close\r\n\r\n";
-                resp << out;
-                auto s = resp.str();
-                write(cfd, s.data(), s.size());
-                ::close(cfd);
-            }).detach();
+                    if (cp->park.fetch_add(1) == 1) resume(cp);
+                });
+            if (admit == WorkQueue::Admit::Ok) { c.deferred = true; return; }
+            if (admit == WorkQueue::Admit::LaneFull)
+                appendResponse(c.out, 429, "application/json", "{\"error\":\"too many requests\"}", req.keepAlive, "Retry-After: 1\r\n");
+            else
+                appendResponse(c.out, 503, "application/json", "{\"error\":\"shutting down\"}", req.keepAlive, "Retry-After: 1\r\n");
+            return;
         }
-    });
-    return true;
+        int status=200; std::string contentType="text/plain";
+        std::string out = handler_(method, urlDecode(req.target), std::string(req.body), status, contentType);
+        appendResponse(c.out, status, contentType, out, req.keepAlive);
+        return;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    serveStatic(c, req);
+    staticLatency_.observe(std::chrono::steady_clock::now() - t0);
 }
 
-void HttpServer::stop(){
-    if (!running_) return;
-    running_ = false;
-    if (server_fd_>=0) { ::shutdown(server_fd_, SHUT_RDWR); ::close(server_fd_); server_fd_ = -1; }
-    if (th_.joinable()) th_.join();
+void HttpServer::serveStatic(Conn &c, const Request &req){
+    bool head = req.method == "HEAD";
+    if (req.method != "GET" && !head){
+        appendResponse(c.out, 501, "text/plain", "Not Implemented", req.keepAlive);
+        return;
+    }
+    auto asset = cache_.find(urlDecode(req.path));
+    if (!asset){
+        appendResponse(c.out, 404, "text/plain", "Not Found", req.keepAlive);
+        return;
+    }
+    const char *conn = req.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    // The 304 must carry the tag of the variant that would have been sent.
+    bool gz = asset->cached && !asset->gzipBody.empty() && contains(req.header("Accept-Encoding"), "gzip");
+    std::string_view ifNoneMatch = req.header("If-None-Match");
+    if (!ifNoneMatch.empty() && (ifNoneMatch == "*" || contains(ifNoneMatch, gz ? asset->gzipEtag : asset->etag))){
+        c.out += gz ? asset->gzipNotModified : asset->notModified; c.out += conn;
+        return;
+    }
+    if (asset->cached){
+        c.out += gz ? asset->gzipHeaders : asset->headers; c.out += conn;
+        if (!head) c.out += gz ? asset->gzipBody : asset->body;
+        return;
+    }
+
+    // Large file: headers go through `out`, the body is sent zero-copy from the page cache.
+    int fd = head ? -1 : ::open(asset->file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (!head && fd < 0){
+        appendResponse(c.out, 404, "text/plain", "Not Found", req.keepAlive);
+        return;
+    }
+    c.out += asset->headers; c.out += conn;
+    if (fd >= 0) { c.fileFd = fd; c.fileOff = 0; c.fileEnd = asset->size; }
+}
+
+void HttpServer::resume(Conn *c){
+    c->park = 0;
+    c->deferred = false;
+    c->out += c->apiOut;
+    c->apiOut.clear();
+    // EPOLLOUT is ready at once, so a worker picks the connection up right away.
+    rearm(*c, EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+}
+
+void HttpServer::rearm(Conn &c, uint32_t events){
+    epoll_event ev{}; ev.events = events | EPOLLET | EPOLLONESHOT; ev.data.ptr = &c;
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev) < 0) closeConn(&c);
+}
+
+// Moves the socket (and any unsent bytes) to the EventHub without closing it.
+void HttpServer::handOff(Conn *c){
+    int fd = c->fd;
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    std::string pending = c->out.substr(c->outOff);
+    {
+        std::lock_guard<std::mutex> lk(connMtx_);
+        conns_.erase(fd);
+    }
+    connGauge_.add(-1);
+    events_.subscribe(fd, std::move(pending));
+}
+
+void HttpServer::closeConn(Conn *c){
+    int fd = c->fd;
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (c->fileFd >= 0) { ::close(c->fileFd); c->fileFd = -1; }
+    std::unique_ptr<Conn> owned;
+    {
+        // Remove from the table before close() so the fd number cannot be reused under us.
+        std::lock_guard<std::mutex> lk(connMtx_);
+        auto it = conns_.find(fd);
+        if (it != conns_.end()) { owned = std::move(it->second); conns_.erase(it); }
+    }
+    if (owned) connGauge_.add(-1);
+    ::close(fd);
 }
@@ -3,22 +3,87 @@
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "StaticCache.hpp"
+#include "EventHub.hpp"
+#include "Metrics.hpp"
+#include "WorkQueue.hpp"
+#include "HttpParser.hpp"
 
 // Minimal HTTP server: serves static files and a couple of API endpoints.
+// All sockets live in one edge-triggered epoll set that a small fixed pool of
+// worker threads waits on. Connections are armed EPOLLONESHOT, so exactly one
+// worker owns a connection while it is being read, parsed or flushed.
+// HTTP/1.1 keep-alive and pipelined requests are supported. Static files come
+// from an in-memory StaticCache (ETag/304, gzip variants, sendfile for large files).
+// A GET on the event-stream path turns the connection into a Server-Sent
+// Events subscriber owned by the EventHub.
+// API requests that may block (serial round-trips) are handed to a bounded
+// WorkQueue so they never hold an I/O worker; their connection sits out of
+// the epoll set until the response is ready.
 class HttpServer {
 public:
     using Handler = std::function<std::string(const std::string& method, const std::string& path, const std::string& body, int &status, std::string &contentType)>;
+    // Lane index for an /api request, -1 to run it on the I/O worker.
+    using Classifier = std::function<int(const std::string& method, const std::string& target)>;
 
     HttpServer();
     ~HttpServer();
 
-    bool start(unsigned short port, const std::string &staticDir, Handler handler);
+    bool start(unsigned short port, const std::string &staticDir, Handler handler, int workers = 4);
     void stop();
 
+    // Serve Server-Sent Events on `path`; `snapshot` returns the initial events
+    // (already formatted, see EventHub::format) for a new subscriber.
+    void setEventStream(const std::string &path, std::function<std::string()> snapshot);
+    EventHub &events() { return events_; }
+
+    // A full lane answers 429, a request still queued after deadlineMs 503,
+    // both with Retry-After. Call before start().
+    void setApiLanes(std::vector<WorkQueue::Lane> lanes, Classifier classify, int threads, int deadlineMs);
+
 private:
+    struct Conn;
+    using Request = HttpParser::Request;
+
+    void workerLoop();
+    void acceptAll();
+    void onEvent(Conn *c, uint32_t events);
+    bool readAll(Conn &c);          // false on EOF or hard error
+    bool flush(Conn &c);            // false on hard error
+    bool processRequests(Conn &c);  // true if at least one request was consumed
+    void respond(Conn &c, const Request &req);
+    void serveStatic(Conn &c, const Request &req);
+    void rearm(Conn &c, uint32_t events);
+    void closeConn(Conn *c);
+    void handOff(Conn *c);
+    void resume(Conn *c);           // deferred response ready and the I/O worker let go
+
     int server_fd_ = -1;
-    std::thread th_;
+    int epfd_ = -1;
+    int wakefd_ = -1;
+    std::vector<std::thread> workers_;
     std::atomic<bool> running_{false};
     std::string staticDir_;
     Handler handler_;
+    StaticCache cache_;
+    EventHub events_;
+    std::string eventsPath_;
+    std::function<std::string()> eventsSnapshot_;
+
+    WorkQueue queue_;
+    std::vector<WorkQueue::Lane> apiLanes_;
+    Classifier classify_;
+    int apiThreads_ = 0;
+    int apiDeadlineMs_ = 0;
+
+    std::mutex connMtx_;
+    std::unordered_map<int, std::unique_ptr<Conn>> conns_;
+
+    metrics::Gauge &connGauge_ = metrics::gauge("http_connections", "Open HTTP connections, event streams excluded");
+    metrics::Histogram &staticLatency_ = metrics::histogram("http_request_duration_seconds",
+        "HTTP request latency by route", "method=\"GET\",route=\"static\"");
 };
@@ -0,0 +1,267 @@
+#include "Journal.hpp"
+#include "Log.hpp"
+#include "WireProtocol.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static_assert(sizeof(JournalHeader) <= Journal::kHeaderBytes, "journal header fits its page");
+
+namespace {
+
+const char kMagic[8] = {'O', 'M', 'J', 'R', 'N', 'L', 0, 0};
+
+uint8_t wireOp(const MotorCommand &m){
+    uint8_t op = m.action == MotorAction::Start ? WOP_START : m.action == MotorAction::Stop ? WOP_STOP : WOP_SET;
+    if (m.dir == Direction::CCW && m.action != MotorAction::Stop) op |= WOP_CCW;
+    return op;
+}
+
+uint8_t kindOp(SerialCommand::Kind k){
+    switch (k){
+    case SerialCommand::Kind::Status: return WOP_STATUS;
+    case SerialCommand::Kind::State: return WOP_STATE;
+    case SerialCommand::Kind::Batch: return WOP_BATCH;
+    case SerialCommand::Kind::Time: return WOP_TIME;
+    default: return 0;
+    }
+}
+
+}
+
+Journal::~Journal(){ close(); }
+
+bool Journal::create(const std::string &path, size_t records){
+    close();
+    if (records < 64) records = 64;
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0 && std::rename(path.c_str(), (path + ".1").c_str()) != 0)
+        LOG_WARN("journal", "could not keep previous %s: %s", path.c_str(), std::strerror(errno));
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) { LOG_ERROR("journal", "%s: %s", path.c_str(), std::strerror(errno)); return false; }
+    mapLen_ = kHeaderBytes + records * sizeof(JournalRecord);
+    // Reserve the blocks now: a full disk fails here, not as SIGBUS on a store later.
+    int rc = ::posix_fallocate(fd_, 0, (off_t)mapLen_);
+    if (rc == EOPNOTSUPP && ::ftruncate(fd_, (off_t)mapLen_) == 0) rc = 0;
+    if (rc != 0) { LOG_ERROR("journal", "%s: %s", path.c_str(), std::strerror(rc)); close(); return false; }
+    // Prefaulted, so the first lap does not take page faults on the hot path either.
+    map_ = ::mmap(nullptr, mapLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, 0);
+    if (map_ == MAP_FAILED) { map_ = nullptr; LOG_ERROR("journal", "mmap: %s", std::strerror(errno)); close(); return false; }
+
+    hdr_ = static_cast<JournalHeader*>(map_);
+    recs_ = reinterpret_cast<JournalRecord*>(static_cast<char*>(map_) + kHeaderBytes);
+    capacity_ = records;
+    std::memset(hdr_, 0, sizeof(*hdr_));
+    hdr_->version = kVersion;
+    hdr_->recordSize = sizeof(JournalRecord);
+    hdr_->capacity = capacity_;
+    hdr_->startMonoNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    hdr_->startRealNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(hdr_->magic, kMagic, sizeof(kMagic));   // last: marks the header complete
+    LOG_INFO("journal", "serial journal %s, %zu records (%zu KiB)", path.c_str(), records, mapLen_ / 1024);
+    return true;
+}
+
+bool Journal::openRead(const std::string &path, std::string &err){
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd_ < 0 || ::fstat(fd_, &st) != 0) { err = path + ": " + std::strerror(errno); close(); return false; }
+    if ((size_t)st.st_size < kHeaderBytes) { err = path + ": not a journal"; close(); return false; }
+    mapLen_ = (size_t)st.st_size;
+    map_ = ::mmap(nullptr, mapLen_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) { map_ = nullptr; err = "mmap: " + std::string(std::strerror(errno)); close(); return false; }
+    hdr_ = static_cast<JournalHeader*>(map_);
+    if (std::memcmp(hdr_->magic, kMagic, sizeof(kMagic)) != 0 || hdr_->version < 1 || hdr_->version > kVersion ||
+        hdr_->recordSize != sizeof(JournalRecord) || kHeaderBytes + hdr_->capacity * sizeof(JournalRecord) > mapLen_){
+        err = path + ": not a journal or unsupported version";
+        close();
+        return false;
+    }
+    recs_ = reinterpret_cast<JournalRecord*>(static_cast<char*>(map_) + kHeaderBytes);
+    capacity_ = hdr_->capacity;
+    return true;
+}
+
+void Journal::close(){
+    if (map_) ::munmap(map_, mapLen_);
+    if (fd_ >= 0) ::close(fd_);
+    map_ = nullptr; hdr_ = nullptr; recs_ = nullptr;
+    fd_ = -1; mapLen_ = 0; capacity_ = 0;
+}
+
+void Journal::setPort(size_t index, const std::string &device, int baud, int firstId, int count){
+    if (!hdr_ || index >= kMaxPorts) return;
+    JournalPort &p = hdr_->ports[index];
+    std::snprintf(p.device, sizeof(p.device), "%s", device.c_str());
+    p.baud = (uint32_t)baud;
+    p.firstId = (uint16_t)firstId;
+    p.count = (uint8_t)count;
+    if (index + 1 > hdr_->nports) hdr_->nports = (uint32_t)(index + 1);
+}
+
+// The slot's commit word is cleared before and set after the fields are
+// written, so a reader (or a crash) can never mistake a half-written slot
+// for a record. Two writers only share a slot if they are a full lap apart.
+JournalRecord *Journal::claim(uint64_t &index){
+    index = __atomic_fetch_add(&hdr_->head, 1, __ATOMIC_RELAXED);
+    JournalRecord *r = &recs_[index % capacity_];
+    __atomic_store_n(&r->commit, 0u, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release);
+    return r;
+}
+
+void Journal::publish(JournalRecord *r, uint64_t index){
+    __atomic_store_n(&r->commit, (uint32_t)(index + 1), __ATOMIC_RELEASE);
+}
+
+void Journal::command(uint8_t port, uint16_t seq, const SerialCommand &cmd, bool binary, uint64_t tNs){
+    if (!hdr_) return;
+    size_t parts = cmd.motors.empty() ? 1 : cmd.motors.size();
+    for (size_t i = 0; i < parts; ++i){
+        uint64_t index;
+        JournalRecord *r = claim(index);
+        r->tNs = tNs; r->latencyUs = 0; r->seq = seq;
+        r->dir = Out; r->kind = (uint8_t)cmd.kind; r->port = port;
+        if (cmd.motors.empty()) { r->motor = 0; r->op = kindOp(cmd.kind); r->arg = 0; }
+        else {
+            const MotorCommand &m = cmd.motors[i];
+            r->motor = (uint8_t)m.id; r->op = wireOp(m); r->arg = (uint8_t)m.speedPercent;
+        }
+        r->part = (uint8_t)i; r->parts = (uint8_t)parts;
+        r->binary = binary;
+        r->flags = cmd.timed ? kTimed : 0;
+        r->atUs = cmd.timed ? cmd.atUs : 0;
+        publish(r, index);
+    }
+}
+
+void Journal::reply(uint8_t port, uint16_t seq, const SerialCommand &cmd, const std::string &text,
+                    const proto::BinaryReply *bin, bool binary, uint64_t tNs, uint32_t latencyUs){
+    if (!hdr_) return;
+    uint64_t index;
+    JournalRecord *r = claim(index);
+    r->tNs = tNs; r->latencyUs = latencyUs; r->seq = seq;
+    r->dir = In; r->kind = (uint8_t)cmd.kind; r->port = port;
+    r->motor = cmd.kind == SerialCommand::Kind::Motor ? (uint8_t)cmd.motors.front().id : 0;
+    if (bin) { r->op = bin->status; r->arg = bin->arg; }
+    else r->op = replyStatus(text, r->arg);
+    r->part = 0; r->parts = (uint8_t)cmd.motors.size();
+    r->binary = binary;
+    int32_t lead = 0;
+    if (cmd.timed && r->op == WST_OK) proto::parseLead(bin ? proto::replyText(*bin, cmd) : text, lead);
+    r->flags = cmd.timed ? kTimed : 0;
+    r->atUs = (uint32_t)lead;
+    publish(r, index);
+}
+
+void Journal::timeout(uint8_t port, uint16_t seq, const SerialCommand &cmd, bool binary, uint64_t tNs, uint32_t latencyUs){
+    if (!hdr_) return;
+    uint64_t index;
+    JournalRecord *r = claim(index);
+    r->tNs = tNs; r->latencyUs = latencyUs; r->seq = seq;
+    r->dir = Timeout; r->kind = (uint8_t)cmd.kind; r->port = port;
+    r->motor = cmd.kind == SerialCommand::Kind::Motor ? (uint8_t)cmd.motors.front().id : 0;
+    r->op = 0; r->arg = 0;
+    r->part = 0; r->parts = (uint8_t)cmd.motors.size();
+    r->binary = binary;
+    r->flags = cmd.timed ? kTimed : 0;
+    r->atUs = 0;
+    publish(r, index);
+}
+
+std::vector<JournalRecord> Journal::records() const {
+    std::vector<JournalRecord> out;
+    if (!hdr_) return out;
+    uint64_t head = __atomic_load_n(&hdr_->head, __ATOMIC_ACQUIRE);
+    uint64_t from = head > capacity_ ? head - capacity_ : 0;
+    out.reserve((size_t)(head - from));
+    for (uint64_t i = from; i < head; ++i){
+        const JournalRecord *slot = &recs_[i % capacity_];
+        uint32_t want = (uint32_t)(i + 1);
+        if (__atomic_load_n(&slot->commit, __ATOMIC_ACQUIRE) != want) continue;
+        JournalRecord r;
+        std::memcpy(&r, slot, sizeof(r));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (__atomic_load_n(&slot->commit, __ATOMIC_RELAXED) != want) continue;   // overwritten while copying
+        out.push_back(r);
+    }
+    return out;
+}
+
+uint8_t Journal::replyStatus(const std::string &text, uint8_t &arg){
+    arg = 0;
+    if (text == "OK" || text == "STATUS OK" || text.rfind("STATE ", 0) == 0 || text.rfind("TIME ", 0) == 0) return WST_OK;
+    if (text.rfind("OK B", 0) == 0) { arg = (uint8_t)std::atoi(text.c_str() + 4); return WST_OK; }
+    if (text.rfind("OK ", 0) == 0) return WST_OK;
+    static const struct { const char *name; uint8_t status; } kErr[] = {
+        {"ERR BADFMT", WST_BADFMT}, {"ERR ID", WST_ID}, {"ERR ARGS", WST_ARGS},
+        {"ERR CMD", WST_CMD}, {"ERR CRC", WST_CRC}, {"ERR BATCH", WST_BATCH}, {"ERR FULL", WST_FULL},
+    };
+    for (const auto &e : kErr) if (text.rfind(e.name, 0) == 0) return e.status;
+    return 0xFF;
+}
+
+bool Journal::toCommand(const JournalRecord *recs, size_t n, SerialCommand &out){
+    if (n == 0) return false;
+    out = SerialCommand();
+    out.kind = (SerialCommand::Kind)recs[0].kind;
+    switch (out.kind){
+    case SerialCommand::Kind::Status:
+    case SerialCommand::Kind::State:
+    case SerialCommand::Kind::Time:
+        return true;
+    case SerialCommand::Kind::Motor:
+    case SerialCommand::Kind::Batch:
+        out.timed = recs[0].flags & kTimed;
+        out.atUs = out.timed ? recs[0].atUs : 0;
+        for (size_t i = 0; i < n; ++i){
+            MotorCommand m;
+            uint8_t op = recs[i].op & (uint8_t)~WOP_CCW;
+            m.id = recs[i].motor;
+            m.action = op == WOP_START ? MotorAction::Start : op == WOP_STOP ? MotorAction::Stop : MotorAction::Set;
+            m.speedPercent = recs[i].arg;
+            m.dir = (recs[i].op & WOP_CCW) ? Direction::CCW : Direction::CW;
+            out.motors.push_back(m);
+        }
+        return true;
+    default:
+        return false;   // raw line: text is not journaled
+    }
+}
+
+std::string Journal::describe(const JournalRecord &r){
+    char buf[128];
+    const char *dir = r.dir == Out ? "->" : r.dir == In ? "<-" : "!!";
+    switch (r.dir){
+    case Out:
+        if (r.motor) {
+            uint8_t op = r.op & (uint8_t)~WOP_CCW;
+            int n = std::snprintf(buf, sizeof(buf), "p%u %s @%u M%u %s %u %s", r.port, dir, r.seq, r.motor,
+                                  op == WOP_START ? "START" : op == WOP_STOP ? "STOP" : "SET", r.arg,
+                                  (r.op & WOP_CCW) ? "CCW" : "CW");
+            if (r.parts > 1) n += std::snprintf(buf + n, sizeof(buf) - n, " [%u/%u]", r.part + 1u, (unsigned)r.parts);
+            if (r.flags & kTimed) std::snprintf(buf + n, sizeof(buf) - n, " AT %u", r.atUs);
+        } else {
+            std::snprintf(buf, sizeof(buf), "p%u %s @%u %s", r.port, dir, r.seq,
+                          r.op == WOP_STATUS ? "STATUS" : r.op == WOP_STATE ? "STATE" : r.op == WOP_TIME ? "TIME" : "LINE");
+        }
+        break;
+    case In: {
+        int n = std::snprintf(buf, sizeof(buf), "p%u %s @%u status=%u arg=%u %u us", r.port, dir, r.seq, r.op, r.arg, r.latencyUs);
+        if (r.flags & kTimed) std::snprintf(buf + n, sizeof(buf) - n, " held, lead %d us", (int32_t)r.atUs);
+        break;
+    }
+    default:
+        std::snprintf(buf, sizeof(buf), "p%u %s @%u no reply after %u us", r.port, dir, r.seq, r.latencyUs);
+    }
+    return buf;
+}
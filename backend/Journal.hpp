@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Protocol.hpp"
+
+// One serial command or reply, 32 bytes, little-endian. This is the file
+// format; bump Journal::kVersion when it changes.
+struct JournalRecord {
+    uint64_t tNs;          // steady clock (CLOCK_MONOTONIC)
+    uint32_t latencyUs;    // In/Timeout: since the command was written
+    uint16_t seq;          // engine sequence number, pairs Out with In/Timeout
+    uint8_t  dir;          // Journal::Dir
+    uint8_t  kind;         // SerialCommand::Kind
+    uint8_t  port;         // ControllerPool port index
+    uint8_t  motor;        // local motor id, 0 = none
+    uint8_t  op;           // Out: WireOp | WOP_CCW; In: WireStatus
+    uint8_t  arg;          // Out: speed; In: reply arg (e.g. batch items applied)
+    uint8_t  part, parts;  // item index / item count of a batch (one record per item)
+    uint8_t  binary;       // link was in binary mode
+    uint8_t  flags;        // Journal::kTimed
+    uint32_t commit;       // index + 1, stored last; anything else is a torn or stale slot
+    uint32_t atUs;         // kTimed Out: board micros() it is held for; kTimed In: lead (int32)
+};
+static_assert(sizeof(JournalRecord) == 32, "journal record layout");
+
+struct JournalPort {
+    char device[104];
+    uint32_t baud;
+    uint16_t firstId;
+    uint8_t count;
+    uint8_t pad;
+};
+
+// First 4 KiB of the file.
+struct JournalHeader {
+    char magic[8];         // "OMJRNL"
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;     // record slots after the header
+    uint64_t head;         // records ever appended; slot = index % capacity
+    int64_t startMonoNs;   // clock pair taken at open(), to print wall-clock times
+    int64_t startRealNs;
+    uint32_t nports;
+    uint32_t reserved;
+    JournalPort ports[16];
+};
+
+// Flight recorder for the serial link: every command written and every
+// reply (or timeout) becomes a fixed-size record in a preallocated, mmap'd
+// ring file that wraps around when full. Appending claims a slot with one
+// atomic add on the shared head and fills it in place: no locks and no
+// syscalls, so it is safe on the engine's writer and reader threads. The
+// file survives a crash of the process; journal_replay reads it back.
+class Journal {
+public:
+    enum Dir : uint8_t { Out = 1, In = 2, Timeout = 3 };
+    enum Flags : uint8_t { kTimed = 1 };     // an AT command, held by the firmware
+    static constexpr uint32_t kVersion = 2;  // 1: no flags/atUs, still readable
+    static constexpr size_t kHeaderBytes = 4096;
+    static constexpr size_t kMaxPorts = 16;
+
+    Journal() = default;
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal &operator=(const Journal&) = delete;
+
+    // Creates `path` with room for `records`; a previous file is kept as path.1.
+    bool create(const std::string &path, size_t records);
+    // Read-only view of an existing journal (for tools).
+    bool openRead(const std::string &path, std::string &err);
+    void close();
+    bool isOpen() const { return hdr_ != nullptr; }
+
+    void setPort(size_t index, const std::string &device, int baud, int firstId, int count);
+
+    void command(uint8_t port, uint16_t seq, const SerialCommand &cmd, bool binary, uint64_t tNs);
+    // `bin` is the decoded frame in binary mode, else `text` is the ASCII reply.
+    void reply(uint8_t port, uint16_t seq, const SerialCommand &cmd, const std::string &text,
+               const proto::BinaryReply *bin, bool binary, uint64_t tNs, uint32_t latencyUs);
+    void timeout(uint8_t port, uint16_t seq, const SerialCommand &cmd, bool binary, uint64_t tNs, uint32_t latencyUs);
+
+    const JournalHeader &header() const { return *hdr_; }
+    // Committed records, oldest first.
+    std::vector<JournalRecord> records() const;
+
+    // Reply text -> WireStatus (0xFF if unrecognised) and its argument.
+    static uint8_t replyStatus(const std::string &text, uint8_t &arg);
+    // Turns consecutive Out records of one command back into it; false for raw lines.
+    static bool toCommand(const JournalRecord *recs, size_t n, SerialCommand &out);
+    static std::string describe(const JournalRecord &r);
+
+private:
+    JournalRecord *claim(uint64_t &index);
+    static void publish(JournalRecord *r, uint64_t index);
+
+    int fd_ = -1;
+    void *map_ = nullptr;
+    size_t mapLen_ = 0;
+    JournalHeader *hdr_ = nullptr;
+    JournalRecord *recs_ = nullptr;
+    uint64_t capacity_ = 0;
+};
@@ -0,0 +1,220 @@
+#include "Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <strings.h>
+#include <unistd.h>
+#include "Metrics.hpp"
+
+namespace logging {
+
+namespace {
+
+constexpr size_t kRingSize = 256;           // records per thread, power of two
+constexpr size_t kMsgBytes = 216;           // longer messages are truncated
+constexpr int kDrainMs = 20;
+
+struct Record {
+    int64_t wallUs;
+    Level level;
+    const char *tag;
+    uint32_t thread;
+    uint32_t len;
+    char msg[kMsgBytes];
+};
+
+// Single-producer/single-consumer ring: the owning thread advances head, the
+// drainer advances tail.
+struct Ring {
+    Record slots[kRingSize];
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> orphaned{false};       // owning thread exited
+    uint32_t thread = 0;
+};
+
+struct State {
+    std::mutex ringsMtx;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::atomic<uint32_t> nextThread{1};
+    std::atomic<int> level{(int)Level::Info};
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex runMtx;
+    std::condition_variable cv;
+    bool running = false;
+    std::thread drainer;
+};
+
+State &state(){
+    static State s;
+    return s;
+}
+
+// Registers the calling thread's ring on first use (the only allocation).
+struct RingHolder {
+    std::shared_ptr<Ring> ring = std::make_shared<Ring>();
+    RingHolder(){
+        State &s = state();
+        ring->thread = s.nextThread.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lk(s.ringsMtx);
+        s.rings.push_back(ring);
+    }
+    ~RingHolder(){ ring->orphaned = true; }
+};
+
+metrics::Counter &droppedTotal(){
+    static metrics::Counter &c = metrics::counter("log_dropped_total", "Log records dropped because a ring buffer was full");
+    return c;
+}
+
+Ring &myRing(){
+    thread_local RingHolder h;
+    return *h.ring;
+}
+
+void writeAll(const std::string &s){
+    size_t off = 0;
+    while (off < s.size()){
+        ssize_t n = ::write(STDERR_FILENO, s.data() + off, s.size() - off);
+        if (n <= 0) return;
+        off += (size_t)n;
+    }
+}
+
+void drainOnce(){
+    State &s = state();
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lk(s.ringsMtx);
+        rings = s.rings;
+    }
+
+    std::vector<Record> batch;
+    uint64_t dropped = 0;
+    for (auto &r : rings){
+        uint64_t t = r->tail.load(std::memory_order_relaxed);
+        uint64_t h = r->head.load(std::memory_order_acquire);
+        for (; t != h; ++t) batch.push_back(r->slots[t & (kRingSize - 1)]);
+        r->tail.store(t, std::memory_order_release);
+        dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    {
+        // Rings of exited threads go once they are empty.
+        std::lock_guard<std::mutex> lk(s.ringsMtx);
+        s.rings.erase(std::remove_if(s.rings.begin(), s.rings.end(), [](const std::shared_ptr<Ring> &r){
+            return r->orphaned && r->tail.load() == r->head.load();
+        }), s.rings.end());
+    }
+    if (batch.empty() && !dropped) return;
+
+    std::stable_sort(batch.begin(), batch.end(), [](const Record &a, const Record &b){ return a.wallUs < b.wallUs; });
+    std::string out;
+    out.reserve(batch.size() * 96);
+    char head[96];
+    for (const auto &rec : batch){
+        time_t secs = (time_t)(rec.wallUs / 1000000);
+        tm utc; gmtime_r(&secs, &utc);
+        size_t n = std::strftime(head, sizeof(head), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(head + n, sizeof(head) - n, ".%06dZ %-5s %-8s t%u ",
+                      (int)(rec.wallUs % 1000000), levelName(rec.level), rec.tag, rec.thread);
+        out += head;
+        out.append(rec.msg, rec.len);
+        out += '\n';
+    }
+    if (dropped) out += "(log) " + std::to_string(dropped) + " record(s) dropped: ring buffer full\n";
+    writeAll(out);
+}
+
+void drainLoop(){
+    State &s = state();
+    std::unique_lock<std::mutex> lk(s.runMtx);
+    while (s.running){
+        s.cv.wait_for(lk, std::chrono::milliseconds(kDrainMs), [&s]{ return !s.running; });
+        lk.unlock();
+        drainOnce();
+        lk.lock();
+    }
+}
+
+}
+
+void start(){
+    State &s = state();
+    std::lock_guard<std::mutex> lk(s.runMtx);
+    if (s.running) return;
+    s.running = true;
+    droppedTotal();     // registered up front so it is exported as 0
+    s.drainer = std::thread(drainLoop);
+}
+
+void stop(){
+    State &s = state();
+    {
+        std::lock_guard<std::mutex> lk(s.runMtx);
+        if (!s.running) return;
+        s.running = false;
+    }
+    s.cv.notify_all();
+    if (s.drainer.joinable()) s.drainer.join();
+    drainOnce();
+}
+
+void setLevel(Level l){ state().level.store((int)l, std::memory_order_relaxed); }
+Level level(){ return (Level)state().level.load(std::memory_order_relaxed); }
+bool enabled(Level l){ return (int)l >= state().level.load(std::memory_order_relaxed); }
+uint64_t dropped(){ return state().dropped.load(std::memory_order_relaxed); }
+
+const char *levelName(Level l){
+    switch (l){
+        case Level::Trace: return "TRACE";
+        case Level::Debug: return "DEBUG";
+        case Level::Info:  return "INFO";
+        case Level::Warn:  return "WARN";
+        case Level::Error: return "ERROR";
+        case Level::Off:   return "OFF";
+    }
+    return "?";
+}
+
+bool parseLevel(const std::string &s, Level &out){
+    for (int i = 0; i <= (int)Level::Off; ++i){
+        if (strcasecmp(s.c_str(), levelName((Level)i)) == 0) { out = (Level)i; return true; }
+    }
+    return false;
+}
+
+void write(Level l, const char *tag, const char *fmt, ...){
+    Ring &r = myRing();
+    uint64_t h = r.head.load(std::memory_order_relaxed);
+    if (h - r.tail.load(std::memory_order_acquire) >= kRingSize){
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        state().dropped.fetch_add(1, std::memory_order_relaxed);
+        droppedTotal().add();
+        return;
+    }
+    Record &rec = r.slots[h & (kRingSize - 1)];
+    rec.wallUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.level = l;
+    rec.tag = tag;
+    rec.thread = r.thread;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = std::vsnprintf(rec.msg, kMsgBytes, fmt, ap);
+    va_end(ap);
+    rec.len = n < 0 ? 0 : (uint32_t)std::min<size_t>((size_t)n, kMsgBytes - 1);
+    r.head.store(h + 1, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Asynchronous logger. LOG_* macros format into a fixed-size record on the
+// calling thread's own ring buffer (single producer, no locks, no
+// allocation); a background thread drains every ring about every 20 ms and
+// writes the records, ordered by time, to stderr with one write:
+//
+//   2026-10-17T09:12:03.418207Z DEBUG serial   t3 [SERIAL→] @12 M1:SET:40:CW
+//
+// Levels below LOG_MIN_LEVEL (compile time, default DEBUG) compile to
+// nothing; the runtime level (setLevel, POST /api/log?level=..) filters the
+// rest before any formatting. A record that does not fit in a full ring is
+// dropped and counted (log_dropped_total); the drainer reports drops.
+namespace logging {
+
+enum class Level : int { Trace = 0, Debug = 1, Info = 2, Warn = 3, Error = 4, Off = 5 };
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+void start();
+void stop();            // drains everything still queued
+
+void setLevel(Level l);
+Level level();
+bool enabled(Level l);
+
+const char *levelName(Level l);
+bool parseLevel(const std::string &s, Level &out);   // "debug", "INFO", ...
+uint64_t dropped();
+
+// `tag` must be a string literal (stored by pointer).
+void write(Level l, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+}
+
+#define LOG_AT(lvl, tag, ...) do { \
+    if constexpr ((int)(lvl) >= LOG_MIN_LEVEL) { \
+        if (::logging::enabled(lvl)) ::logging::write((lvl), (tag), __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_TRACE(tag, ...) LOG_AT(::logging::Level::Trace, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_AT(::logging::Level::Debug, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...)  LOG_AT(::logging::Level::Info,  tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...)  LOG_AT(::logging::Level::Warn,  tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) LOG_AT(::logging::Level::Error, tag, __VA_ARGS__)
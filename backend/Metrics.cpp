@@ -0,0 +1,131 @@
+#include "Metrics.hpp"
+#include <cstdio>
+
+namespace metrics {
+
+size_t shard(){
+    static std::atomic<size_t> next{0};
+    thread_local size_t s = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return s;
+}
+
+uint64_t Counter::value() const {
+    uint64_t sum = 0;
+    for (const auto &c : cells_) sum += c.v.load(std::memory_order_relaxed);
+    return sum;
+}
+
+// Bucket 0 is [0,2); then for 2^e <= v < 2^(e+1) the next bit below the top
+// one picks the lower or upper half of the octave.
+int Histogram::bucketOf(uint64_t us){
+    if (us < 2) return 0;
+    int e = 63 - __builtin_clzll(us);
+    int sub = (int)((us >> (e - 1)) & 1);
+    int b = 2 * e - 1 + sub;
+    return b < kBuckets - 1 ? b : kBuckets - 1;
+}
+
+uint64_t Histogram::upperBound(int bucket){
+    if (bucket == 0) return 2;
+    int e = (bucket + 1) / 2, sub = (bucket + 1) % 2;
+    return (1ULL << e) + (uint64_t)(sub + 1) * (1ULL << (e - 1));
+}
+
+void Histogram::observe(uint64_t us){
+    Shard &s = shards_[shard()];
+    s.buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    s.count.fetch_add(1, std::memory_order_relaxed);
+    s.sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+Histogram::Totals Histogram::totals() const {
+    Totals t;
+    for (const auto &s : shards_){
+        for (int i = 0; i < kBuckets; ++i) t.buckets[i] += s.buckets[i].load(std::memory_order_relaxed);
+        t.count += s.count.load(std::memory_order_relaxed);
+        t.sumUs += s.sumUs.load(std::memory_order_relaxed);
+    }
+    return t;
+}
+
+Registry &Registry::global(){
+    static Registry r;
+    return r;
+}
+
+Registry::Entry &Registry::find(const std::string &name, const std::string &help, const std::string &labels, Type type){
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto &e : entries_) if (e->name == name && e->labels == labels) return *e;
+    auto e = std::make_unique<Entry>();
+    e->name = name; e->help = help; e->labels = labels; e->type = type;
+    switch (type){
+        case Type::Counter: e->c = std::make_unique<Counter>(); break;
+        case Type::Gauge: e->g = std::make_unique<Gauge>(); break;
+        case Type::Histogram: e->h = std::make_unique<Histogram>(); break;
+    }
+    entries_.push_back(std::move(e));
+    return *entries_.back();
+}
+
+Counter &Registry::counter(const std::string &name, const std::string &help, const std::string &labels){
+    return *find(name, help, labels, Type::Counter).c;
+}
+
+Gauge &Registry::gauge(const std::string &name, const std::string &help, const std::string &labels){
+    return *find(name, help, labels, Type::Gauge).g;
+}
+
+Histogram &Registry::histogram(const std::string &name, const std::string &help, const std::string &labels){
+    return *find(name, help, labels, Type::Histogram).h;
+}
+
+// Text exposition format 0.0.4; series of one family are kept together.
+std::string Registry::render() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::string out;
+    std::vector<bool> done(entries_.size(), false);
+    char num[64];
+    auto seconds = [&](uint64_t us){ std::snprintf(num, sizeof(num), "%.6g", us / 1e6); return std::string(num); };
+    auto withLabels = [](const std::string &labels, const std::string &extra){
+        if (labels.empty() && extra.empty()) return std::string();
+        return "{" + labels + (!labels.empty() && !extra.empty() ? "," : "") + extra + "}";
+    };
+
+    for (size_t i = 0; i < entries_.size(); ++i){
+        if (done[i]) continue;
+        const Entry &head = *entries_[i];
+        static const char *types[] = {"counter", "gauge", "histogram"};
+        out += "# HELP " + head.name + " " + head.help + "\n";
+        out += "# TYPE " + head.name + " " + types[(int)head.type] + "\n";
+        for (size_t j = i; j < entries_.size(); ++j){
+            const Entry &e = *entries_[j];
+            if (done[j] || e.name != head.name) continue;
+            done[j] = true;
+            switch (e.type){
+                case Type::Counter:
+                    out += e.name + withLabels(e.labels, "") + " " + std::to_string(e.c->value()) + "\n";
+                    break;
+                case Type::Gauge:
+                    out += e.name + withLabels(e.labels, "") + " " + std::to_string(e.g->value()) + "\n";
+                    break;
+                case Type::Histogram: {
+                    auto t = e.h->totals();
+                    uint64_t cum = 0;
+                    for (int b = 0; b < Histogram::kBuckets - 1; ++b){
+                        cum += t.buckets[b];
+                        out += e.name + "_bucket" + withLabels(e.labels, "le=\"" + seconds(Histogram::upperBound(b)) + "\"")
+                             + " " + std::to_string(cum) + "\n";
+                    }
+                    cum += t.buckets[Histogram::kBuckets - 1];   // from the buckets, so +Inf matches them under concurrent writes
+                    out += e.name + "_bucket" + withLabels(e.labels, "le=\"+Inf\"") + " " + std::to_string(cum) + "\n";
+                    out += e.name + "_sum" + withLabels(e.labels, "") + " " + seconds(t.sumUs) + "\n";
+                    out += e.name + "_count" + withLabels(e.labels, "") + " " + std::to_string(cum) + "\n";
+                    break;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+}
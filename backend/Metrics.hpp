@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide counters, gauges and latency histograms, rendered as
+// Prometheus text by GET /api/metrics. Metrics are registered once (that
+// allocates); recording is a relaxed atomic add on a per-thread shard, so the
+// hot path neither locks nor allocates. Shards are summed when rendering.
+namespace metrics {
+
+constexpr size_t kShards = 8;
+
+// Shard of the calling thread, assigned round-robin on first use.
+size_t shard();
+
+class Counter {
+public:
+    void add(uint64_t n = 1) { cells_[shard()].v.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Cell { std::atomic<uint64_t> v{0}; };
+    Cell cells_[kShards];
+};
+
+class Gauge {
+public:
+    void add(int64_t n) { v_.fetch_add(n, std::memory_order_relaxed); }
+    void set(int64_t n) { v_.store(n, std::memory_order_relaxed); }
+    int64_t value() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> v_{0};
+};
+
+// Log-bucketed (HDR-style) histogram of microsecond values: two sub-buckets
+// per power of two, so bucket bounds are within ~41% of each other, from
+// 2 us to ~100 s plus an overflow bucket.
+class Histogram {
+public:
+    static constexpr int kOctaves = 26;
+    static constexpr int kBuckets = 2 * kOctaves + 1;   // last: overflow
+
+    void observe(uint64_t us);
+    template <class Rep, class Period>
+    void observe(std::chrono::duration<Rep, Period> d){
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        observe(us > 0 ? (uint64_t)us : 0);
+    }
+
+    static int bucketOf(uint64_t us);
+    static uint64_t upperBound(int bucket);    // exclusive, in us
+
+    struct Totals { uint64_t buckets[kBuckets] = {}; uint64_t count = 0, sumUs = 0; };
+    Totals totals() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+        std::atomic<uint64_t> count{0}, sumUs{0};
+    };
+    Shard shards_[kShards];
+};
+
+class Registry {
+public:
+    static Registry &global();
+
+    // `labels` is the Prometheus label set without braces, e.g. `route="/api/status"`.
+    // The same name+labels returns the same metric. References stay valid for the process lifetime.
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    // Exported in seconds; `name` should end in _seconds.
+    Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    std::string render() const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+    struct Entry {
+        std::string name, help, labels;
+        Type type;
+        std::unique_ptr<Counter> c;
+        std::unique_ptr<Gauge> g;
+        std::unique_ptr<Histogram> h;
+    };
+
+    Entry &find(const std::string &name, const std::string &help, const std::string &labels, Type type);
+
+    mutable std::mutex mtx_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+inline Counter &counter(const std::string &name, const std::string &help, const std::string &labels = ""){
+    return Registry::global().counter(name, help, labels);
+}
+inline Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = ""){
+    return Registry::global().gauge(name, help, labels);
+}
+inline Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = ""){
+    return Registry::global().histogram(name, help, labels);
+}
+
+}
@@ -0,0 +1,335 @@
+#include "MotionEngine.hpp"
+#include "Log.hpp"
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kHistory = 32;         // finished profiles kept for GET /api/ramp/{n}
+constexpr int kBatchTimeoutMs = 200;
+constexpr int kMaxDurationMs = 10 * 60 * 1000;
+
+int64_t nowUs(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int signedSpeed(int speed, Direction d){ return d == Direction::CCW ? -speed : speed; }
+
+}
+
+MotionEngine::MotionEngine(ControllerPool &pool, int tickHz, int progressMs)
+    : pool_(pool), tickHz_(std::max(1, std::min(1000, tickHz))), progressMs_(progressMs) {}
+
+MotionEngine::~MotionEngine(){ stop(); }
+
+bool MotionEngine::start(){
+    if (running_) return true;
+    timerfd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (timerfd_ < 0 || wakefd_ < 0) { LOG_ERROR("motion", "timerfd/eventfd: %s", std::strerror(errno)); stop(); return false; }
+    running_ = true;
+    th_ = std::thread([this]{ loop(); });
+
+    sched_param sp{};
+    sp.sched_priority = std::max(1, sched_get_priority_min(SCHED_FIFO) + 9);
+    int rc = pthread_setschedparam(th_.native_handle(), SCHED_FIFO, &sp);
+    if (rc == 0) LOG_INFO("motion", "ramp engine at %d Hz, SCHED_FIFO %d", tickHz_, sp.sched_priority);
+    else LOG_INFO("motion", "ramp engine at %d Hz (no SCHED_FIFO: %s)", tickHz_, std::strerror(rc));
+    return true;
+}
+
+void MotionEngine::stop(){
+    if (running_.exchange(false) && wakefd_ >= 0){
+        uint64_t one = 1; ssize_t r = ::write(wakefd_, &one, sizeof(one)); (void)r;
+    }
+    if (th_.joinable()) th_.join();
+    // The ack callback of the last batch still refers to this object.
+    for (int i = 0; i < 100 && inFlight_; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (timerfd_ >= 0) { ::close(timerfd_); timerfd_ = -1; }
+    if (wakefd_ >= 0) { ::close(wakefd_); wakefd_ = -1; }
+    armed_ = false;
+}
+
+const char *MotionEngine::stateName(State s){
+    switch (s){
+        case State::Running: return "running";
+        case State::Done: return "done";
+        case State::Cancelled: return "cancelled";
+        case State::Failed: return "failed";
+    }
+    return "?";
+}
+
+std::string MotionEngine::toJson(const Progress &p){
+    char frac[16];
+    std::snprintf(frac, sizeof(frac), "%.3f", p.fraction);
+    return "{\"profile\":" + std::to_string(p.profile)
+         + ",\"id\":" + std::to_string(p.id)
+         + ",\"state\":\"" + stateName(p.state) + "\""
+         + ",\"from\":" + std::to_string(p.from)
+         + ",\"to\":" + std::to_string(p.to)
+         + ",\"setpoint\":" + std::to_string(p.setpoint)
+         + ",\"elapsed_ms\":" + std::to_string(p.elapsedMs)
+         + ",\"duration_ms\":" + std::to_string(p.durationMs)
+         + ",\"progress\":" + frac + "}";
+}
+
+// Fills in the timing of a profile whose v0 is already set.
+void MotionEngine::plan(Profile &pf, const Spec &spec) const {
+    double v1 = signedSpeed(spec.speedPercent, spec.dir);
+    pf.dv = v1 - pf.v0;
+    double D = std::fabs(pf.dv);
+    pf.scurve = spec.shape == Shape::SCurve;
+    pf.stopAtEnd = spec.stopAtEnd;
+
+    if (D == 0) { pf.T = 0; }
+    else if (!pf.scurve){
+        pf.T = spec.durationMs > 0 ? spec.durationMs / 1000.0 : D / spec.accel;
+        pf.accel = D / pf.T;
+    } else if (spec.durationMs > 0){
+        // Fixed duration: jerk up for half the time, down for the other half.
+        pf.T = spec.durationMs / 1000.0;
+        pf.ta = pf.T / 2; pf.tc = 0;
+        pf.jerk = D / (pf.ta * pf.ta);
+        pf.accel = pf.jerk * pf.ta;
+    } else {
+        double a = spec.accel;
+        pf.jerk = spec.jerk > 0 ? spec.jerk : a * 4;
+        pf.ta = a / pf.jerk;
+        if (D >= a * pf.ta) { pf.tc = D / a - pf.ta; pf.accel = a; }
+        else { pf.ta = std::sqrt(D / pf.jerk); pf.tc = 0; pf.accel = pf.jerk * pf.ta; }   // never reaches `a`
+        pf.T = 2 * pf.ta + pf.tc;
+    }
+    pf.p.from = (int)std::lround(pf.v0);
+    pf.p.to = (int)v1;
+    pf.p.durationMs = (int64_t)std::llround(pf.T * 1000);
+}
+
+// Signed speed at t seconds into the profile.
+double MotionEngine::valueAt(const Profile &pf, double t) const {
+    double D = std::fabs(pf.dv), s;
+    if (t >= pf.T) s = D;
+    else if (t <= 0) s = 0;
+    else if (!pf.scurve) s = D * t / pf.T;
+    else if (t < pf.ta) s = pf.jerk * t * t / 2;
+    else if (t < pf.ta + pf.tc) s = pf.jerk * pf.ta * pf.ta / 2 + pf.accel * (t - pf.ta);
+    else { double u = pf.T - t; s = D - pf.jerk * u * u / 2; }
+    return pf.v0 + (pf.dv < 0 ? -s : s);
+}
+
+uint64_t MotionEngine::submit(const Spec &spec, std::string &err){
+    if (!running_) { err = "ramp engine not running"; return 0; }
+    if (!pool_.has(spec.id)) { err = "unknown motor id"; return 0; }
+    if (spec.speedPercent < 0 || spec.speedPercent > 100) { err = "speed must be 0..100"; return 0; }
+    if (spec.durationMs < 0 || spec.durationMs > kMaxDurationMs) { err = "duration_ms out of range"; return 0; }
+    if (spec.durationMs == 0 && !(spec.accel > 0 && spec.accel <= 100000)) { err = "accel must be > 0"; return 0; }
+    if (!(spec.jerk >= 0 && spec.jerk <= 1e6)) { err = "jerk must be >= 0"; return 0; }
+
+    MotorSnapshot snap;
+    pool_.read(spec.id, snap);
+
+    Progress started;
+    std::vector<Progress> ev;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        Profile pf;
+        pf.enabled = snap.enabled;
+        pf.v0 = snap.enabled ? signedSpeed(snap.speedPercent, snap.dir) : 0;
+        // A new ramp for the same motor continues from where the old one is.
+        for (size_t i = 0; i < active_.size(); ++i){
+            if (active_[i].p.id != spec.id) continue;
+            Profile &old = active_[i];
+            if (old.sentAny) { pf.v0 = old.sent; pf.enabled = old.enabled; }
+            finish(old, State::Cancelled);
+            active_.erase(active_.begin() + (long)i);
+            break;
+        }
+        pf.p.profile = nextProfile_++;
+        pf.p.id = spec.id;
+        pf.p.setpoint = (int)std::lround(pf.v0);
+        plan(pf, spec);
+        pf.startUs = nowUs();
+        pf.lastReportMs = pf.startUs / 1000;   // the start event below is the first report
+        started = pf.p;
+        events_.push_back(pf.p);
+        active_.push_back(pf);
+        activeGauge_.set((int64_t)active_.size());
+        arm(true);
+        ev.swap(events_);
+    }
+    LOG_DEBUG("motion", "ramp %llu: motor %d %d -> %d in %lld ms", (unsigned long long)started.profile,
+              started.id, started.from, started.to, (long long)started.durationMs);
+    for (const auto &p : ev) emit(p);
+    return started.profile;
+}
+
+bool MotionEngine::cancel(uint64_t profile){
+    std::vector<Progress> ev;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (size_t i = 0; i < active_.size(); ++i){
+            if (active_[i].p.profile != profile) continue;
+            finish(active_[i], State::Cancelled);
+            active_.erase(active_.begin() + (long)i);
+            found = true;
+            break;
+        }
+        activeGauge_.set((int64_t)active_.size());
+        ev.swap(events_);
+    }
+    for (const auto &p : ev) emit(p);
+    return found;
+}
+
+bool MotionEngine::cancelMotor(int id){
+    uint64_t profile = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (const auto &pf : active_) if (pf.p.id == id) profile = pf.p.profile;
+    }
+    return profile && cancel(profile);
+}
+
+bool MotionEngine::progress(uint64_t profile, Progress &out) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (const auto &pf : active_) if (pf.p.profile == profile) { out = pf.p; return true; }
+    for (const auto &p : history_) if (p.profile == profile) { out = p; return true; }
+    return false;
+}
+
+std::vector<MotionEngine::Progress> MotionEngine::list() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<Progress> out;
+    for (const auto &pf : active_) out.push_back(pf.p);
+    out.insert(out.end(), history_.rbegin(), history_.rend());
+    return out;
+}
+
+void MotionEngine::finish(Profile &pf, State s){
+    pf.p.state = s;
+    events_.push_back(pf.p);
+    history_.push_back(pf.p);
+    if (history_.size() > kHistory) history_.pop_front();
+}
+
+// Periodic while any profile runs; the first tick fires right away.
+void MotionEngine::arm(bool on){
+    if (on == armed_ || timerfd_ < 0) return;
+    itimerspec its{};
+    if (on){
+        long period = 1000000000L / tickHz_;
+        its.it_interval.tv_sec = period / 1000000000L;
+        its.it_interval.tv_nsec = period % 1000000000L;
+        its.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timerfd_, 0, &its, nullptr);
+    armed_ = on;
+}
+
+void MotionEngine::emit(const Progress &p){
+    if (listener_) listener_(p);
+}
+
+void MotionEngine::loop(){
+    pollfd pfd[2] = {{timerfd_, POLLIN, 0}, {wakefd_, POLLIN, 0}};
+    while (running_){
+        int rv = poll(pfd, 2, -1);
+        if (rv < 0 && errno != EINTR) { LOG_ERROR("motion", "poll: %s", std::strerror(errno)); break; }
+        if (rv <= 0 || !(pfd[0].revents & POLLIN)) continue;
+        uint64_t expirations = 0;
+        if (::read(timerfd_, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) continue;
+        if (expirations > 1) missed_.add(expirations - 1);
+        ticks_.add();
+        tick(nowUs());
+    }
+}
+
+void MotionEngine::tick(int64_t now){
+    std::vector<MotorCommand> items;
+    std::vector<uint64_t> batch;
+    std::vector<Progress> ev;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (inFlight_) { skipped_.add(); return; }
+        for (size_t i = 0; i < active_.size();){
+            Profile &pf = active_[i];
+            double t = (now - pf.startUs) / 1e6;
+            bool done = t >= pf.T;
+            int v = (int)std::lround(valueAt(pf, t));
+            pf.p.setpoint = v;
+            pf.p.elapsedMs = (now - pf.startUs) / 1000;
+            pf.p.fraction = pf.T > 0 ? std::min(1.0, t / pf.T) : 1.0;
+
+            if (!pf.sentAny || v != pf.sent || (done && !pf.finalSent)){
+                MotorCommand c;
+                c.id = pf.p.id;
+                c.speedPercent = std::abs(v);
+                // At 0 keep the direction we are heading to (or coming from).
+                bool ccw = v != 0 ? v < 0 : (pf.p.to != 0 ? pf.p.to < 0 : pf.v0 < 0);
+                c.dir = ccw ? Direction::CCW : Direction::CW;
+                if (done && pf.stopAtEnd && v == 0) c.action = MotorAction::Stop;
+                else if (!pf.enabled && v != 0) { c.action = MotorAction::Start; pf.enabled = true; }
+                else c.action = MotorAction::Set;
+                items.push_back(c);
+                batch.push_back(pf.p.profile);
+                pf.sent = v; pf.sentAny = true;
+                pf.finalSent = done;
+            }
+
+            int64_t nowMs = now / 1000;
+            if (done && pf.finalSent){
+                finish(pf, State::Done);
+                active_.erase(active_.begin() + (long)i);
+                continue;
+            }
+            if (pf.lastReportMs < 0 || nowMs - pf.lastReportMs >= progressMs_){
+                pf.lastReportMs = nowMs;
+                events_.push_back(pf.p);
+            }
+            ++i;
+        }
+        activeGauge_.set((int64_t)active_.size());
+        if (active_.empty()) arm(false);
+        if (!items.empty()) inFlight_ = true;
+        ev.swap(events_);
+    }
+    for (const auto &p : ev) emit(p);
+    if (items.empty()) return;
+
+    batches_.add();
+    pool_.batch(items, kBatchTimeoutMs, [this, batch = std::move(batch)](bool ok){
+        if (!ok){
+            std::vector<Progress> failed;
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                for (uint64_t n : batch){
+                    for (size_t i = 0; i < active_.size(); ++i){
+                        if (active_[i].p.profile != n) continue;
+                        finish(active_[i], State::Failed);
+                        active_.erase(active_.begin() + (long)i);
+                        break;
+                    }
+                    for (auto &h : history_)
+                        if (h.profile == n && h.state == State::Done) { h.state = State::Failed; events_.push_back(h); }
+                }
+                activeGauge_.set((int64_t)active_.size());
+                failed.swap(events_);
+            }
+            LOG_WARN("motion", "set-point batch rejected by firmware; %zu ramp(s) failed", batch.size());
+            for (const auto &p : failed) emit(p);
+        }
+        inFlight_ = false;
+    });
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ControllerPool.hpp"
+#include "Metrics.hpp"
+
+// Server-side speed ramps. A profile moves one motor from its current speed to
+// a target along a linear (constant acceleration) or S-curve (jerk-limited)
+// path. A timerfd thread samples every active profile at a fixed tick rate and
+// sends the set-points that changed as one batch per tick (a frame per port);
+// while a batch is still on the link the next tick is skipped, so a slow link
+// lowers the update rate instead of queueing stale set-points. The timer is
+// disarmed when no profile is running.
+//
+// Speeds are signed internally (CW positive), so a ramp from 40 CW to 30 CCW
+// passes through 0 and flips direction there.
+class MotionEngine {
+public:
+    enum class Shape { Linear, SCurve };
+    enum class State { Running, Done, Cancelled, Failed };
+
+    struct Spec {
+        int id = 0;
+        int speedPercent = 0;
+        Direction dir = Direction::CW;
+        Shape shape = Shape::Linear;
+        double accel = 50.0;        // %/s; limit, or derived when durationMs is set
+        double jerk = 0.0;          // %/s^2, S-curve only; 0 = accel * 4
+        int durationMs = 0;         // > 0: fit the ramp to this duration instead of the limits
+        bool stopAtEnd = false;     // STOP the motor when a ramp to 0 completes
+    };
+
+    struct Progress {
+        uint64_t profile = 0;
+        int id = 0;
+        State state = State::Running;
+        int from = 0, to = 0, setpoint = 0;     // signed %
+        int64_t elapsedMs = 0, durationMs = 0;
+        double fraction = 0.0;                  // 0..1 of the duration
+    };
+
+    // Emitted from the tick thread on start, every progressMs while running and on completion.
+    using Listener = std::function<void(const Progress&)>;
+
+    explicit MotionEngine(ControllerPool &pool, int tickHz = 100, int progressMs = 100);
+    ~MotionEngine();
+
+    // Tries SCHED_FIFO for the tick thread; stays on the normal scheduler if not permitted.
+    bool start();
+    void stop();
+
+    void setListener(Listener l) { listener_ = std::move(l); }   // before start()
+
+    // Starts a profile from the motor's current speed (or from the set-point of
+    // a ramp it replaces). Returns the profile number, 0 if `err` was set.
+    uint64_t submit(const Spec &spec, std::string &err);
+
+    bool cancel(uint64_t profile);
+    // Cancels whatever ramp drives motor `id`; used before manual commands.
+    bool cancelMotor(int id);
+
+    // Running profiles and the most recent finished ones.
+    bool progress(uint64_t profile, Progress &out) const;
+    std::vector<Progress> list() const;
+
+    int tickHz() const { return tickHz_; }
+
+    static const char *stateName(State s);
+    static std::string toJson(const Progress &p);
+
+private:
+    struct Profile {
+        Progress p;
+        double v0 = 0, dv = 0;      // signed start and change, %
+        double T = 0;               // s
+        double ta = 0, tc = 0;      // S-curve jerk and constant-accel phase lengths, s
+        double jerk = 0, accel = 0;
+        bool scurve = false;
+        bool stopAtEnd = false;
+        bool enabled = false;       // motor was running when the profile was planned
+        int sent = 0;               // last set-point put on the link
+        bool sentAny = false;
+        bool finalSent = false;
+        int64_t startUs = 0;
+        int64_t lastReportMs = -1;
+    };
+
+    void plan(Profile &pf, const Spec &spec) const;
+    double valueAt(const Profile &pf, double t) const;
+    void loop();
+    void tick(int64_t nowUs);
+    void finish(Profile &pf, State s);     // caller holds mtx_
+    void arm(bool on);
+    void emit(const Progress &p);
+
+    ControllerPool &pool_;
+    const int tickHz_;
+    const int progressMs_;
+    Listener listener_;
+
+    int timerfd_ = -1;
+    int wakefd_ = -1;
+    std::thread th_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> inFlight_{false};
+
+    mutable std::mutex mtx_;
+    std::vector<Profile> active_;
+    std::deque<Progress> history_;
+    std::vector<Progress> events_;          // filled under mtx_, emitted after it is released
+    uint64_t nextProfile_ = 1;
+    bool armed_ = false;
+
+    metrics::Counter &ticks_ = metrics::counter("motion_ticks_total", "Ramp engine ticks");
+    metrics::Counter &missed_ = metrics::counter("motion_ticks_missed_total", "Timer expirations not serviced in time");
+    metrics::Counter &skipped_ = metrics::counter("motion_ticks_skipped_total", "Ticks skipped because the previous batch was unacked");
+    metrics::Counter &batches_ = metrics::counter("motion_batches_total", "Set-point batches sent");
+    metrics::Gauge &activeGauge_ = metrics::gauge("motion_active_profiles", "Ramps in progress");
+};
@@ -1,62 +1,550 @@
 #include "MotorController.hpp"
-#include <iostream>
-#include <sstream>
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
 
-bool MotorController::connect(const std::string &device, int baud){
+static bool isOk(const std::string &line){
+    return line=="OK" || line.rfind("OK ",0)==0 || line=="STATUS OK";
+}
+
+// No reply isn't fatal (the firmware may be busy); never sending it is
+static bool accepted(const SerialReply &r){
+    return r.acked ? isOk(r.line) : !r.linkDown && !r.refused;
+}
+
+MotorController::MotorController(int motors)
+    : state_(motors),
+      coalescer_(motors, [this](const MotorCommand &m, std::function<void(bool)> done){
+          dispatch(SerialCommand::motor(m), 800, [done](const SerialReply &r){ done(accepted(r)); });
+      }),
+      commanded_(motors) {}
+
+MotorController::~MotorController(){
+    supStop_ = true;
+    if (watch_) watch_->wake();
+    if (supervisor_.joinable()) supervisor_.join();
+    {
+        std::lock_guard<std::mutex> lk(recMtx_);
+        recStop_ = true;
+    }
+    recCv_.notify_all();
+    if (reconciler_.joinable()) reconciler_.join();
+    engine_.stop();
+}
+
+bool MotorController::connect(const std::string &device, int baud, bool preferBinary, int maxBaud){
+    device_ = device;
+    baud_ = baud; preferBinary_ = preferBinary; maxBaud_ = maxBaud;
+    std::string label = "device=\"" + device + "\"";
+    linkUpGauge_ = &metrics::gauge("serial_link_up", "1 while the serial link is up", label);
+    linkDownTotal_ = &metrics::counter("serial_link_down_total", "Serial link losses (unplug, reset, I/O error)", label);
+    outage_ = &metrics::histogram("serial_link_outage_seconds", "Time from link loss to the link being back", label);
+    heldLead_ = &metrics::histogram("serial_held_lead_seconds", "How far ahead of their time AT commands reached the firmware", label);
+    heldLate_ = &metrics::counter("serial_held_late_total", "AT commands that reached the firmware after their time", label);
+    engine_.setMetricLabels(label);
     if (!sp_.open(device, baud)) return false;
-    std::cerr << "Serial open at " << device << " @" << baud << "\n";
+    LOG_INFO("serial", "Serial open at %s @%d", device.c_str(), baud);
 
     // Try to catch READY for a bit
     std::string line;
     const int ms = 3000;
     if (sp_.readLine(line, ms)) {
-        std::cerr << "[SERIAL←] " << line << "\n";
+        LOG_INFO("serial", "[SERIAL←] %s", line.c_str());
     } else {
-        std::cerr << "[SERIAL←] (no READY in " << ms << " ms)\n";
+        LOG_INFO("serial", "[SERIAL←] (no READY in %d ms)", ms);
     }
+
+    if (maxBaud > baud) negotiateBaud(maxBaud);
+
+    // Always handshake: a firmware left in binary mode by a previous run must be
+    // switched back when we want ASCII.
+    bool binary = negotiate(preferBinary) && preferBinary;
+    engine_.setBinary(binary);
+    LOG_INFO("serial", "Serial protocol: %s", binary ? "binary (COBS+CRC16)" : "ASCII");
+    engine_.start();
+    connected_ = true;
+    linkUpGauge_->set(1);
+    if (clockSyncMs_ > 0) syncClock(8);
     return true;
 }
 
+// Sends "\0<cmd>\n\0" (understood in either protocol mode, see WireProtocol.h)
+// and waits for a line containing `expect`; `reply` gets it from there on.
+// An ERR reply or silence fails.
+bool MotorController::handshake(const std::string &cmd, const std::string &expect, std::string &reply, int timeoutMs){
+    std::string msg(1, '\0'); msg += cmd; msg += '\n'; msg.push_back('\0');
+    if (!sp_.write(msg)) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::string line;
+    while (true){
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0 || !sp_.readLine(line, (int)left)) return false;
+        if (line.rfind("ERR", 0) == 0) return false;
+        // Skip stale replies and frames still in the pipe.
+        auto pos = line.find(expect);
+        if (pos != std::string::npos) { reply = line.substr(pos); return true; }
+    }
+}
+
+// "HELLO n" -> "HELLO n OK"
+bool MotorController::negotiate(bool binary){
+    std::string hello = binary ? "HELLO 1" : "HELLO 0", reply;
+    return handshake(hello, hello + " OK", reply);
+}
+
+// Asks the firmware for its rates ("BAUD?") and tries them fastest first,
+// down to the current rate. A switch counts once a HELLO is answered at the
+// new rate. When it is not, the firmware falls back on its own after
+// MotorCore::BAUD_CONFIRM_MS and the host follows. Returns the rate in use.
+int MotorController::negotiateBaud(int maxBaud){
+    const int base = sp_.baud();
+    std::string reply;
+    if (!handshake("BAUD?", "BAUDS ", reply)){
+        LOG_INFO("serial", "%s: firmware offers no BAUD; staying at %d", device_.c_str(), base);
+        return base;
+    }
+    std::vector<int> rates;
+    for (size_t p = 6; p < reply.size(); ){
+        size_t end = reply.find(',', p);
+        if (end == std::string::npos) end = reply.size();
+        int r = std::atoi(reply.substr(p, end - p).c_str());
+        if (r > base && r <= maxBaud) rates.push_back(r);
+        p = end + 1;
+    }
+    std::sort(rates.rbegin(), rates.rend());
+
+    for (int r : rates){
+        if (!handshake("BAUD " + std::to_string(r), "BAUD " + std::to_string(r) + " OK", reply)) continue;
+        // The first bytes at the new rate may be lost to the switch: ask twice.
+        if (sp_.setBaud(r) && (negotiate(false) || negotiate(false))){
+            LOG_INFO("serial", "%s: line rate %d baud (from %d)", device_.c_str(), r, base);
+            return r;
+        }
+        LOG_WARN("serial", "%s: no answer at %d baud; back to %d", device_.c_str(), r, base);
+        sp_.setBaud(base);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));   // firmware confirmation window
+        if (!negotiate(false)){
+            LOG_ERROR("serial", "%s: firmware silent at %d baud after a failed switch", device_.c_str(), base);
+            return base;
+        }
+    }
+    return base;
+}
+
+LinkProbe MotorController::probe(int count){
+    LinkProbe p;
+    p.baud = sp_.baud();
+    p.commands = count;
+    if (!connected_ || count <= 0) return p;   // would only sit in the paused queue
+
+    // Round trip: one STATUS at a time
+    std::vector<uint32_t> rtt;
+    const int pings = std::min(count, 16);
+    for (int i = 0; i < pings; ++i){
+        SerialReply r = engine_.submit(SerialCommand::status(), 500).get();
+        if (r.acked) rtt.push_back(r.latencyUs); else ++p.lost;
+    }
+    if (!rtt.empty()){
+        std::sort(rtt.begin(), rtt.end());
+        p.rttUs = rtt[rtt.size() / 2];
+        p.rttMaxUs = rtt.back();
+    }
+
+    // Throughput: the whole burst queued at once, as deep as the engine's window goes
+    std::vector<std::future<SerialReply>> burst;
+    burst.reserve((size_t)count);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) burst.push_back(engine_.submit(SerialCommand::status(), 2000));
+    int acked = 0;
+    for (auto &f : burst){ if (f.get().acked) ++acked; else ++p.lost; }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    p.commandsPerSec = secs > 0 ? acked / secs : 0;
+    p.atMs = MotorStateTable::nowMs();
+
+    LOG_INFO("serial", "%s @%d: %.0f commands/s pipelined, rtt %.2f ms (max %.2f), %d lost",
+             device_.c_str(), p.baud, p.commandsPerSec, p.rttUs / 1000.0, p.rttMaxUs / 1000.0, p.lost);
+    std::lock_guard<std::mutex> lk(probeMtx_);
+    probe_ = p;
+    return p;
+}
+
+LinkProbe MotorController::lastProbe() const {
+    std::lock_guard<std::mutex> lk(probeMtx_);
+    return probe_;
+}
+
 std::optional<std::string> MotorController::status(){
-    sp_.writeLine("STATUS");
-    std::string line; if (sp_.readLine(line, 500)) return line; else return std::nullopt;
+    auto r = dispatch(SerialCommand::status(), 500).get();
+    if (r.acked) return r.line; else return std::nullopt;
 }
 
 bool MotorController::start(int id, int speedPercent, Direction dir){
-    std::cerr << "DEBUG start: id=" << id
-              << " speed=" << speedPercent
-              << " dir=" << (dir==Direction::CW ? "CW" : "CCW") << "\n";
-
-    std::ostringstream ss;
-    ss << "M"<<id<<":START:"<<speedPercent<<":"<<(dir==Direction::CW?"CW":"CCW");
-    return sendLine(ss.str());
+    LOG_DEBUG("motor", "start: id=%d speed=%d dir=%s", id, speedPercent, dir==Direction::CW ? "CW" : "CCW");
+    return sendMotor({id, MotorAction::Start, speedPercent, dir});
 }
 
 
 bool MotorController::stop(int id){
-    std::ostringstream ss; ss << "M"<<id<<":STOP";
-    return sendLine(ss.str());
+    return sendMotor({id, MotorAction::Stop, 0, Direction::CW});
 }
 
 bool MotorController::set(int id, int speedPercent, Direction dir){
-    std::ostringstream ss;
-    ss << "M"<<id<<":SET:"<<speedPercent<<":"<<(dir==Direction::CW?"CW":"CCW");
-    return sendLine(ss.str());
+    return sendMotor({id, MotorAction::Set, speedPercent, dir});
+}
+
+bool MotorController::sendMotor(const MotorCommand &cmd){
+    if (!accepting()) return false;
+    // Waits for at most the command ahead of it plus its own round-trip;
+    // a superseded SET is answered with the outcome of the newer one.
+    return coalescer_.submit(cmd).get();
+}
+
+bool MotorController::batch(const std::vector<MotorCommand> &cmds){
+    if (cmds.empty()) return true;
+    return send(SerialCommand::batch(cmds));
+}
+
+void MotorController::batch(const std::vector<MotorCommand> &cmds, int timeoutMs, std::function<void(bool)> done){
+    if (cmds.empty()) { done(true); return; }
+    if (!accepting()) { done(false); return; }
+    dispatch(SerialCommand::batch(cmds), timeoutMs, [done = std::move(done)](const SerialReply &r){ done(accepted(r)); });
+}
+
+void MotorController::batchAt(const std::vector<MotorCommand> &cmds, int64_t atUs, int timeoutMs, std::function<void(bool)> done){
+    if (cmds.empty()) { done(true); return; }
+    uint32_t board;
+    // Not while down: a board that resets meanwhile restarts its clock
+    if (!connected_ || !clock_.toBoard(atUs, board)) { done(false); return; }
+    dispatch(SerialCommand::at(board, SerialCommand::batch(cmds)), timeoutMs, [done = std::move(done)](const SerialReply &r){ done(accepted(r)); });
+}
+
+size_t MotorController::held() const {
+    std::lock_guard<std::mutex> lk(heldMtx_);
+    return held_.size();
+}
+
+std::future<SerialReply> MotorController::submit(const SerialCommand &cmd, int timeoutMs){
+    return dispatch(cmd, timeoutMs);
+}
+
+void MotorController::submit(const SerialCommand &cmd, int timeoutMs, std::function<void(const SerialReply&)> done){
+    dispatch(cmd, timeoutMs, std::move(done));
+}
+
+std::future<SerialReply> MotorController::dispatch(const SerialCommand &cmd, int timeoutMs){
+    auto p = std::make_shared<std::promise<SerialReply>>();
+    auto f = p->get_future();
+    dispatch(cmd, timeoutMs, [p](const SerialReply &r){ p->set_value(r); });
+    return f;
+}
+
+void MotorController::dispatch(const SerialCommand &cmd, int timeoutMs, std::function<void(const SerialReply&)> done){
+    if (!accepting()){
+        SerialReply r; r.linkDown = true;
+        done(r);
+        return;
+    }
+    engine_.submit(cmd, [this, done = std::move(done), motors = cmd.motors, timed = cmd.timed](const SerialReply &r){
+        int64_t now = MotorStateTable::nowMs();
+        if (r.acked){
+            lastReplyMs_ = now;
+            if (isOk(r.line) && timed) hold(motors, r);
+            else if (isOk(r.line)){
+                dropHeld(motors);   // as the firmware does
+                for (const auto &m : motors) state_.apply(m, now, r.latencyUs);
+            }
+        }
+        // Went out and was not refused: the firmware has it, or may have
+        if (!timed && accepted(r)) for (const auto &m : motors) commanded_.apply(m, now);
+        if (onChange_) onChange_();
+        done(r);
+    }, timeoutMs);
+}
+
+bool MotorController::linkFresh(int64_t nowMs) const {
+    int64_t reply = lastReplyMs_.load();
+    int64_t window = std::max<int64_t>(3LL * reconcileMs_, 5000);
+    return connected_ && reply && nowMs - reply <= window;
+}
+
+void MotorController::startReconciler(int intervalMs){
+    reconcileMs_ = intervalMs;
+    if (connected_) reconcileOnce();   // start from the firmware's view
+    if (intervalMs > 0) reconciler_ = std::thread([this]{ reconcileLoop(); });
+}
+
+bool MotorController::reconcileOnce(){
+    SerialReply r = dispatch(SerialCommand::state(), 1000).get();
+    std::vector<MotorReport> reports;
+    if (!r.acked || !proto::parseState(r.line, reports)) return false;
+    int64_t now = MotorStateTable::nowMs();
+    int diffs = state_.reconcile(reports, now);
+    lastSyncMs_ = now;
+    if (diffs) LOG_INFO("state", "reconciled %d motor(s) from firmware", diffs);
+    if (diffs && onChange_) onChange_();
+    return true;
+}
+
+void MotorController::reconcileLoop(){
+    bool warned = false;
+    std::unique_lock<std::mutex> lk(recMtx_);
+    while (!recCv_.wait_for(lk, std::chrono::milliseconds(reconcileMs_), [this]{ return recStop_; })){
+        lk.unlock();
+        if (!connected_) { lk.lock(); continue; }   // the supervisor reconciles on reconnect
+        bool ok = reconcileOnce();
+        if (!ok && !warned) LOG_WARN("state", "firmware did not answer STATE; status may be stale");
+        warned = !ok;
+        lk.lock();
+    }
 }
 
-bool MotorController::sendLine(const std::string &line, int expectAckMs){
-    std::cerr << "[SERIAL→] " << line << "\n";
-    if (!sp_.writeLine(line)) return false;
+bool MotorController::send(const SerialCommand &cmd, int expectAckMs){
+    if (!accepting()) return false;
 
     // Be generous with time; Leonardo may reset or be busy.
     int timeout = std::max(expectAckMs, 800);   // was 100
 
-    std::string resp;
-    if (sp_.readLine(resp, timeout)) {
-        std::cerr << "[SERIAL←] " << resp << "\n";
-        return resp=="OK" || resp=="STATUS OK";
+    // Only this caller waits for its own ack; other commands keep flowing.
+    return accepted(dispatch(cmd, timeout).get());
+}
+
+// Sequential TIME round trips into a fresh clock model; false if the
+// firmware does not know TIME (then batchAt() stays unavailable).
+bool MotorController::syncClock(int pings){
+    clock_.reset();
+    int got = 0;
+    for (int i = 0; i < pings; ++i){
+        SerialReply r = engine_.submit(SerialCommand::time(), 300).get();
+        int64_t t1 = ClockSync::nowUs();
+        uint32_t board;
+        if (!r.acked) continue;
+        if (!proto::parseTime(r.line, board)) break;
+        clock_.add(t1 - r.latencyUs, board, t1);
+        ++got;
+    }
+    clockOk_ = got > 0;
+    nextClockUs_ = ClockSync::nowUs() + clockSyncMs_ * 1000LL;
+    ClockSync::Estimate e = clock_.estimate();
+    if (e.valid) LOG_INFO("serial", "%s: board clock synced, +/-%u us (%d samples)", device_.c_str(), e.uncertaintyUs, e.samples);
+    else LOG_WARN("serial", "%s: firmware has no TIME; scheduled commands unavailable", device_.c_str());
+    return e.valid;
+}
+
+// One TIME round trip into the model, answered on a serial thread.
+void MotorController::pingClock(){
+    engine_.submit(SerialCommand::time(), [this](const SerialReply &r){
+        uint32_t board;
+        if (!r.acked || !proto::parseTime(r.line, board)) return;
+        int64_t t1 = ClockSync::nowUs();
+        clock_.add(t1 - r.latencyUs, board, t1);
+    }, 300);
+}
+
+// Acked AT batch: runs `lead` us after the firmware read it, about half a
+// round trip before the ack came back. Late ones already ran.
+void MotorController::hold(const std::vector<MotorCommand> &motors, const SerialReply &r){
+    int32_t lead = 0;
+    proto::parseLead(r.line, lead);
+    if (lead <= 0){
+        if (heldLate_) heldLate_->add();
+        int64_t now = MotorStateTable::nowMs();
+        for (const auto &m : motors) { state_.apply(m, now, r.latencyUs); commanded_.apply(m, now); }
+        return;
+    }
+    if (heldLead_) heldLead_->observe(std::chrono::microseconds(lead));
+    Held h{ClockSync::nowUs() - r.latencyUs / 2 + lead, motors, r.latencyUs};
+    {
+        std::lock_guard<std::mutex> lk(heldMtx_);
+        auto at = std::upper_bound(held_.begin(), held_.end(), h.dueUs, [](int64_t due, const Held &x){ return due < x.dueUs; });
+        held_.insert(at, std::move(h));
+    }
+    if (watch_) watch_->wake();   // the supervisor applies it when due
+}
+
+void MotorController::dropHeld(const std::vector<MotorCommand> &motors){
+    std::lock_guard<std::mutex> lk(heldMtx_);
+    if (held_.empty()) return;
+    for (auto &h : held_){
+        h.motors.erase(std::remove_if(h.motors.begin(), h.motors.end(), [&motors](const MotorCommand &m){
+            return std::any_of(motors.begin(), motors.end(), [&m](const MotorCommand &c){ return c.id == m.id; });
+        }), h.motors.end());
+    }
+    held_.erase(std::remove_if(held_.begin(), held_.end(), [](const Held &h){ return h.motors.empty(); }), held_.end());
+}
+
+// Held batches that are due go into the tables; returns us until the next, -1 if none.
+int64_t MotorController::runHeld(){
+    std::vector<Held> due;
+    int64_t now = ClockSync::nowUs(), next = -1;
+    {
+        std::lock_guard<std::mutex> lk(heldMtx_);
+        size_t k = 0;
+        while (k < held_.size() && held_[k].dueUs <= now) ++k;
+        due.assign(std::make_move_iterator(held_.begin()), std::make_move_iterator(held_.begin() + (long)k));
+        held_.erase(held_.begin(), held_.begin() + (long)k);
+        if (!held_.empty()) next = held_.front().dueUs - now;
+    }
+    if (due.empty()) return next;
+    int64_t ms = MotorStateTable::nowMs();
+    for (const auto &h : due)
+        for (const auto &m : h.motors) { state_.apply(m, ms, h.latencyUs); commanded_.apply(m, ms); }
+    if (onChange_) onChange_();
+    return next;
+}
+
+void MotorController::supervise(LinkPolicy policy){
+    if (supervised_.exchange(true)) return;
+    policy_ = policy;
+    watch_ = std::make_unique<DeviceWatch>(device_);
+    if (!connected_){
+        // Never came up: hold commands (per policy) until it does.
+        engine_.pause();
+        downSinceMs_ = MotorStateTable::nowMs();
+        if (linkUpGauge_) linkUpGauge_->set(0);
+    }
+    supervisor_ = std::thread([this]{ superviseLoop(); });
+}
+
+// Up: a removal or an I/O error ends the link. Down: reopen as soon as the
+// device appears, with a timer (100 ms doubling to 2 s) for what inotify
+// misses, e.g. a node that is there but not yet accessible.
+void MotorController::superviseLoop(){
+    int64_t nextTry = 0;
+    int backoffMs = 100;
+    while (!supStop_){
+        int waitMs = connected_ ? 50 : 100;
+        int64_t heldUs = runHeld();
+        if (heldUs >= 0) waitMs = (int)std::min<int64_t>(waitMs, (heldUs + 999) / 1000);
+        int ev = watch_->wait(waitMs);
+        if (supStop_) break;
+        if (connected_){
+            if (ev & DeviceWatch::Gone) linkDown("device removed");
+            else if (sp_.lost()) linkDown("I/O error");
+            else {
+                int64_t now = ClockSync::nowUs();
+                if (clockOk_ && clockSyncMs_ > 0 && now >= nextClockUs_){
+                    pingClock();
+                    nextClockUs_ = now + clockSyncMs_ * 1000LL;
+                }
+                continue;
+            }
+            nextTry = 0;
+            backoffMs = 100;
+        }
+
+        if (policy_.queue){
+            size_t n = engine_.dropQueued(std::chrono::milliseconds(policy_.queueMs));
+            if (n) LOG_WARN("serial", "%s: link down, %zu queued command(s) failed after %d ms", device_.c_str(), n, policy_.queueMs);
+        }
+        int64_t now = MotorStateTable::nowMs();
+        if (!(ev & DeviceWatch::Appeared) && now < nextTry) continue;
+        if (!watch_->exists() || !reopen()){
+            nextTry = now + backoffMs;
+            backoffMs = std::min(backoffMs * 2, 2000);
+            continue;
+        }
+
+        int64_t outage = MotorStateTable::nowMs() - downSinceMs_.load();
+        lastOutageMs_ = outage;
+        downSinceMs_ = 0;
+        connected_ = true;
+        if (linkUpGauge_) linkUpGauge_->set(1);
+        if (outage_) outage_->observe(std::chrono::milliseconds(outage));
+        LOG_INFO("serial", "%s: link up after %lld ms (%s)", device_.c_str(), (long long)outage,
+                 engine_.binary() ? "binary" : "ASCII");
+        reconcileOnce();
+        if (clockSyncMs_ > 0) syncClock(8);   // the board may have restarted its clock
+        if (onLink_) onLink_(true, outage);
+        if (onChange_) onChange_();
     }
-    // No reply isn't fatal; firmware might be busy
-    std::cerr << "[SERIAL←] (no-reply)\n";
+}
+
+void MotorController::linkDown(const char *why){
+    connected_ = false;
+    downSinceMs_ = MotorStateTable::nowMs();
+    ++linkDowns_;
+    if (linkUpGauge_) linkUpGauge_->set(0);
+    if (linkDownTotal_) linkDownTotal_->add();
+    LOG_WARN("serial", "%s: link down (%s); commands %s", device_.c_str(), why,
+             policy_.queue ? "queue" : "are rejected");
+    engine_.pause();   // commands in flight fail now
+    sp_.close();
+    clock_.reset();
+    {
+        // A board that resets forgets what it held; the reconcile after the
+        // reconnect reports what did run.
+        std::lock_guard<std::mutex> lk(heldMtx_);
+        held_.clear();
+    }
+    if (onLink_) onLink_(false, 0);
+    if (onChange_) onChange_();
+}
+
+// Opens the device again and redoes the handshakes. The engine is paused, so
+// nothing else reads the port.
+bool MotorController::reopen(){
+    int lastBaud = sp_.baud();
+    sp_.close();
+    if (!sp_.open(device_, baud_)) return false;
+    // No READY wait: ask until the firmware answers. A board that just reset
+    // may still be booting.
+    bool alive = false;
+    for (int i = 0; i < 6 && !alive && !supStop_; ++i) alive = negotiate(false);
+    // A board that did not reset is still at the negotiated rate.
+    if (!alive && lastBaud != baud_ && lastBaud > 0 && sp_.setBaud(lastBaud)) alive = negotiate(false) || negotiate(false);
+    if (!alive){
+        LOG_DEBUG("serial", "%s: present but silent", device_.c_str());
+        sp_.close();
+        return false;
+    }
+    if (maxBaud_ > sp_.baud()) negotiateBaud(maxBaud_);
+    bool binary = negotiate(preferBinary_) && preferBinary_;
+    engine_.setBinary(binary);
+
+    replayState();
+    if (!engine_.running()) engine_.start();
+    engine_.resume();
     return true;
-}
\ No newline at end of file
+}
+
+// The firmware may have reset with the link: put back what was last sent to
+// every motor (or, for a motor never commanded, what the firmware last
+// reported), ahead of anything queued during the outage. Two batches: SETs
+// restore speed and direction of stopped motors, then one START or STOP each.
+void MotorController::replayState(){
+    std::vector<MotorCommand> sets, runs;
+    MotorSnapshot m;
+    for (int id = 1; id <= state_.size(); ++id){
+        if (!commanded_.read(id, m) || !m.lastAckMs) state_.read(id, m);
+        if (m.enabled) runs.push_back({id, MotorAction::Start, m.speedPercent, m.dir});
+        else {
+            if (m.speedPercent || m.dir != Direction::CW) sets.push_back({id, MotorAction::Set, m.speedPercent, m.dir});
+            runs.push_back({id, MotorAction::Stop, 0, Direction::CW});
+        }
+    }
+    auto check = [this](const SerialReply &r){
+        if (r.acked && isOk(r.line)) return;
+        LOG_WARN("serial", "%s: state replay not acknowledged (%s)", device_.c_str(), r.acked ? r.line.c_str() : "no reply");
+    };
+    // Replies only refresh the tables; the values are what they already hold.
+    auto apply = [this, check](const SerialCommand &cmd){
+        return [this, check, motors = cmd.motors](const SerialReply &r){
+            check(r);
+            if (!r.acked || !isOk(r.line)) return;
+            int64_t now = MotorStateTable::nowMs();
+            lastReplyMs_ = now;
+            for (const auto &mc : motors) state_.apply(mc, now, r.latencyUs);
+        };
+    };
+    SerialCommand run = SerialCommand::batch(runs);
+    engine_.submitFront(run, apply(run), 1000);
+    if (!sets.empty()){
+        SerialCommand set = SerialCommand::batch(sets);
+        engine_.submitFront(set, apply(set), 1000);   // front again: goes before `run`
+    }
+    LOG_INFO("serial", "%s: replaying %zu motor(s), %zu running", device_.c_str(), runs.size(),
+             (size_t)std::count_if(runs.begin(), runs.end(), [](const MotorCommand &c){ return c.action == MotorAction::Start; }));
+}
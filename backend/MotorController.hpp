@@ -1,22 +1,210 @@
 #pragma once
 #include <string>
 #include <optional>
+#include <future>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
 #include "SerialPort.hpp"
+#include "SerialEngine.hpp"
+#include "Protocol.hpp"
+#include "MotorStateTable.hpp"
+#include "CommandCoalescer.hpp"
+#include "DeviceWatch.hpp"
+#include "ClockSync.hpp"
+#include "Metrics.hpp"
 
-enum class Direction { CW, CCW };
+// What probe() measured on a link: the round trip of single STATUS
+// commands, and how many per second get through when a burst of them is
+// pipelined by the engine.
+struct LinkProbe {
+    int baud = 0;
+    int commands = 0;           // burst size
+    int lost = 0;               // unanswered, pings and burst
+    uint32_t rttUs = 0;         // median of the pings
+    uint32_t rttMaxUs = 0;
+    double commandsPerSec = 0;
+    int64_t atMs = 0;           // steady ms, 0 = never probed
+};
 
+// Keeps a shadow copy of the firmware motor table (MotorStateTable) that is
+// updated from acks and periodically reconciled with the firmware's STATE
+// reply, so status reads never touch the serial link. Single-motor commands
+// go through a CommandCoalescer: one in flight per motor, latest SET wins.
+//
+// supervise() keeps the link up across board resets and re-plugged cables:
+// the device path is watched with inotify and I/O errors end the link; when
+// the device is back the port is reopened, the handshakes are redone without
+// waiting for READY, and the last commanded state of every motor is sent
+// again ahead of anything queued during the outage.
+//
+// The board's clock is tracked from TIME round trips (ClockSync), so batchAt()
+// can hand the firmware work ahead of time with the board time to run it at
+// (AT, see MotorCore.h); the tables follow when it runs, not at the ack.
 class MotorController {
 public:
-    bool connect(const std::string &device, int baud = 115200);
+    // What happens to commands while the link is down.
+    struct LinkPolicy {
+        bool queue = true;      // false: fail them at once
+        int queueMs = 2000;     // queued longer than this: fail
+    };
+
+    explicit MotorController(int motors = 9);
+    ~MotorController();
+
+    // preferBinary: negotiate COBS/CRC frames with "HELLO 1"; ASCII is the fallback.
+    // maxBaud > baud: move to the fastest rate up to maxBaud that the
+    // firmware offers (BAUD, see MotorCore.h), staying at `baud` if none works.
+    bool connect(const std::string &device, int baud = 115200, bool preferBinary = true, int maxBaud = 0);
 
-    // returns Arduino one-line reply if available
+    // Times `count` pipelined STATUS commands plus a few single round trips;
+    // the result is kept for lastProbe(). Blocks for the duration.
+    LinkProbe probe(int count);
+    LinkProbe lastProbe() const;
+    int baud() const { return sp_.baud(); }
+
+    // returns Arduino one-line reply if available (goes over the serial link)
     std::optional<std::string> status();
 
+    // Lock-free view of the last known motor state.
+    const MotorStateTable &state() const { return state_; }
+
+    // Poll STATE every intervalMs in the background and correct the table. 0 disables.
+    void startReconciler(int intervalMs);
+    int reconcileIntervalMs() const { return reconcileMs_; }
+    int64_t lastSyncMs() const { return lastSyncMs_.load(); }   // steady ms, 0 = never
+    int64_t lastReplyMs() const { return lastReplyMs_.load(); } // any reply on the link
+    // Link up and the firmware answered within a few reconcile periods.
+    bool linkFresh(int64_t nowMs) const;
+
+    // Called (from the serial threads) after the table or link state changed.
+    // Must be cheap; set before connect().
+    void setOnChange(std::function<void()> cb) { onChange_ = std::move(cb); }
+
     bool start(int id, int speedPercent, Direction dir);
     bool stop(int id);
     bool set(int id, int speedPercent, Direction dir);
+    CommandCoalescer::Stats coalescerStats() const { return coalescer_.stats(); }
+
+    // Applies all commands in one serial frame ("B:1S40C;2X;3U55A") that the
+    // firmware validates as a whole and applies in a single pass with one ack.
+    // Bypasses the coalescer.
+    bool batch(const std::vector<MotorCommand> &cmds);
+    // Non-blocking form; `done(ok)` runs on a serial thread. No reply counts as ok.
+    void batch(const std::vector<MotorCommand> &cmds, int timeoutMs, std::function<void(bool)> done);
+    // Same, held by the firmware until host steady time `atUs`
+    // (ClockSync::nowUs()). done(false) while the link or the clock is not up.
+    void batchAt(const std::vector<MotorCommand> &cmds, int64_t atUs, int timeoutMs, std::function<void(bool)> done);
+
+    // TIME round trips: a burst on every (re)connect, then one every periodMs
+    // from the supervisor. 0 disables them, and with them batchAt(). Before connect().
+    void setClockSync(int periodMs) { clockSyncMs_ = periodMs; }
+    bool clockSynced() const { return connected_ && clock_.estimate().valid; }
+    ClockSync::Estimate clock() const { return clock_.estimate(); }
+    // Board micros() at host steady time `hostUs`; false until synced.
+    bool boardTime(int64_t hostUs, uint32_t &boardUs) const { return clock_.toBoard(hostUs, boardUs); }
+    size_t held() const;    // acked AT batches that have not run yet
+
+    // Non-blocking: queue a command; the future resolves with the matching reply.
+    std::future<SerialReply> submit(const SerialCommand &cmd, int timeoutMs = 800);
+    // Same with a callback, run on a serial thread.
+    void submit(const SerialCommand &cmd, int timeoutMs, std::function<void(const SerialReply&)> done);
+
+    // Journal every command and reply on this link as `port`; call before connect().
+    void setJournal(Journal *journal, uint8_t port) { engine_.setJournal(journal, port); }
+
+    bool binaryProtocol() const { return engine_.binary(); }
+
+    // Starts the link supervisor; call after connect(), whether it succeeded
+    // or not (a port that failed comes up when its device appears).
+    void supervise(LinkPolicy policy);
+    // Called from the supervisor thread when the link goes down (outageMs 0)
+    // or comes back (outageMs = how long it was down). Set before supervise().
+    void setOnLink(std::function<void(bool up, int64_t outageMs)> cb) { onLink_ = std::move(cb); }
+    uint64_t linkDowns() const { return linkDowns_.load(); }
+    int64_t downSinceMs() const { return downSinceMs_.load(); }     // steady ms, 0 = up
+    int64_t lastOutageMs() const { return lastOutageMs_.load(); }   // -1 = none yet
+
+    // Link up: the handshake succeeded and no I/O error or removal since.
+    bool connected() const { return connected_; }
+    const std::string &device() const { return device_; }
+    size_t queued() const { return engine_.queued(); }
+    size_t inFlight() const { return engine_.inFlight(); }
 
 private:
     SerialPort sp_;
-    bool sendLine(const std::string &line, int expectAckMs=100);
+    SerialEngine engine_{sp_};
+    MotorStateTable state_;
+    CommandCoalescer coalescer_;
+
+    std::thread reconciler_;
+    std::mutex recMtx_;
+    std::condition_variable recCv_;
+    bool recStop_ = false;
+    int reconcileMs_ = 0;
+    std::atomic<int64_t> lastSyncMs_{0};
+    std::atomic<int64_t> lastReplyMs_{0};
+    std::function<void()> onChange_;
+    std::string device_;
+    std::atomic<bool> connected_{false};
+    int baud_ = 115200, maxBaud_ = 0;
+    bool preferBinary_ = true;
+
+    // Commands as they went out (or may have, if the link died with them in
+    // flight): what a reconnect replays.
+    MotorStateTable commanded_;
+    LinkPolicy policy_;
+    std::atomic<bool> supervised_{false};
+    std::atomic<bool> supStop_{false};
+    std::unique_ptr<DeviceWatch> watch_;
+    std::thread supervisor_;
+    std::function<void(bool, int64_t)> onLink_;
+    std::atomic<uint64_t> linkDowns_{0};
+    std::atomic<int64_t> downSinceMs_{0};
+    std::atomic<int64_t> lastOutageMs_{-1};
+    metrics::Gauge *linkUpGauge_ = nullptr;
+    metrics::Counter *linkDownTotal_ = nullptr;
+    metrics::Histogram *outage_ = nullptr;
+    mutable std::mutex probeMtx_;
+    LinkProbe probe_;
+
+    ClockSync clock_;
+    int clockSyncMs_ = 1000;
+    std::atomic<bool> clockOk_{false};      // the firmware answers TIME
+    int64_t nextClockUs_ = 0;               // supervisor thread
+    struct Held {
+        int64_t dueUs;                      // host steady
+        std::vector<MotorCommand> motors;
+        uint32_t latencyUs;
+    };
+    mutable std::mutex heldMtx_;
+    std::vector<Held> held_;                // by due time
+    metrics::Histogram *heldLead_ = nullptr;
+    metrics::Counter *heldLate_ = nullptr;
+
+    bool handshake(const std::string &cmd, const std::string &expect, std::string &reply, int timeoutMs = 300);
+    bool negotiate(bool binary);
+    int negotiateBaud(int maxBaud);
+    bool send(const SerialCommand &cmd, int expectAckMs=100);
+    bool sendMotor(const MotorCommand &cmd);    // through coalescer_
+    // engine submit that applies successful acks to state_
+    std::future<SerialReply> dispatch(const SerialCommand &cmd, int timeoutMs);
+    void dispatch(const SerialCommand &cmd, int timeoutMs, std::function<void(const SerialReply&)> done);
+    bool reconcileOnce();
+    void reconcileLoop();
+    bool accepting() const { return connected_ || (supervised_ && policy_.queue); }
+    void superviseLoop();
+    void linkDown(const char *why);
+    bool reopen();
+    void replayState();
+    bool syncClock(int pings);
+    void pingClock();
+    void hold(const std::vector<MotorCommand> &motors, const SerialReply &r);
+    void dropHeld(const std::vector<MotorCommand> &motors);
+    int64_t runHeld();
 };
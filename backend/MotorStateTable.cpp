@@ -0,0 +1,81 @@
+#include "MotorStateTable.hpp"
+#include <chrono>
+
+MotorStateTable::MotorStateTable(int motors): slotStore_(new Slot[motors > 0 ? motors : 1]) {
+    for (int i=0;i<motors;++i) slots_.push_back(&slotStore_[i]);
+}
+
+int64_t MotorStateTable::nowMs(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool MotorStateTable::read(int id, MotorSnapshot &out) const{
+    if (id < 1 || id > size()) return false;
+    const Slot &s = *slots_[id-1];
+    uint32_t before, after;
+    do {
+        before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) continue;   // writer in progress
+        out.speedPercent = s.speed.load(std::memory_order_relaxed);
+        out.dir = s.ccw.load(std::memory_order_relaxed) ? Direction::CCW : Direction::CW;
+        out.enabled = s.enabled.load(std::memory_order_relaxed) != 0;
+        out.lastAckMs = s.ackMs.load(std::memory_order_relaxed);
+        out.version = s.version.load(std::memory_order_relaxed);
+        out.ackLatencyUs = s.ackUs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s.seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    out.id = id;
+    return true;
+}
+
+std::vector<MotorSnapshot> MotorStateTable::readAll() const{
+    std::vector<MotorSnapshot> v(slots_.size());
+    for (int i=0;i<size();++i) read(i+1, v[i]);
+    return v;
+}
+
+bool MotorStateTable::write(Slot &s, int speed, bool ccw, bool enabled, int64_t ackMs, uint32_t ackUs){
+    bool changed = s.speed.load(std::memory_order_relaxed) != speed
+                || (s.ccw.load(std::memory_order_relaxed) != 0) != ccw
+                || (s.enabled.load(std::memory_order_relaxed) != 0) != enabled;
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.speed.store(speed, std::memory_order_relaxed);
+    s.ccw.store(ccw ? 1 : 0, std::memory_order_relaxed);
+    s.enabled.store(enabled ? 1 : 0, std::memory_order_relaxed);
+    s.ackMs.store(ackMs, std::memory_order_relaxed);
+    s.ackUs.store(ackUs, std::memory_order_relaxed);
+    if (changed) s.version.store(s.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+    if (changed) version_.fetch_add(1, std::memory_order_acq_rel);
+    return changed;
+}
+
+void MotorStateTable::apply(const MotorCommand &c, int64_t nowMs, uint32_t ackLatencyUs){
+    if (c.id < 1 || c.id > size()) return;
+    std::lock_guard<std::mutex> lk(writeMtx_);
+    Slot &s = *slots_[c.id-1];
+    int speed = s.speed.load(std::memory_order_relaxed);
+    bool ccw = s.ccw.load(std::memory_order_relaxed) != 0;
+    bool enabled = s.enabled.load(std::memory_order_relaxed) != 0;
+    switch (c.action){
+    case MotorAction::Start: speed = c.speedPercent; ccw = c.dir == Direction::CCW; enabled = true; break;
+    case MotorAction::Set:   speed = c.speedPercent; ccw = c.dir == Direction::CCW; break;
+    case MotorAction::Stop:  enabled = false; break;
+    }
+    if (!ackLatencyUs) ackLatencyUs = s.ackUs.load(std::memory_order_relaxed);
+    write(s, speed, ccw, enabled, nowMs, ackLatencyUs);
+}
+
+int MotorStateTable::reconcile(const std::vector<MotorReport> &reports, int64_t nowMs){
+    std::lock_guard<std::mutex> lk(writeMtx_);
+    int diffs = 0;
+    for (size_t i=0;i<reports.size() && i<slots_.size();++i){
+        const auto &r = reports[i];
+        Slot &s = *slots_[i];
+        if (write(s, r.speedPercent, r.dir == Direction::CCW, r.enabled, nowMs, s.ackUs.load(std::memory_order_relaxed))) ++diffs;
+    }
+    return diffs;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Protocol.hpp"
+
+struct MotorSnapshot {
+    int id = 0;
+    int speedPercent = 0;
+    Direction dir = Direction::CW;
+    bool enabled = false;
+    int64_t lastAckMs = 0;      // steady-clock ms of the last ack/reconcile touching this motor, 0 = never
+    uint64_t version = 0;       // bumps on every change
+    uint32_t ackLatencyUs = 0;  // round-trip of the last acked command, 0 = none yet
+};
+
+// Authoritative in-memory copy of the firmware's motor table. Writers (ack
+// callbacks, the reconciler) are serialised by a mutex; readers never lock:
+// each slot is a seqlock, so a reader retries if it raced a writer.
+class MotorStateTable {
+public:
+    explicit MotorStateTable(int motors = 9);
+
+    int size() const { return (int)slots_.size(); }
+
+    // ids are 1-based; false for an unknown id
+    bool read(int id, MotorSnapshot &out) const;
+    std::vector<MotorSnapshot> readAll() const;
+
+    // An acked command: mirrors the firmware's START/STOP/SET semantics.
+    void apply(const MotorCommand &c, int64_t nowMs, uint32_t ackLatencyUs = 0);
+    // Firmware-reported state; returns how many motors differed from the table.
+    int reconcile(const std::vector<MotorReport> &reports, int64_t nowMs);
+
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+    static int64_t nowMs();
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<int32_t> speed{0};
+        std::atomic<uint8_t> ccw{0};
+        std::atomic<uint8_t> enabled{0};
+        std::atomic<int64_t> ackMs{0};
+        std::atomic<uint64_t> version{0};
+        std::atomic<uint32_t> ackUs{0};
+    };
+    // caller holds writeMtx_; returns true if anything but the ack time/latency changed
+    bool write(Slot &s, int speed, bool ccw, bool enabled, int64_t ackMs, uint32_t ackUs);
+
+    std::unique_ptr<Slot[]> slotStore_;
+    std::vector<Slot*> slots_;
+    std::mutex writeMtx_;
+    std::atomic<uint64_t> version_{0};
+};
@@ -0,0 +1,192 @@
+#include "Protocol.hpp"
+#include "WireProtocol.h"
+#include <algorithm>
+#include <cstring>
+
+namespace proto {
+
+static uint8_t wireOp(const MotorCommand &m){
+    uint8_t op = m.action == MotorAction::Start ? WOP_START : m.action == MotorAction::Stop ? WOP_STOP : WOP_SET;
+    if (m.dir == Direction::CCW && m.action != MotorAction::Stop) op |= WOP_CCW;
+    return op;
+}
+
+std::string toAscii(const SerialCommand &cmd){
+    if (cmd.timed && (cmd.kind == SerialCommand::Kind::Motor || cmd.kind == SerialCommand::Kind::Batch)){
+        SerialCommand now = cmd;
+        now.timed = false;
+        return "AT " + std::to_string(cmd.atUs) + " " + toAscii(now);
+    }
+    switch (cmd.kind){
+    case SerialCommand::Kind::Line: return cmd.line;
+    case SerialCommand::Kind::Status: return "STATUS";
+    case SerialCommand::Kind::State: return "STATE";
+    case SerialCommand::Kind::Time: return "TIME";
+    case SerialCommand::Kind::Motor: {
+        const auto &m = cmd.motors.front();
+        std::string s = "M" + std::to_string(m.id);
+        if (m.action == MotorAction::Stop) return s + ":STOP";
+        s += m.action == MotorAction::Start ? ":START:" : ":SET:";
+        s += std::to_string(m.speedPercent);
+        s += m.dir == Direction::CW ? ":CW" : ":CCW";
+        return s;
+    }
+    case SerialCommand::Kind::Batch: {
+        std::string s = "B:";
+        for (size_t i=0;i<cmd.motors.size();++i){
+            const auto &m = cmd.motors[i];
+            if (i) s += ';';
+            s += std::to_string(m.id);
+            if (m.action == MotorAction::Stop) { s += 'X'; continue; }
+            s += m.action == MotorAction::Start ? 'S' : 'U';
+            s += std::to_string(m.speedPercent);
+            s += m.dir == Direction::CW ? 'C' : 'A';
+        }
+        return s;
+    }
+    }
+    return std::string();
+}
+
+std::string toFrame(const SerialCommand &cmd, uint8_t seq){
+    uint8_t payload[WIRE_MAX_PAYLOAD];
+    size_t n = 0;
+    WireCmd hdr{}; hdr.seq = seq;
+
+    switch (cmd.kind){
+    case SerialCommand::Kind::Line:
+        return std::string();
+    case SerialCommand::Kind::Status:
+        hdr.op = WOP_STATUS;
+        break;
+    case SerialCommand::Kind::State:
+        hdr.op = WOP_STATE;
+        break;
+    case SerialCommand::Kind::Time:
+        hdr.op = WOP_TIME;
+        break;
+    case SerialCommand::Kind::Motor:
+        if (!cmd.timed){
+            const auto &m = cmd.motors.front();
+            hdr.op = wireOp(m); hdr.id = (uint8_t)m.id; hdr.speed = (uint8_t)m.speedPercent;
+            break;
+        }
+        [[fallthrough]];   // held: a one-item WOP_AT
+    case SerialCommand::Kind::Batch: {
+        if (cmd.motors.empty() || cmd.motors.size() > WIRE_MAX_ITEMS) return std::string();
+        hdr.op = cmd.timed ? WOP_AT : WOP_BATCH; hdr.id = (uint8_t)cmd.motors.size();
+        size_t head = sizeof(WireCmd);
+        if (cmd.timed){
+            std::memcpy(payload + head, &cmd.atUs, sizeof(cmd.atUs));
+            head += sizeof(cmd.atUs);
+        }
+        for (size_t i=0;i<cmd.motors.size();++i){
+            WireItem it{ (uint8_t)cmd.motors[i].id, wireOp(cmd.motors[i]), (uint8_t)cmd.motors[i].speedPercent };
+            std::memcpy(payload + head + i*sizeof(WireItem), &it, sizeof(it));
+        }
+        n = head - sizeof(WireCmd) + cmd.motors.size() * sizeof(WireItem);
+        break;
+    }
+    }
+    std::memcpy(payload, &hdr, sizeof(hdr));
+    n += sizeof(hdr);
+
+    uint8_t out[WIRE_MAX_ENCODED];
+    size_t len = wireEncodeFrame(payload, n, out);
+    return std::string(reinterpret_cast<const char*>(out), len);
+}
+
+bool encodable(const SerialCommand &cmd, bool binary){
+    switch (cmd.kind){
+    case SerialCommand::Kind::Line: return !binary;
+    case SerialCommand::Kind::Motor: return cmd.motors.size() == 1;
+    case SerialCommand::Kind::Batch: return !cmd.motors.empty() && cmd.motors.size() <= WIRE_MAX_ITEMS;
+    default: return true;
+    }
+}
+
+bool parseReply(std::string_view frame, BinaryReply &out){
+    uint8_t payload[WIRE_MAX_PAYLOAD];
+    size_t n = wireDecodeFrame(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(), payload, sizeof(payload));
+    if (n < sizeof(WireReply)) return false;
+    WireReply r; std::memcpy(&r, payload, sizeof(r));
+    out.seq = r.seq; out.status = r.status; out.arg = r.arg;
+    out.extra.assign(reinterpret_cast<const char*>(payload) + sizeof(r), n - sizeof(r));
+    return true;
+}
+
+std::string replyText(const BinaryReply &r, const SerialCommand &cmd){
+    SerialCommand::Kind kind = cmd.kind;
+    uint32_t v = 0;
+    if (r.extra.size() == sizeof(v)) std::memcpy(&v, r.extra.data(), sizeof(v));
+    switch (r.status){
+    case WST_OK:
+        if (kind == SerialCommand::Kind::Status) return "STATUS OK";
+        if (kind == SerialCommand::Kind::Time) return "TIME " + std::to_string(v);
+        if (cmd.timed) return "OK AT " + std::to_string((int32_t)v);
+        if (kind == SerialCommand::Kind::Batch) return "OK B" + std::to_string(r.arg);
+        if (kind == SerialCommand::Kind::State){
+            std::string t = "STATE ";
+            size_t count = std::min<size_t>(r.arg, r.extra.size() / sizeof(WireMotorState));
+            for (size_t i=0;i<count;++i){
+                WireMotorState m; std::memcpy(&m, r.extra.data() + i*sizeof(m), sizeof(m));
+                if (i) t += ',';
+                t += std::to_string(m.speed);
+                t += (m.flags & WMS_CCW) ? 'A' : 'C';
+                t += (m.flags & WMS_ENABLED) ? '1' : '0';
+            }
+            return t;
+        }
+        return "OK";
+    case WST_BADFMT: return "ERR BADFMT";
+    case WST_ID:     return "ERR ID";
+    case WST_ARGS:   return "ERR ARGS";
+    case WST_CMD:    return "ERR CMD";
+    case WST_CRC:    return "ERR CRC";
+    case WST_BATCH:  return "ERR BATCH";
+    case WST_FULL:   return "ERR FULL";
+    default:         return "ERR " + std::to_string(r.status);
+    }
+}
+
+bool parseTime(std::string_view text, uint32_t &us){
+    if (text.substr(0, 5) != "TIME ") return false;
+    uint64_t v = 0; size_t i = 5;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9' && v <= 0xFFFFFFFFull) v = v*10 + (uint64_t)(text[i++]-'0');
+    if (i == 5 || i != text.size() || v > 0xFFFFFFFFull) return false;
+    us = (uint32_t)v;
+    return true;
+}
+
+bool parseLead(std::string_view text, int32_t &us){
+    if (text.substr(0, 6) != "OK AT ") return false;
+    size_t i = 6; bool neg = i < text.size() && text[i] == '-';
+    if (neg) ++i;
+    size_t first = i; int64_t v = 0;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9' && v <= INT32_MAX) v = v*10 + (text[i++]-'0');
+    if (i == first || i != text.size() || v > INT32_MAX) return false;
+    us = (int32_t)(neg ? -v : v);
+    return true;
+}
+
+bool parseState(std::string_view text, std::vector<MotorReport> &out){
+    out.clear();
+    if (text.substr(0, 6) != "STATE ") return false;
+    text.remove_prefix(6);
+    while (!text.empty()){
+        size_t comma = text.find(',');
+        std::string_view item = text.substr(0, comma);
+        text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+
+        MotorReport m; size_t i = 0; int sp = 0;
+        while (i < item.size() && item[i] >= '0' && item[i] <= '9') sp = sp*10 + (item[i++]-'0');
+        if (i == 0 || i + 2 != item.size()) return false;
+        m.speedPercent = std::min(sp, 100);
+        m.dir = item[i]=='A' ? Direction::CCW : Direction::CW;
+        m.enabled = item[i+1]=='1';
+        out.push_back(m);
+    }
+    return !out.empty();
+}
+
+}
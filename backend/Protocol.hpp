@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+enum class Direction { CW, CCW };
+enum class MotorAction { Start, Stop, Set };
+
+struct MotorCommand {
+    int id = 0;
+    MotorAction action = MotorAction::Set;
+    int speedPercent = 0;
+    Direction dir = Direction::CW;
+};
+
+// Firmware-side view of one motor, as reported by the STATE command.
+struct MotorReport {
+    int speedPercent = 0;
+    Direction dir = Direction::CW;
+    bool enabled = false;
+};
+
+// One request on the serial link, independent of the wire encoding.
+// The engine renders it as an ASCII line or as a binary frame (see
+// firmware/MotorControlNine/WireProtocol.h) depending on the negotiated mode.
+// Motor and batch commands can be held by the firmware until its clock
+// reaches `atUs` ("AT <us> ...", WOP_AT); the ack then only means queued.
+struct SerialCommand {
+    enum class Kind { Line, Status, Motor, Batch, State, Time };
+    Kind kind = Kind::Line;
+    std::string line;                   // Kind::Line: raw ASCII text, not available in binary mode
+    std::vector<MotorCommand> motors;   // Kind::Motor: one entry; Kind::Batch: 1..16
+    bool timed = false;
+    uint32_t atUs = 0;                  // board micros(), see ClockSync
+
+    static SerialCommand raw(const std::string &l) { SerialCommand c; c.line = l; return c; }
+    static SerialCommand status() { SerialCommand c; c.kind = Kind::Status; return c; }
+    static SerialCommand state() { SerialCommand c; c.kind = Kind::State; return c; }
+    static SerialCommand time() { SerialCommand c; c.kind = Kind::Time; return c; }
+    static SerialCommand motor(const MotorCommand &m) { SerialCommand c; c.kind = Kind::Motor; c.motors.push_back(m); return c; }
+    static SerialCommand batch(std::vector<MotorCommand> ms) { SerialCommand c; c.kind = Kind::Batch; c.motors = std::move(ms); return c; }
+    static SerialCommand at(uint32_t boardUs, SerialCommand c) { c.timed = true; c.atUs = boardUs; return c; }
+};
+
+namespace proto {
+
+// "STATUS", "M1:START:37:CCW", "B:1S40C;2X", "AT 4850123 M1:STOP" ...
+std::string toAscii(const SerialCommand &cmd);
+
+// Complete COBS frame including the 0x00 delimiter; empty for Kind::Line.
+std::string toFrame(const SerialCommand &cmd, uint8_t seq);
+
+// False if `cmd` has no form on the wire in that mode: Kind::Line in binary,
+// a batch of 0 or more than WIRE_MAX_ITEMS motors in either.
+bool encodable(const SerialCommand &cmd, bool binary);
+
+struct BinaryReply {
+    uint8_t seq = 0; uint8_t status = 0; uint8_t arg = 0;
+    std::string extra;      // payload after the WireReply header (STATE table)
+};
+
+// `frame` is one COBS frame without its delimiter. False on COBS/CRC/size error.
+bool parseReply(std::string_view frame, BinaryReply &out);
+
+// Renders a binary reply the way the ASCII firmware would have answered it
+// ("OK", "OK B3", "OK AT 4850", "TIME 123", "STATE 40C1,...", "ERR ID", ...),
+// so callers see one format.
+std::string replyText(const BinaryReply &r, const SerialCommand &cmd);
+
+// "TIME 123" -> board clock
+bool parseTime(std::string_view text, uint32_t &us);
+// "OK AT -120" -> microseconds the firmware had to go
+bool parseLead(std::string_view text, int32_t &us);
+
+// "STATE 40C1,0C0,..." -> one report per motor, in id order starting at 1.
+bool parseState(std::string_view text, std::vector<MotorReport> &out);
+
+}
@@ -0,0 +1,115 @@
+#include "Router.hpp"
+#include <charconv>
+#include <chrono>
+
+namespace {
+
+// Pops the next '/'-separated segment off `rest`; leading slashes are skipped.
+bool nextSegment(std::string_view &rest, std::string_view &seg){
+    while (!rest.empty() && rest.front() == '/') rest.remove_prefix(1);
+    if (rest.empty()) return false;
+    size_t slash = rest.find('/');
+    seg = rest.substr(0, slash);
+    rest = slash == std::string_view::npos ? std::string_view() : rest.substr(slash);
+    return true;
+}
+
+bool parseLong(std::string_view s, long &out){
+    if (s.empty()) return false;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+}
+
+std::string_view Router::Request::query(std::string_view key) const {
+    std::string_view rest = queryString;
+    while (!rest.empty()){
+        size_t amp = rest.find('&');
+        std::string_view pair = rest.substr(0, amp);
+        rest = amp == std::string_view::npos ? std::string_view() : rest.substr(amp + 1);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == key) return eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+    }
+    return {};
+}
+
+long Router::Request::queryInt(std::string_view key, long def) const {
+    std::string_view v = query(key);
+    long n = 0;
+    // leading digits only, like atoi
+    auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+    return r.ec == std::errc() ? n : def;
+}
+
+void Router::add(std::string_view method, std::string_view pattern, Handler h, int lane){
+    Node *n = &root_;
+    std::string_view rest = pattern, seg;
+    while (nextSegment(rest, seg)){
+        if (seg.size() >= 2 && seg.front() == '{' && seg.back() == '}'){
+            ParamKind kind = seg.substr(1, seg.size() - 2).find(":int") != std::string_view::npos ? ParamKind::Int : ParamKind::Any;
+            if (!n->param) { n->param = std::make_unique<Node>(); n->kind = kind; }
+            n = n->param.get();
+            continue;
+        }
+        auto it = n->literal.find(seg);
+        if (it == n->literal.end()) it = n->literal.emplace(std::string(seg), std::make_unique<Node>()).first;
+        n = it->second.get();
+    }
+    for (auto &r : n->handlers) if (r.method == method) { r.handler = std::move(h); r.lane = lane; return; }
+    auto &latency = metrics::histogram("http_request_duration_seconds", "HTTP request latency by route",
+        "method=\"" + std::string(method) + "\",route=\"" + std::string(pattern) + "\"");
+    n->handlers.push_back(Node::Route{std::string(method), std::move(h), &latency, lane});
+}
+
+// Literal segments win over a parameter at the same depth.
+const Router::Node *Router::match(std::string_view path, Request &req) const {
+    const Node *n = &root_;
+    std::string_view rest = path, seg;
+    while (nextSegment(rest, seg)){
+        auto it = n->literal.find(seg);
+        if (it != n->literal.end()) { n = it->second.get(); continue; }
+        if (!n->param || req.nparams == kMaxParams) return nullptr;
+        Param &p = req.params[req.nparams];
+        p.str = seg;
+        if (n->kind == ParamKind::Int && !parseLong(seg, p.num)) return nullptr;
+        ++req.nparams;
+        n = n->param.get();
+    }
+    return n->handlers.empty() ? nullptr : n;
+}
+
+int Router::lane(std::string_view method, std::string_view target) const {
+    Request req;
+    const Node *n = match(target.substr(0, target.find('?')), req);
+    if (n) for (const auto &r : n->handlers) if (r.method == method) return r.lane;
+    return -1;
+}
+
+std::string Router::handle(const std::string &method, const std::string &target, const std::string &body,
+                           int &status, std::string &contentType) const {
+    Request req;
+    std::string_view t = target;
+    size_t q = t.find('?');
+    req.method = method;
+    req.path = t.substr(0, q);
+    req.queryString = q == std::string_view::npos ? std::string_view() : t.substr(q + 1);
+    req.body = body;
+
+    auto t0 = std::chrono::steady_clock::now();
+    contentType = "application/json";
+    const Node *n = match(req.path, req);
+    if (n){
+        for (const auto &r : n->handlers){
+            if (r.method != req.method) continue;
+            status = 200;
+            std::string out = r.handler(req, status, contentType);
+            r.latency->observe(std::chrono::steady_clock::now() - t0);
+            return out;
+        }
+    }
+    unmatched_.observe(std::chrono::steady_clock::now() - t0);
+    if (!n) { status = 404; return "{\"error\":\"not found\"}"; }
+    status = 405;
+    return "{\"error\":\"method not allowed\"}";
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Metrics.hpp"
+
+// Route table for the /api endpoints, built once at startup. Patterns are
+// split into segments and stored in a trie; "{name}" matches any segment and
+// "{name:int}" only a decimal integer, which is parsed during the match.
+// Matching and query parsing work on string_views of the request target, so
+// routing itself does not allocate. Handlers are registered per method; a
+// path that matches with another method gets 405. Each route records its
+// latency in http_request_duration_seconds{method,route}.
+class Router {
+public:
+    static constexpr size_t kMaxParams = 4;
+
+    struct Param {
+        std::string_view str;
+        long num = 0;               // set for {name:int}
+    };
+
+    struct Request {
+        std::string_view method, path, queryString, body;
+        std::array<Param, kMaxParams> params{};
+        size_t nparams = 0;
+
+        // Path parameters in pattern order.
+        long num(size_t i) const { return params[i].num; }
+        std::string_view str(size_t i) const { return params[i].str; }
+
+        // First value of `key` in the query string; empty if absent (no %-decoding).
+        std::string_view query(std::string_view key) const;
+        // from_chars on the value; `def` if absent or not a number.
+        long queryInt(std::string_view key, long def = 0) const;
+    };
+
+    using Handler = std::function<std::string(const Request &req, int &status, std::string &contentType)>;
+
+    // e.g. add("GET", "/api/motor/{id:int}/start", ...). Later registrations replace earlier ones.
+    // `lane` is the HttpServer work-queue lane for handlers that may block; -1 runs inline.
+    void add(std::string_view method, std::string_view pattern, Handler h, int lane = -1);
+
+    // Lane of the route `target` would reach, -1 if inline or unmatched.
+    int lane(std::string_view method, std::string_view target) const;
+
+    // Same shape as HttpServer::Handler; `target` may carry a "?query".
+    std::string handle(const std::string &method, const std::string &target, const std::string &body,
+                       int &status, std::string &contentType) const;
+
+private:
+    enum class ParamKind { None, Any, Int };
+
+    struct Node {
+        std::map<std::string, std::unique_ptr<Node>, std::less<>> literal;
+        std::unique_ptr<Node> param;
+        ParamKind kind = ParamKind::None;
+        struct Route {
+            std::string method;
+            Handler handler;
+            metrics::Histogram *latency;
+            int lane;
+        };
+        std::vector<Route> handlers;
+    };
+
+    const Node *match(std::string_view path, Request &req) const;
+
+    Node root_;
+    metrics::Histogram &unmatched_ = metrics::histogram("http_request_duration_seconds",
+        "HTTP request latency by route", "method=\"\",route=\"unmatched\"");
+};
@@ -0,0 +1,257 @@
+#include "SerialEngine.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+static uint64_t steadyNs(std::chrono::steady_clock::time_point t){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+static uint32_t elapsedUs(std::chrono::steady_clock::duration d){
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+SerialEngine::SerialEngine(SerialPort &sp, size_t window): sp_(sp), window_(std::max<size_t>(1, window)) {}
+SerialEngine::~SerialEngine(){ stop(); }
+
+void SerialEngine::setMetricLabels(const std::string &labels){
+    rtt_ = &metrics::histogram("serial_roundtrip_seconds", "Command write to matching reply", labels);
+    timeouts_ = &metrics::counter("serial_ack_timeouts_total", "Commands that got no reply before their deadline", labels);
+}
+
+void SerialEngine::start(){
+    if (!rtt_) setMetricLabels("");
+    if (running_.exchange(true)) return;
+    writer_ = std::thread([this]{ writerLoop(); });
+    reader_ = std::thread([this]{ readerLoop(); });
+}
+
+void SerialEngine::stop(){
+    if (!running_.exchange(false)) return;
+    paused_ = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);   // a waiter between predicate and sleep sees running_ flip
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+    if (reader_.joinable()) reader_.join();
+
+    // Fail whatever is left so no caller waits forever.
+    std::vector<Cmd> left;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto &kv : inflight_) left.push_back(std::move(kv.second));
+        for (auto &c : queue_) left.push_back(std::move(c));
+        inflight_.clear(); queue_.clear(); order_.clear();
+    }
+    for (auto &c : left) complete(c, SerialReply{});
+}
+
+std::future<SerialReply> SerialEngine::submit(const SerialCommand &cmd, int timeoutMs){
+    auto p = std::make_shared<std::promise<SerialReply>>();
+    auto f = p->get_future();
+    submit(cmd, [p](const SerialReply &r){ p->set_value(r); }, timeoutMs);
+    return f;
+}
+
+void SerialEngine::submit(const SerialCommand &cmd, Callback cb, int timeoutMs){
+    Cmd c; c.cmd = cmd; c.cb = std::move(cb); c.timeoutMs = timeoutMs;
+    enqueue(std::move(c));
+}
+
+void SerialEngine::submitFront(const SerialCommand &cmd, Callback cb, int timeoutMs){
+    Cmd c; c.cmd = cmd; c.cb = std::move(cb); c.timeoutMs = timeoutMs;
+    enqueue(std::move(c), true);
+}
+
+void SerialEngine::refuse(Cmd &cmd){
+    LOG_WARN("serial", "[SERIAL→] not sent, no %s form: %s", binary_ ? "binary" : "ASCII", proto::toAscii(cmd.cmd).c_str());
+    SerialReply r; r.refused = true;
+    complete(cmd, r);
+}
+
+void SerialEngine::enqueue(Cmd cmd, bool front){
+    if (!running_ && !paused_) { complete(cmd, SerialReply{}); return; }
+    if (!proto::encodable(cmd.cmd, binary_)) { refuse(cmd); return; }
+    cmd.queuedAt = Clock::now();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (front) queue_.push_front(std::move(cmd));
+        else queue_.push_back(std::move(cmd));
+    }
+    cv_.notify_all();
+}
+
+void SerialEngine::pause(){
+    std::vector<Cmd> lost;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        paused_ = true;
+        cv_.notify_all();
+        cv_.wait(lk, [this]{ return !running_ || (!writing_ && readerParked_); });
+        for (auto &kv : inflight_) lost.push_back(std::move(kv.second));
+        inflight_.clear(); order_.clear();
+    }
+    if (!lost.empty() && timeouts_) timeouts_->add(lost.size());
+    for (auto &c : lost) complete(c, SerialReply{});
+}
+
+void SerialEngine::resume(){
+    paused_ = false;
+    cv_.notify_all();
+}
+
+size_t SerialEngine::dropQueued(std::chrono::milliseconds maxAge){
+    std::vector<Cmd> old;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto cutoff = Clock::now() - maxAge;
+        for (auto it = queue_.begin(); it != queue_.end(); ){
+            if (it->queuedAt <= cutoff) { old.push_back(std::move(*it)); it = queue_.erase(it); }
+            else ++it;
+        }
+    }
+    SerialReply r; r.linkDown = true;
+    for (auto &c : old) complete(c, r);
+    return old.size();
+}
+
+size_t SerialEngine::inFlight() const { std::lock_guard<std::mutex> lk(mtx_); return inflight_.size(); }
+size_t SerialEngine::queued() const { std::lock_guard<std::mutex> lk(mtx_); return queue_.size(); }
+
+void SerialEngine::complete(Cmd &cmd, SerialReply reply){
+    if (cmd.cb) cmd.cb(reply);
+}
+
+void SerialEngine::writerLoop(){
+    while (running_){
+        Cmd c;
+        std::string wire, text;
+        uint16_t seq;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this]{ return !running_ || (!paused_ && !queue_.empty() && inflight_.size() < window_); });
+            if (!running_) return;
+            c = std::move(queue_.front()); queue_.pop_front();
+            if (!proto::encodable(c.cmd, binary_)){   // the mode changed while it was queued
+                lk.unlock();
+                refuse(c);
+                continue;
+            }
+            writing_ = true;
+            c.seq = seq = nextSeq_++;
+            if (nextSeq_ == 0) nextSeq_ = 1;
+            c.sentAt = Clock::now();
+            c.deadline = c.sentAt + std::chrono::milliseconds(c.timeoutMs);
+            text = proto::toAscii(c.cmd);
+            if (binary_) wire = proto::toFrame(c.cmd, (uint8_t)c.seq);
+            else wire = "@" + std::to_string(c.seq) + " " + text + "\n";
+            if (journal_) journal_->command(journalPort_, c.seq, c.cmd, binary_, steadyNs(c.sentAt));
+            order_.push_back(c.seq);
+            inflight_.emplace(c.seq, std::move(c));
+        }
+        if (binary_) LOG_DEBUG("serial", "[SERIAL→] #%u %s (%zu B)", seq & 0xFFu, text.c_str(), wire.size());
+        else LOG_DEBUG("serial", "[SERIAL→] @%u %s", (unsigned)seq, text.c_str());
+        bool ok = sp_.write(wire);
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            writing_ = false;
+            auto it = inflight_.find(seq);
+            if (!ok && it != inflight_.end()) it->second.deadline = Clock::now();   // reader expires it
+        }
+        cv_.notify_all();
+    }
+}
+
+void SerialEngine::readerLoop(){
+    std::string_view v;
+    while (running_){
+        if (paused_){
+            std::unique_lock<std::mutex> lk(mtx_);
+            readerParked_ = true;
+            cv_.notify_all();
+            cv_.wait(lk, [this]{ return !running_ || !paused_; });
+            readerParked_ = false;
+            continue;
+        }
+        // Short read deadline so command deadlines are checked at a steady rate.
+        auto until = Clock::now() + std::chrono::milliseconds(50);
+        if (binary_){
+            if (sp_.readFrame(v, until) && !v.empty()){
+                proto::BinaryReply r;
+                if (proto::parseReply(v, r)) onReply(r.seq, true, std::string(), &r);
+                else LOG_WARN("serial", "[SERIAL←] (corrupt frame, %zu B)", v.size());
+            }
+        } else if (sp_.readLine(v, until) && !v.empty()){
+            LOG_DEBUG("serial", "[SERIAL←] %.*s", (int)v.size(), v.data());
+            int seq = -1;
+            if (v[0]=='@'){
+                size_t i = 1; int n = 0;
+                while (i < v.size() && v[i] >= '0' && v[i] <= '9') n = n*10 + (v[i++]-'0');
+                if (i > 1) {
+                    seq = n & 0xFFFF;
+                    v.remove_prefix(i < v.size() && v[i]==' ' ? i+1 : i);
+                }
+            }
+            onReply(seq, false, std::string(v), nullptr);
+        }
+        expire(Clock::now());
+        if (sp_.lost()){
+            // Dead fd: reads fail at once. Wait for the supervisor's pause().
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait_for(lk, std::chrono::milliseconds(50), [this]{ return !running_ || paused_; });
+        }
+    }
+}
+
+// seq < 0: untagged ASCII reply, matched to the oldest command in flight.
+void SerialEngine::onReply(int seq, bool lowByteOnly, const std::string &text, const proto::BinaryReply *bin){
+    Cmd done; bool found = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (seq < 0 && text != "READY" && !order_.empty()) seq = order_.front();
+        auto it = inflight_.end();
+        if (lowByteOnly){
+            for (uint16_t s : order_) if ((s & 0xFF) == seq) { it = inflight_.find(s); break; }
+        } else if (seq >= 0) {
+            it = inflight_.find((uint16_t)seq);
+        }
+        if (it != inflight_.end()){
+            done = std::move(it->second); inflight_.erase(it); found = true;
+            order_.erase(std::find(order_.begin(), order_.end(), done.seq));
+        }
+    }
+    if (!found) return;
+    auto now = Clock::now();
+    rtt_->observe(now - done.sentAt);
+    cv_.notify_all();
+    uint32_t us = elapsedUs(now - done.sentAt);
+    if (journal_) journal_->reply(journalPort_, done.seq, done.cmd, text, bin, binary_, steadyNs(now), us);
+    std::string reply = bin ? proto::replyText(*bin, done.cmd) : text;
+    if (bin) LOG_DEBUG("serial", "[SERIAL←] #%d %s", seq, reply.c_str());
+    complete(done, SerialReply{true, reply, us});
+}
+
+void SerialEngine::expire(Clock::time_point now){
+    std::vector<Cmd> late;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto it = inflight_.begin(); it != inflight_.end(); ){
+            if (it->second.deadline <= now){
+                order_.erase(std::find(order_.begin(), order_.end(), it->first));
+                late.push_back(std::move(it->second));
+                it = inflight_.erase(it);
+            } else ++it;
+        }
+    }
+    if (late.empty()) return;
+    timeouts_->add(late.size());
+    cv_.notify_all();
+    for (auto &c : late){
+        LOG_WARN("serial", "[SERIAL←] (no-reply @%u)", (unsigned)c.seq);
+        if (journal_) journal_->timeout(journalPort_, c.seq, c.cmd, binary_, steadyNs(now), elapsedUs(now - c.sentAt));
+        complete(c, SerialReply{});
+    }
+}
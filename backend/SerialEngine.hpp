@@ -0,0 +1,114 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include "SerialPort.hpp"
+#include "Protocol.hpp"
+#include "Metrics.hpp"
+#include "Journal.hpp"
+
+struct SerialReply {
+    bool acked = false;         // false: no reply before the deadline
+    std::string line;           // reply text with the sequence tag stripped
+    uint32_t latencyUs = 0;     // write to reply
+    bool linkDown = false;      // never sent: the link was down (rejected or expired in the queue)
+    bool refused = false;       // never sent: no encoding for it in the current mode
+};
+
+// Pipelined command engine on top of SerialPort. Every command is tagged
+// "@<seq> " on the wire and the firmware echoes the tag in its reply, so
+// several commands can be in flight at once (bounded by `window`) and each
+// reply is matched to the command that caused it. Untagged replies from old
+// firmware are matched to the oldest command in flight.
+// A writer thread drains the submit queue; a reader thread matches replies
+// and expires per-command deadlines.
+class SerialEngine {
+public:
+    using Callback = std::function<void(const SerialReply&)>;
+
+    explicit SerialEngine(SerialPort &sp, size_t window = 4);
+    ~SerialEngine();
+
+    void start();
+    void stop();
+
+    std::future<SerialReply> submit(const SerialCommand &cmd, int timeoutMs = 800);
+    void submit(const SerialCommand &cmd, Callback cb, int timeoutMs = 800);
+    std::future<SerialReply> submit(const std::string &line, int timeoutMs = 800) { return submit(SerialCommand::raw(line), timeoutMs); }
+    // Ahead of everything queued (state replay after a reconnect).
+    void submitFront(const SerialCommand &cmd, Callback cb, int timeoutMs = 800);
+
+    // Link supervision. pause() returns once neither thread touches the port:
+    // commands in flight fail, queued ones wait for resume(). While paused the
+    // port may be closed and reopened.
+    void pause();
+    void resume();
+    bool running() const { return running_; }
+    bool paused() const { return paused_; }
+    // Fails queued commands older than maxAge with linkDown set; returns how many.
+    size_t dropQueued(std::chrono::milliseconds maxAge);
+
+    // Switch wire encoding; call before start() or while the link is idle.
+    void setBinary(bool on) { binary_ = on; }
+    bool binary() const { return binary_; }
+
+    // Prometheus labels of this link's metrics, e.g. `device="/dev/ttyACM0"`;
+    // call before start().
+    void setMetricLabels(const std::string &labels);
+
+    // Record every command, reply and timeout as `port`; call before start().
+    void setJournal(Journal *journal, uint8_t port) { journal_ = journal; journalPort_ = port; }
+
+    size_t inFlight() const;
+    size_t queued() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Cmd {
+        uint16_t seq = 0;
+        SerialCommand cmd;
+        int timeoutMs = 800;
+        Clock::time_point queuedAt;
+        Clock::time_point deadline;
+        Clock::time_point sentAt;
+        Callback cb;
+    };
+
+    void enqueue(Cmd cmd, bool front = false);
+    void writerLoop();
+    void readerLoop();
+    void complete(Cmd &cmd, SerialReply reply);
+    void refuse(Cmd &cmd);
+    void onReply(int seq, bool lowByteOnly, const std::string &text, const proto::BinaryReply *bin);
+    void expire(Clock::time_point now);
+
+    SerialPort &sp_;
+    size_t window_;
+    uint16_t nextSeq_ = 1;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Cmd> queue_;
+    std::map<uint16_t, Cmd> inflight_;      // keyed by seq
+    std::deque<uint16_t> order_;            // seqs in send order, for untagged replies
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> binary_{false};
+    std::atomic<bool> paused_{false};
+    bool writing_ = false;          // writer between taking a command and its write(); under mtx_
+    bool readerParked_ = false;     // under mtx_
+    std::thread writer_, reader_;
+    Journal *journal_ = nullptr;
+    uint8_t journalPort_ = 0;
+
+    metrics::Histogram *rtt_ = nullptr;     // see setMetricLabels()
+    metrics::Counter *timeouts_ = nullptr;
+};
@@ -1,17 +1,22 @@
 #include "SerialPort.hpp"
+#include "Log.hpp"
 #include <unistd.h>
 #include <fcntl.h>
-#include <termios.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <sys/ioctl.h>
+#include <asm/termbits.h>   // termios2/BOTHER; glibc's <termios.h> cannot be included with it
 
-
-static speed_t baudToFlag(int baud){
+// Rates with a Bnnn constant; anything else goes through BOTHER.
+static unsigned baudToFlag(int baud){
     switch(baud){
         case 9600: return B9600; case 19200: return B19200; case 38400: return B38400;
-        case 57600: return B57600; case 115200: return B115200; default: return B115200; }
+        case 57600: return B57600; case 115200: return B115200; case 230400: return B230400;
+        case 460800: return B460800; case 500000: return B500000; case 576000: return B576000;
+        case 921600: return B921600; case 1000000: return B1000000; case 1152000: return B1152000;
+        case 1500000: return B1500000; case 2000000: return B2000000; default: return 0; }
 }
 
 SerialPort::SerialPort(): fd_(-1) {}
@@ -19,9 +24,14 @@ SerialPort::~SerialPort(){ close(); }
 
 bool SerialPort::open(const std::string &device, int baud){
     std::lock_guard<std::mutex> lk(mtx_);
+    std::string label = "device=\"" + device + "\",dir=";
+    txBytes_ = &metrics::counter("serial_bytes_total", "Bytes on the serial link", label + "\"tx\"");
+    rxBytes_ = &metrics::counter("serial_bytes_total", "Bytes on the serial link", label + "\"rx\"");
     fd_ = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd_ < 0) { perror("open serial"); return false; }
-    if (!configure(baud)) { close(); return false; }
+    if (fd_ < 0) { LOG_ERROR("serial", "open %s: %s", device.c_str(), std::strerror(errno)); return false; }
+    if (!configure(baud)) { ::close(fd_); fd_ = -1; return false; }
+    rxHead_ = rxTail_ = 0;
+    lost_ = false;
 
     // set blocking
     int flags = fcntl(fd_, F_GETFL, 0);
@@ -41,17 +51,46 @@ void SerialPort::close(){
     if (fd_ >= 0) { ::close(fd_); fd_ = -1; }
 }
 
+bool SerialPort::setBaud(int baud){
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (fd_ < 0) return false;
+    ioctl(fd_, TCSBRK, 1);   // tcdrain(): the old rate's bytes leave first
+    if (!configure(baud)) return false;
+    ioctl(fd_, TCFLSH, TCIFLUSH);
+    rxHead_ = rxTail_ = 0;
+    return true;
+}
+
+// Raw 8N1 at `baud`. Reads back what the driver took: a UART that cannot
+// get within 2% of the rate fails instead of running at some other speed.
 bool SerialPort::configure(int baud){
-    struct termios tio{};
-    if (tcgetattr(fd_, &tio) < 0) return false;
-    cfmakeraw(&tio);
-    tio.c_cflag |= CLOCAL | CREAD;
-    speed_t sp = baudToFlag(baud);
-    cfsetispeed(&tio, sp);
-    cfsetospeed(&tio, sp);
+    if (baud <= 0) { LOG_ERROR("serial", "bad baud rate %d", baud); return false; }
+    struct termios2 tio{};
+    if (ioctl(fd_, TCGETS2, &tio) < 0) return false;
+    // cfmakeraw()
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(CSIZE | PARENB);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    unsigned flag = baudToFlag(baud);
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));   // input speed follows output
+    tio.c_cflag |= flag ? flag : BOTHER;
+    tio.c_ispeed = tio.c_ospeed = (speed_t)baud;
     tio.c_cc[VMIN] = 0;  // read returns immediately
     tio.c_cc[VTIME] = 1; // 100ms read timeout
-    return tcsetattr(fd_, TCSANOW, &tio) == 0;
+    if (ioctl(fd_, TCSETS2, &tio) < 0) {
+        LOG_ERROR("serial", "%d baud: %s", baud, std::strerror(errno));
+        return false;
+    }
+    struct termios2 got{};
+    if (ioctl(fd_, TCGETS2, &got) == 0 && (got.c_cflag & CBAUD) == BOTHER
+        && std::abs((long)got.c_ospeed - baud) * 50 > baud) {
+        LOG_ERROR("serial", "%d baud: driver set %u", baud, (unsigned)got.c_ospeed);
+        return false;
+    }
+    baud_ = baud;
+    return true;
 }
 
 bool SerialPort::writeLine(const std::string &line){
@@ -59,27 +98,92 @@ bool SerialPort::writeLine(const std::string &line){
     if (fd_ < 0) return false;
     std::string out = line + "\n";
     ssize_t n = ::write(fd_, out.c_str(), out.size());
+    if (n > 0) txBytes_->add((uint64_t)n);
+    else if (n < 0 && errno != EINTR && errno != EAGAIN) lost_ = true;
     return n == (ssize_t)out.size();
 }
 
-bool SerialPort::readLine(std::string &out, int max_ms){
-    out.clear();
+bool SerialPort::write(const std::string &bytes){
+    std::lock_guard<std::mutex> lk(mtx_);
     if (fd_ < 0) return false;
+    ssize_t n = ::write(fd_, bytes.data(), bytes.size());
+    if (n > 0) txBytes_->add((uint64_t)n);
+    else if (n < 0 && errno != EINTR && errno != EAGAIN) lost_ = true;
+    return n == (ssize_t)bytes.size();
+}
+
+static SerialPort::Clock::time_point deadlineAfter(int max_ms){
+    return max_ms > 0 ? SerialPort::Clock::now() + std::chrono::milliseconds(max_ms)
+                      : SerialPort::Clock::time_point::max();
+}
+
+bool SerialPort::readLine(std::string &out, int max_ms){
+    std::string_view v;
+    if (!readLine(v, deadlineAfter(max_ms))) { out.clear(); return false; }
+    out.assign(v.data(), v.size());
+    return true;
+}
+
+bool SerialPort::readFrame(std::string &out, int max_ms){
+    std::string_view v;
+    if (!readFrame(v, deadlineAfter(max_ms))) { out.clear(); return false; }
+    out.assign(v.data(), v.size());
+    return true;
+}
+
+bool SerialPort::readLine(std::string_view &out, Clock::time_point deadline){
+    if (!readUntil('\n', out, deadline)) return false;
+    if (!out.empty() && out.back() == '\r') out.remove_suffix(1);
+    return true;
+}
+
+bool SerialPort::readFrame(std::string_view &out, Clock::time_point deadline){
+    return readUntil('\0', out, deadline);
+}
 
-    std::string buf;
-    char ch;
-    auto deadline = (max_ms > 0) ? (int)max_ms : -1;
+bool SerialPort::readUntil(char delim, std::string_view &out, Clock::time_point deadline){
+    size_t scanned = 0;   // bytes after rxHead_ already known not to hold `delim`
     while (true){
-        if (deadline >= 0){
-            fd_set rfds; FD_ZERO(&rfds); FD_SET(fd_, &rfds);
-            struct timeval tv{ deadline/1000, (deadline%1000)*1000 };
-            int rv = select(fd_+1, &rfds, nullptr, nullptr, &tv);
-            if (rv <= 0) return false; // timeout or error
+        char *from = rx_ + rxHead_ + scanned;
+        if (auto *p = static_cast<char*>(std::memchr(from, delim, (size_t)(rx_ + rxTail_ - from)))){
+            out = std::string_view(rx_ + rxHead_, (size_t)(p - (rx_ + rxHead_)));
+            rxHead_ = (size_t)(p - rx_) + 1;
+            return true;
         }
-        ssize_t n = ::read(fd_, &ch, 1);
-        if (n == 1){
-            if (ch == '\n') { out = buf; return true; }
-            if (ch != '\r') buf.push_back(ch);
+        scanned = rxTail_ - rxHead_;
+
+        // Make room: move the unread bytes to the front, or drop a record that
+        // cannot fit at all.
+        if (rxHead_ == rxTail_) { rxHead_ = rxTail_ = 0; }
+        if (rxTail_ == kRxSize){
+            if (rxHead_ == 0) { rxTail_ = 0; scanned = 0; }
+            else {
+                std::memmove(rx_, rx_ + rxHead_, rxTail_ - rxHead_);
+                rxTail_ -= rxHead_; rxHead_ = 0;
+            }
+        }
+        if (!fill(deadline)) return false;
+    }
+}
+
+// Waits for input until the deadline and appends it with one large read().
+bool SerialPort::fill(Clock::time_point deadline){
+    if (fd_ < 0) return false;
+    while (true){
+        int timeout = -1;
+        if (deadline != Clock::time_point::max()){
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (left <= 0) return false;
+            timeout = (int)left;
         }
+        pollfd pfd{fd_, POLLIN, 0};
+        int rv = poll(&pfd, 1, timeout);
+        if (rv < 0 && errno == EINTR) continue;
+        if (rv <= 0) return false;   // timeout or error
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) { lost_ = true; return false; }
+
+        ssize_t n = ::read(fd_, rx_ + rxTail_, kRxSize - rxTail_);
+        if (n > 0) { rxTail_ += (size_t)n; rxBytes_->add((uint64_t)n); return true; }
+        if (n == 0 || (errno != EINTR && errno != EAGAIN)) { lost_ = true; return false; }
     }
 }
@@ -1,27 +1,72 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <atomic>
 #include <vector>
+#include <chrono>
+#include <cstddef>
+#include "Metrics.hpp"
 
 // Minimal POSIX serial wrapper (Linux)
+//
+// Reads go through a fixed-size receive buffer filled with large read()s.
+// Lines ('\n') and binary frames (0x00) are split out of it as string_views;
+// bytes after the delimiter stay buffered for the next call, so two replies
+// arriving in one USB packet are both delivered. Only one thread may read.
 class SerialPort {
 public:
     SerialPort();
     ~SerialPort();
 
+    // Any rate the driver accepts: the Bnnn table up to 2 Mbaud, others via
+    // termios2/BOTHER. Fails rather than falling back to another rate.
     bool open(const std::string &device, int baud = 115200);
     void close();
     bool isOpen() const { return fd_ >= 0; }
+    // The device went away under an open fd (unplugged, board reset): hangup,
+    // EOF or an I/O error on read or write. Cleared by open().
+    bool lost() const { return lost_; }
+
+    // Drains pending output, switches the line rate and drops buffered input.
+    // Only while no other thread is reading.
+    bool setBaud(int baud);
+    int baud() const { return baud_; }
 
     // write a full line and append \n
 
     bool writeLine(const std::string &line);
+    // write raw bytes as-is (binary frames)
+    bool write(const std::string &bytes);
+
+    using Clock = std::chrono::steady_clock;
+
+    // Next line (without "\r\n") or 0x00-delimited frame, waiting until the
+    // absolute deadline. The view stays valid until the next read call.
+    bool readLine(std::string_view &out, Clock::time_point deadline);
+    bool readFrame(std::string_view &out, Clock::time_point deadline);
 
     // blocking read of one line (up to max_ms timeout if >0). Returns true if got a line.
     bool readLine(std::string &out, int max_ms = 0);
+    // same, for a 0x00-delimited binary frame (delimiter not included)
+    bool readFrame(std::string &out, int max_ms = 0);
+
+    // Drop anything buffered (e.g. after switching protocol mode).
+    void discardInput() { rxHead_ = rxTail_ = 0; }
 
 private:
+    static constexpr size_t kRxSize = 4096;
+
     int fd_;
+    std::atomic<int> baud_{0};
+    std::atomic<bool> lost_{false};
     std::mutex mtx_;
+    char rx_[kRxSize];
+    size_t rxHead_ = 0, rxTail_ = 0;    // unread bytes are rx_[rxHead_, rxTail_)
+    metrics::Counter *txBytes_ = nullptr;    // labelled with the device by open()
+    metrics::Counter *rxBytes_ = nullptr;
+
     bool configure(int baud);
+    bool readUntil(char delim, std::string_view &out, Clock::time_point deadline);
+    bool fill(Clock::time_point deadline);
 };
@@ -0,0 +1,93 @@
+#include "StatePublisher.hpp"
+#include <chrono>
+
+StatePublisher::StatePublisher(EventHub &hub, int coalesceMs): hub_(hub), coalesceMs_(coalesceMs) {}
+
+StatePublisher::~StatePublisher(){ stop(); }
+
+void StatePublisher::start(const ControllerPool &pool){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!stop_) return;
+        stop_ = false;
+    }
+    pool_ = &pool;
+    th_ = std::thread([this]{ loop(); });
+}
+
+void StatePublisher::stop(){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (th_.joinable()) th_.join();
+}
+
+void StatePublisher::notify(){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        dirty_ = true;
+    }
+    cv_.notify_one();
+}
+
+std::string StatePublisher::statusJson(const ControllerPool &pool, const std::vector<MotorSnapshot> &motors, int64_t now){
+    int64_t sync = pool.lastSyncMs();
+    std::string out = std::string("{\"status\":\"") + (pool.linkFresh(now) ? "STATUS OK" : "NO-REPLY") + "\"";
+    out += ",\"protocol\":\""; out += pool.protocolName(); out += "\"";
+    out += ",\"stale_ms\":" + std::to_string(sync ? now - sync : -1);
+    out += ",\"version\":" + std::to_string(pool.version());
+    out += ",\"motors\":[";
+    bool first = true;
+    for (const auto &m : motors){
+        if (!first) out += ",";
+        first = false;
+        out += "{\"id\":" + std::to_string(m.id)
+             + ",\"speed\":" + std::to_string(m.speedPercent)
+             + ",\"dir\":\"" + (m.dir == Direction::CW ? "CW" : "CCW") + "\""
+             + ",\"enabled\":" + (m.enabled ? "true" : "false")
+             + ",\"version\":" + std::to_string(m.version)
+             + ",\"age_ms\":" + std::to_string(m.lastAckMs ? now - m.lastAckMs : -1) + "}";
+    }
+    out += "]}";
+    return out;
+}
+
+std::string StatePublisher::snapshot() const {
+    if (!pool_) return std::string();
+    return EventHub::format("state", statusJson(*pool_, pool_->readAll(), MotorStateTable::nowMs()));
+}
+
+void StatePublisher::loop(){
+    sent_.assign(pool_->size(), 0);
+    sentFresh_ = pool_->linkFresh(MotorStateTable::nowMs());
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_){
+        cv_.wait_for(lk, std::chrono::seconds(1), [this]{ return stop_ || dirty_; });
+        if (stop_) break;
+        if (dirty_){
+            // Let a burst of acks land so it goes out as one event.
+            cv_.wait_for(lk, std::chrono::milliseconds(coalesceMs_), [this]{ return stop_; });
+            dirty_ = false;
+        }
+        lk.unlock();
+
+        // Nothing counts as sent without a subscriber: one whose snapshot was
+        // taken just before it was counted still gets what changed meanwhile.
+        if (hub_.subscribers()){
+            int64_t now = MotorStateTable::nowMs();
+            std::vector<MotorSnapshot> changed;
+            for (const auto &m : pool_->readAll()){
+                if (m.version == sent_[m.id - 1]) continue;
+                sent_[m.id - 1] = m.version;
+                changed.push_back(m);
+            }
+            bool fresh = pool_->linkFresh(now);
+            if (!changed.empty() || fresh != sentFresh_) hub_.publish("state", statusJson(*pool_, changed, now));
+            sentFresh_ = fresh;
+        }
+
+        lk.lock();
+    }
+}
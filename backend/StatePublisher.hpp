@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "ControllerPool.hpp"
+#include "EventHub.hpp"
+
+// Turns ControllerPool change notifications into "state" events on the
+// EventHub. Notifications are coalesced for a short window; each event
+// carries the link status and only the motors whose version moved since the
+// previous event. Link freshness is re-checked once a second so a silent
+// firmware is reported without any command traffic.
+class StatePublisher {
+public:
+    // Declare before the ControllerPool it watches: late change notifications
+    // from the serial threads may arrive while the controllers shut down.
+    explicit StatePublisher(EventHub &hub, int coalesceMs = 20);
+    ~StatePublisher();
+
+    void start(const ControllerPool &pool);
+    void stop();
+
+    // Cheap, callable from any thread (ControllerPool::setOnChange).
+    void notify();
+
+    // Full "state" event for a new subscriber; empty before start().
+    std::string snapshot() const;
+
+    // Body shared by GET /api/status and the events:
+    // {"status":..,"protocol":..,"stale_ms":..,"version":..,"motors":[..]}
+    static std::string statusJson(const ControllerPool &pool, const std::vector<MotorSnapshot> &motors, int64_t nowMs);
+
+private:
+    void loop();
+
+    const ControllerPool *pool_ = nullptr;
+    EventHub &hub_;
+    int coalesceMs_;
+
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool dirty_ = false;
+    bool stop_ = true;
+
+    std::vector<uint64_t> sent_;    // per-motor version last published (loop thread only)
+    bool sentFresh_ = false;
+};
@@ -0,0 +1,229 @@
+#include "StaticCache.hpp"
+#include "Log.hpp"
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+static std::string guessType(const std::string &path){
+    auto dot = path.rfind('.');
+    std::string ext = dot==std::string::npos ? std::string() : path.substr(dot+1);
+    if (ext=="html" || ext=="htm") return "text/html; charset=utf-8";
+    if (ext=="js" || ext=="mjs") return "application/javascript; charset=utf-8";
+    if (ext=="css") return "text/css; charset=utf-8";
+    if (ext=="json") return "application/json";
+    if (ext=="svg") return "image/svg+xml";
+    if (ext=="png") return "image/png";
+    if (ext=="jpg" || ext=="jpeg") return "image/jpeg";
+    if (ext=="ico") return "image/x-icon";
+    if (ext=="wasm") return "application/wasm";
+    if (ext=="gz") return "application/gzip";
+    return "text/plain; charset=utf-8";
+}
+
+static bool endsWith(const std::string &s, const char *suffix){
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size()-n, n, suffix) == 0;
+}
+
+static bool isRegular(const std::string &path){
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static bool readFile(const std::string &path, std::string &out){
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) < 0) { ::close(fd); return false; }
+    out.resize((size_t)st.st_size);
+    size_t got = 0;
+    while (got < out.size()){
+        ssize_t n = ::read(fd, &out[got], out.size() - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    out.resize(got);
+    ::close(fd);
+    return true;
+}
+
+static uint64_t fnv1a(const std::string &s){
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ULL; }
+    return h;
+}
+
+static std::string buildHeaders(const std::string &type, size_t len, const std::string &etag, const char *encoding){
+    std::string h = "HTTP/1.1 200 OK\r\n";
+    h += "Content-Type: "; h += type; h += "\r\n";
+    h += "Content-Length: "; h += std::to_string(len); h += "\r\n";
+    h += "ETag: "; h += etag; h += "\r\n";
+    h += "Cache-Control: no-cache\r\n";
+    h += "Vary: Accept-Encoding\r\n";
+    if (encoding) { h += "Content-Encoding: "; h += encoding; h += "\r\n"; }
+    return h;
+}
+
+StaticCache::StaticCache(size_t maxCachedBytes): maxCachedBytes_(maxCachedBytes) {}
+StaticCache::~StaticCache(){ stop(); }
+
+bool StaticCache::load(const std::string &root){
+    root_ = root;
+    while (root_.size() > 1 && root_.back()=='/') root_.pop_back();
+
+    struct stat st{};
+    if (stat(root_.c_str(), &st) < 0 || !S_ISDIR(st.st_mode)) {
+        LOG_ERROR("static", "Static dir %s not found", root_.c_str());
+        return false;
+    }
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) LOG_WARN("static", "inotify_init1: %s", std::strerror(errno));   // cache still works, just no reloads
+    scanDir("");
+    {
+        std::shared_lock<std::shared_mutex> lk(mtx_);
+        LOG_INFO("static", "Static cache: %zu files from %s", assets_.size(), root_.c_str());
+    }
+
+    if (inotifyFd_ >= 0){
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        running_ = true;
+        watcher_ = std::thread([this]{ watchLoop(); });
+    }
+    return true;
+}
+
+void StaticCache::stop(){
+    if (running_.exchange(false) && wakeFd_ >= 0){
+        uint64_t one = 1; ssize_t r = ::write(wakeFd_, &one, sizeof(one)); (void)r;
+    }
+    if (watcher_.joinable()) watcher_.join();
+    if (inotifyFd_ >= 0) { ::close(inotifyFd_); inotifyFd_ = -1; }
+    if (wakeFd_ >= 0) { ::close(wakeFd_); wakeFd_ = -1; }
+    watches_.clear();
+}
+
+std::shared_ptr<const StaticCache::Asset> StaticCache::find(const std::string &urlPath) const{
+    std::string key = urlPath;
+    if (key.empty() || key.back()=='/') key += "index.html";
+    if (key.find("..") != std::string::npos) return nullptr;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    auto it = assets_.find(key);
+    return it == assets_.end() ? nullptr : it->second;
+}
+
+void StaticCache::addWatch(const std::string &rel){
+    if (inotifyFd_ < 0) return;
+    int wd = inotify_add_watch(inotifyFd_, (root_ + rel).c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+    if (wd >= 0) watches_[wd] = rel;
+}
+
+void StaticCache::scanDir(const std::string &rel){
+    addWatch(rel);
+    DIR *d = opendir((root_ + rel).c_str());
+    if (!d) return;
+    std::vector<std::string> names;
+    while (dirent *e = readdir(d)){
+        if (e->d_name[0]=='.') continue;
+        names.emplace_back(e->d_name);
+    }
+    closedir(d);
+    for (auto &n : names){
+        std::string child = rel + "/" + n;
+        struct stat st{};
+        if (stat((root_ + child).c_str(), &st) < 0) continue;
+        if (S_ISDIR(st.st_mode)) scanDir(child);
+        else if (S_ISREG(st.st_mode)) loadFile(child);
+    }
+}
+
+// (Re)load one file. "x.gz" is the precompressed form of "x" while "x" exists,
+// so a change to it refreshes the entry for "x"; otherwise it is an asset of its own.
+void StaticCache::loadFile(const std::string &rel){
+    std::string key = rel;
+    if (endsWith(rel, ".gz") && isRegular(root_ + rel.substr(0, rel.size()-3))) key.resize(rel.size()-3);
+    else if (isRegular(root_ + rel + ".gz")){
+        // "x" appeared or went away: "x.gz" flips between sibling and standalone.
+        if (!isRegular(root_ + rel)){
+            { std::unique_lock<std::shared_mutex> lk(mtx_); assets_.erase(rel); }
+            loadFile(rel + ".gz");
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lk(mtx_);
+        assets_.erase(rel + ".gz");
+    }
+    std::string file = root_ + key;
+
+    struct stat st{};
+    if (stat(file.c_str(), &st) < 0 || !S_ISREG(st.st_mode)){
+        std::unique_lock<std::shared_mutex> lk(mtx_);
+        assets_.erase(key);
+        return;
+    }
+
+    auto a = std::make_shared<Asset>();
+    a->file = file;
+    a->size = st.st_size;
+    std::string type = guessType(key);
+    char tag[64];
+    if ((size_t)st.st_size <= maxCachedBytes_ && readFile(file, a->body)){
+        a->cached = true;
+        a->size = (off_t)a->body.size();
+        std::snprintf(tag, sizeof(tag), "\"%016llx-%llx\"", (unsigned long long)fnv1a(a->body), (unsigned long long)a->size);
+        std::string gz;
+        if (readFile(file + ".gz", gz) && gz.size() < a->body.size()) a->gzipBody = std::move(gz);
+    } else {
+        // Too large to keep in memory: identify by inode metadata instead of content.
+        std::snprintf(tag, sizeof(tag), "\"%llx-%llx-%llx\"", (unsigned long long)st.st_ino,
+                      (unsigned long long)st.st_mtime, (unsigned long long)st.st_size);
+    }
+    a->etag = tag;
+    a->headers = buildHeaders(type, (size_t)a->size, a->etag, nullptr);
+    a->notModified = "HTTP/1.1 304 Not Modified\r\nETag: " + a->etag + "\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n";
+    if (!a->gzipBody.empty()){
+        // A different representation needs a different strong validator.
+        a->gzipEtag = a->etag.substr(0, a->etag.size() - 1) + "-gz\"";
+        a->gzipHeaders = buildHeaders(type, a->gzipBody.size(), a->gzipEtag, "gzip");
+        a->gzipNotModified = "HTTP/1.1 304 Not Modified\r\nETag: " + a->gzipEtag + "\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n";
+    }
+
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    assets_[key] = std::move(a);
+}
+
+void StaticCache::watchLoop(){
+    alignas(inotify_event) char buf[8192];
+    pollfd pfds[2] = {{inotifyFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    while (running_){
+        int rv = poll(pfds, 2, -1);
+        if (rv < 0) { if (errno == EINTR) continue; LOG_ERROR("static", "poll: %s", std::strerror(errno)); return; }
+        if (pfds[1].revents) return;
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) continue;
+        for (char *p = buf; p < buf + n; ){
+            auto *ev = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + ev->len;
+            auto it = watches_.find(ev->wd);
+            if (it == watches_.end() || ev->len == 0 || ev->name[0]=='.') continue;
+            std::string rel = it->second + "/" + ev->name;
+            if (ev->mask & IN_ISDIR){
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) scanDir(rel);
+                continue;
+            }
+            loadFile(rel);
+            LOG_INFO("static", "Static cache: reloaded %s", rel.c_str());
+        }
+    }
+}
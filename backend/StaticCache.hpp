@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <sys/types.h>
+
+// In-memory cache of the static directory. Every file is read once at startup
+// together with its pre-built response headers and a strong ETag; a sibling
+// "<file>.gz" is kept as a precompressed variant with its own ETag. Files larger than
+// maxCachedBytes are only indexed and are served from disk with sendfile().
+// An inotify thread reloads entries when files change on disk.
+class StaticCache {
+public:
+    struct Asset {
+        std::string file;           // path on disk
+        std::string etag;           // quoted, e.g. "\"3fa1c2-1a2b\""
+        std::string gzipEtag;       // etag with "-gz" inside the quotes
+        std::string body;           // file contents (empty when !cached)
+        std::string gzipBody;       // precompressed variant, empty if none
+        std::string headers;        // status line .. Content-Length, no trailing blank line
+        std::string gzipHeaders;
+        std::string notModified;    // full 304 head, no trailing blank line
+        std::string gzipNotModified;
+        off_t size = 0;
+        bool cached = false;
+    };
+
+    explicit StaticCache(size_t maxCachedBytes = 1 << 20);
+    ~StaticCache();
+
+    bool load(const std::string &root);
+    void stop();
+
+    // urlPath without query string, e.g. "/" or "/index.html"
+    std::shared_ptr<const Asset> find(const std::string &urlPath) const;
+
+private:
+    void scanDir(const std::string &rel);
+    void loadFile(const std::string &rel);
+    void watchLoop();
+    void addWatch(const std::string &rel);
+
+    size_t maxCachedBytes_;
+    std::string root_;
+    mutable std::shared_mutex mtx_;
+    std::unordered_map<std::string, std::shared_ptr<const Asset>> assets_;   // key: "/rel/path"
+
+    int inotifyFd_ = -1;
+    int wakeFd_ = -1;
+    std::unordered_map<int, std::string> watches_;   // wd -> relative dir ("" for root)
+    std::thread watcher_;
+    std::atomic<bool> running_{false};
+};
@@ -0,0 +1,316 @@
+#include "TelemetryHistory.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+constexpr uint8_t kCcw = 0x01, kEnabled = 0x02;
+
+int velocity(const MotorSnapshot &m){
+    if (!m.enabled) return 0;
+    return m.dir == Direction::CCW ? -m.speedPercent : m.speedPercent;
+}
+
+template <class T>
+void reserve(std::vector<T> &v, size_t n){ v.assign(n, T()); }
+
+}
+
+void TelemetryHistory::Acc::add(const Acc &o){
+    if (!o.n) return;
+    if (!n) { min = o.min; max = o.max; }
+    else { min = std::min(min, o.min); max = std::max(max, o.max); }
+    n += o.n; sum += o.sum;
+    latSum += o.latSum; latN += o.latN; latMax = std::max(latMax, o.latMax);
+}
+
+TelemetryHistory::TelemetryHistory(Config cfg): cfg_(cfg) {
+    cfg_.raw = std::max<size_t>(cfg_.raw, 16);
+    cfg_.sec = std::max<size_t>(cfg_.sec, 16);
+    cfg_.min = std::max<size_t>(cfg_.min, 16);
+    cfg_.tickMs = std::max(cfg_.tickMs, 10);
+    baseSteadyMs_ = MotorStateTable::nowMs();
+    baseEpochMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+TelemetryHistory::~TelemetryHistory(){ stop(); }
+
+void TelemetryHistory::start(const ControllerPool &pool){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!stop_) return;
+        stop_ = false;
+    }
+    pool_ = &pool;
+    series_.clear();
+    series_.resize(pool.size());
+    for (int id = 1; id <= pool.size(); ++id){
+        if (!pool.has(id)) continue;
+        auto s = std::make_unique<Series>();
+        s->rawRing.cap = cfg_.raw;
+        reserve(s->raw.t, cfg_.raw); reserve(s->raw.speed, cfg_.raw); reserve(s->raw.flags, cfg_.raw); reserve(s->raw.latUs, cfg_.raw);
+        auto sizeAgg = [](Agg &a, Ring &r, size_t n){
+            r.cap = n;
+            reserve(a.t, n); reserve(a.n, n); reserve(a.min, n); reserve(a.max, n);
+            reserve(a.sum, n); reserve(a.latAvg, n); reserve(a.latMax, n);
+        };
+        sizeAgg(s->sec, s->secRing, cfg_.sec);
+        sizeAgg(s->min, s->minRing, cfg_.min);
+        series_[id - 1] = std::move(s);
+    }
+    bytes_.set((int64_t)bytes());
+    LOG_INFO("history", "telemetry history: %zu raw, %zu x 1s, %zu x 1min per motor, %zu KiB",
+             cfg_.raw, cfg_.sec, cfg_.min, bytes() / 1024);
+    th_ = std::thread([this]{ loop(); });
+}
+
+void TelemetryHistory::stop(){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (th_.joinable()) th_.join();
+}
+
+void TelemetryHistory::notify(){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        dirty_ = true;
+    }
+    cv_.notify_one();
+}
+
+size_t TelemetryHistory::bytes() const {
+    size_t perRaw = sizeof(int64_t) + sizeof(uint32_t) + 2;
+    size_t perAgg = sizeof(int64_t) + sizeof(uint32_t) * 3 + 2 + sizeof(int32_t);
+    size_t motors = 0;
+    for (const auto &s : series_) motors += s != nullptr;
+    return motors * (cfg_.raw * perRaw + (cfg_.sec + cfg_.min) * perAgg + sizeof(Series));
+}
+
+int64_t TelemetryHistory::nowEpochMs() const {
+    return baseEpochMs_ + (MotorStateTable::nowMs() - baseSteadyMs_);
+}
+
+int64_t TelemetryHistory::sinceBase(int64_t steadyMs) const {
+    return std::max<int64_t>(0, steadyMs - baseSteadyMs_);
+}
+
+void TelemetryHistory::loop(){
+    int64_t nextTick = 0;
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_){
+        int64_t now = MotorStateTable::nowMs();
+        if (!dirty_ && now < nextTick)
+            cv_.wait_for(lk, std::chrono::milliseconds(nextTick - now), [this]{ return stop_ || dirty_; });
+        if (stop_) break;
+        dirty_ = false;
+        lk.unlock();
+
+        now = MotorStateTable::nowMs();
+        bool tick = now >= nextTick;
+        if (tick) nextTick = now + cfg_.tickMs;
+        int64_t t = sinceBase(now);
+        size_t n = 0;
+        for (const auto &m : pool_->readAll()){
+            Series *s = m.id >= 1 && (size_t)m.id <= series_.size() ? series_[m.id - 1].get() : nullptr;
+            if (!s || (!tick && s->seen && m.version == s->lastVersion)) continue;
+            s->seen = true;
+            s->lastVersion = m.version;
+            sample(*s, m, t);
+            ++n;
+        }
+        samples_.add(n);
+
+        lk.lock();
+    }
+}
+
+void TelemetryHistory::flush(Agg &agg, Ring &ring, const Acc &acc){
+    size_t i = ring.push();
+    agg.t[i] = acc.start;
+    agg.n[i] = acc.n;
+    agg.min[i] = (int8_t)acc.min;
+    agg.max[i] = (int8_t)acc.max;
+    agg.sum[i] = (int32_t)acc.sum;     // |v| <= 100, so fine up to 20M samples per bucket
+    agg.latAvg[i] = acc.latN ? (uint32_t)(acc.latSum / acc.latN) : 0;
+    agg.latMax[i] = acc.latMax;
+}
+
+// Appends a raw sample and rolls the open 1 s bucket over into the 1 min
+// bucket, and that into its ring, when the sample starts a new period.
+void TelemetryHistory::sample(Series &s, const MotorSnapshot &m, int64_t t){
+    int v = velocity(m);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    size_t i = s.rawRing.push();
+    s.raw.t[i] = t;
+    s.raw.speed[i] = (uint8_t)std::min(std::max(m.speedPercent, 0), 100);
+    s.raw.flags[i] = (m.dir == Direction::CCW ? kCcw : 0) | (m.enabled ? kEnabled : 0);
+    s.raw.latUs[i] = m.ackLatencyUs;
+
+    int64_t sec = t - t % 1000;
+    if (s.secAcc.n && s.secAcc.start != sec){
+        flush(s.sec, s.secRing, s.secAcc);
+        int64_t minute = s.secAcc.start - s.secAcc.start % 60000;
+        if (s.minAcc.n && s.minAcc.start != minute){
+            flush(s.min, s.minRing, s.minAcc);
+            s.minAcc = Acc();
+        }
+        if (!s.minAcc.n) s.minAcc.start = minute;
+        s.minAcc.add(s.secAcc);
+        s.secAcc = Acc();
+    }
+    Acc one;
+    one.n = 1; one.min = one.max = v; one.sum = v;
+    if (m.ackLatencyUs) { one.latSum = m.ackLatencyUs; one.latN = 1; one.latMax = m.ackLatencyUs; }
+    if (!s.secAcc.n) s.secAcc.start = sec;
+    s.secAcc.add(one);
+}
+
+bool TelemetryHistory::parseRes(const std::string &s, Res &out){
+    if (s == "auto") out = Res::Auto;
+    else if (s == "raw") out = Res::Raw;
+    else if (s == "1s") out = Res::Sec;
+    else if (s == "1m") out = Res::Min;
+    else return false;
+    return true;
+}
+
+const char *TelemetryHistory::resName(Res r){
+    return r == Res::Auto ? "auto" : r == Res::Raw ? "raw" : r == Res::Sec ? "1s" : "1m";
+}
+
+namespace {
+
+// [lo, hi) of ring positions with from <= t <= to; times are ascending.
+template <class Ring>
+std::pair<size_t, size_t> window(const Ring &ring, const std::vector<int64_t> &t, int64_t from, int64_t to){
+    auto lower = [&](int64_t x){
+        size_t lo = 0, hi = ring.count;
+        while (lo < hi){
+            size_t mid = (lo + hi) / 2;
+            if (t[ring.slot(mid)] < x) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    };
+    return {lower(from), lower(to + 1)};
+}
+
+void appendNum(std::string &out, int64_t v, bool &first){
+    if (!first) out += ',';
+    first = false;
+    out += std::to_string(v);
+}
+
+}
+
+bool TelemetryHistory::query(int motor, int64_t fromMs, int64_t toMs, Res res, size_t maxPoints, std::string &out) const {
+    if (motor < 1 || (size_t)motor > series_.size() || !series_[motor - 1]) return false;
+    const Series &s = *series_[motor - 1];
+    int64_t from = fromMs - baseEpochMs_, to = toMs - baseEpochMs_;
+    if (maxPoints == 0) maxPoints = 1;
+
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto rawWin = window(s.rawRing, s.raw.t, from, to);
+    auto secWin = window(s.secRing, s.sec.t, from, to);
+    auto minWin = window(s.minRing, s.min.t, from, to);
+    if (res == Res::Auto){
+        // A tier qualifies if it still reaches back to `from` and is small enough.
+        auto covers = [&](const Ring &r, const std::vector<int64_t> &t){
+            return r.count < r.cap || (r.count && t[r.slot(0)] <= from);
+        };
+        if (covers(s.rawRing, s.raw.t) && rawWin.second - rawWin.first <= maxPoints) res = Res::Raw;
+        else if (covers(s.secRing, s.sec.t) && secWin.second - secWin.first < maxPoints) res = Res::Sec;
+        else res = Res::Min;
+    }
+
+    out = "{\"motor\":" + std::to_string(motor) + ",\"res\":\"" + resName(res) + "\"";
+    if (res == Res::Raw){
+        size_t lo = rawWin.first, hi = rawWin.second;
+        bool truncated = hi - lo > maxPoints;
+        if (truncated) lo = hi - maxPoints;
+        int64_t t0 = lo < hi ? baseEpochMs_ + s.raw.t[s.rawRing.slot(lo)] : 0;
+        out += ",\"t0\":" + std::to_string(t0) + ",\"dt\":[";
+        bool first = true; int64_t prev = lo < hi ? s.raw.t[s.rawRing.slot(lo)] : 0;
+        for (size_t i = lo; i < hi; ++i) { int64_t t = s.raw.t[s.rawRing.slot(i)]; appendNum(out, t - prev, first); prev = t; }
+        out += "],\"speed\":[";
+        first = true;
+        for (size_t i = lo; i < hi; ++i) appendNum(out, s.raw.speed[s.rawRing.slot(i)], first);
+        out += "],\"dir\":\"";
+        for (size_t i = lo; i < hi; ++i) out += (s.raw.flags[s.rawRing.slot(i)] & kCcw) ? 'A' : 'C';
+        out += "\",\"on\":\"";
+        for (size_t i = lo; i < hi; ++i) out += (s.raw.flags[s.rawRing.slot(i)] & kEnabled) ? '1' : '0';
+        out += "\",\"lat_us\":[";
+        first = true;
+        for (size_t i = lo; i < hi; ++i) appendNum(out, s.raw.latUs[s.rawRing.slot(i)], first);
+        out += "],\"truncated\":"; out += truncated ? "true" : "false";
+        out += "}";
+        return true;
+    }
+
+    const Agg &agg = res == Res::Sec ? s.sec : s.min;
+    const Ring &ring = res == Res::Sec ? s.secRing : s.minRing;
+    auto win = res == Res::Sec ? secWin : minWin;
+    // The open bucket is reported too, as the last point.
+    Acc open = res == Res::Sec ? s.secAcc : s.minAcc;
+    if (res == Res::Min && s.secAcc.n){
+        int64_t minute = s.secAcc.start - s.secAcc.start % 60000;
+        if (!open.n) open.start = minute;
+        if (open.start == minute) open.add(s.secAcc);
+    }
+    bool withOpen = open.n && open.start >= from && open.start <= to;
+    size_t lo = win.first, hi = win.second, total = hi - lo + withOpen;
+    bool truncated = total > maxPoints;
+    if (truncated) lo += total - maxPoints;
+
+    struct Point { int64_t t; int min, max; double avg; uint32_t latAvg, latMax; };
+    std::vector<Point> pts;
+    pts.reserve(hi - lo + 1);
+    for (size_t i = lo; i < hi; ++i){
+        size_t k = ring.slot(i);
+        pts.push_back({agg.t[k], agg.min[k], agg.max[k], agg.n[k] ? (double)agg.sum[k] / agg.n[k] : 0.0, agg.latAvg[k], agg.latMax[k]});
+    }
+    if (withOpen)
+        pts.push_back({open.start, open.min, open.max, (double)open.sum / open.n,
+                       open.latN ? (uint32_t)(open.latSum / open.latN) : 0, open.latMax});
+
+    out += ",\"t0\":" + std::to_string(pts.empty() ? 0 : baseEpochMs_ + pts.front().t) + ",\"dt\":[";
+    bool first = true; int64_t prev = pts.empty() ? 0 : pts.front().t;
+    for (const auto &p : pts) { appendNum(out, p.t - prev, first); prev = p.t; }
+    out += "],\"min\":[";
+    first = true;
+    for (const auto &p : pts) appendNum(out, p.min, first);
+    out += "],\"max\":[";
+    first = true;
+    for (const auto &p : pts) appendNum(out, p.max, first);
+    out += "],\"avg\":[";
+    first = true;
+    char buf[32];
+    for (const auto &p : pts){
+        if (!first) out += ',';
+        first = false;
+        std::snprintf(buf, sizeof(buf), "%.1f", p.avg);
+        out += buf;
+    }
+    out += "],\"lat_avg_us\":[";
+    first = true;
+    for (const auto &p : pts) appendNum(out, p.latAvg, first);
+    out += "],\"lat_max_us\":[";
+    first = true;
+    for (const auto &p : pts) appendNum(out, p.latMax, first);
+    out += "],\"truncated\":"; out += truncated ? "true" : "false";
+    out += "}";
+    return true;
+}
+
+std::string TelemetryHistory::configJson() const {
+    size_t motors = 0;
+    for (const auto &s : series_) motors += s != nullptr;
+    return "{\"motors\":" + std::to_string(motors) + ",\"tick_ms\":" + std::to_string(cfg_.tickMs)
+         + ",\"raw\":" + std::to_string(cfg_.raw) + ",\"1s\":" + std::to_string(cfg_.sec)
+         + ",\"1m\":" + std::to_string(cfg_.min) + ",\"bytes\":" + std::to_string(bytes())
+         + ",\"now\":" + std::to_string(nowEpochMs()) + "}";
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ControllerPool.hpp"
+#include "Metrics.hpp"
+
+// Fixed-memory telemetry history per motor: commanded speed, direction,
+// enabled and last ack latency. Every sample lands in a raw ring; samples
+// are folded as they arrive into 1 s buckets and those into 1 min buckets
+// (signed speed min/max/avg, latency avg/max), each tier a ring of its own.
+// All rings are structure-of-arrays, sized once in start(). Samples
+// are taken whenever the pool reports a change and on every tick.
+// Queries binary-search the tier by time, so they cost O(log n + points).
+class TelemetryHistory {
+public:
+    enum class Res { Auto, Raw, Sec, Min };
+
+    struct Config {
+        size_t raw = 3600;      // samples per motor
+        size_t sec = 3600;      // 1 s buckets (1 h)
+        size_t min = 1440;      // 1 min buckets (24 h)
+        int tickMs = 1000;
+    };
+
+    // Declare before the ControllerPool it watches (see StatePublisher).
+    explicit TelemetryHistory(Config cfg);
+    ~TelemetryHistory();
+
+    void start(const ControllerPool &pool);
+    void stop();
+
+    // Cheap, callable from any thread (ControllerPool::setOnChange).
+    void notify();
+
+    // `fromMs`/`toMs` are wall-clock epoch ms. Returns false for an unknown
+    // motor. At most `maxPoints`, the newest ones if the window holds more.
+    // Res::Auto takes the finest tier that reaches back to `fromMs` and fits.
+    // {"motor":1,"res":"1s","t0":<epoch ms>,"dt":[..],"min":[..],"max":[..],"avg":[..],
+    //  "lat_avg_us":[..],"lat_max_us":[..],"truncated":false}
+    // Raw has "speed","dir" ("C"/"A" per sample), "on" ("1"/"0") and "lat_us" instead.
+    // Speeds in aggregates are signed: negative is CCW, 0 when disabled.
+    bool query(int motor, int64_t fromMs, int64_t toMs, Res res, size_t maxPoints, std::string &out) const;
+
+    static bool parseRes(const std::string &s, Res &out);   // "auto", "raw", "1s", "1m"
+    static const char *resName(Res r);
+
+    int64_t nowEpochMs() const;
+    size_t bytes() const;
+    // {"motors":..,"tick_ms":..,"raw":..,"1s":..,"1m":..,"bytes":..}
+    std::string configJson() const;
+
+private:
+    struct Raw {
+        std::vector<int64_t> t;         // ms since base
+        std::vector<uint8_t> speed, flags;
+        std::vector<uint32_t> latUs;
+    };
+    struct Agg {
+        std::vector<int64_t> t;         // bucket start, ms since base
+        std::vector<uint32_t> n;
+        std::vector<int8_t> min, max;
+        std::vector<int32_t> sum;
+        std::vector<uint32_t> latAvg, latMax;
+    };
+    struct Ring {
+        size_t cap = 0, head = 0, count = 0;    // head = next slot to write
+        size_t slot(size_t i) const { return (head + cap - count + i) % cap; }  // i = 0 oldest
+        size_t push() { size_t s = head; head = (head + 1) % cap; if (count < cap) ++count; return s; }
+    };
+    // Open bucket: exact sums until it is flushed into its ring.
+    struct Acc {
+        int64_t start = 0;
+        uint32_t n = 0;
+        int min = 0, max = 0;
+        int64_t sum = 0;
+        uint64_t latSum = 0;
+        uint32_t latN = 0, latMax = 0;
+        void add(const Acc &o);
+    };
+    struct Series {
+        mutable std::mutex mtx;
+        Raw raw; Ring rawRing;
+        Agg sec; Ring secRing;
+        Agg min; Ring minRing;
+        Acc secAcc, minAcc;
+        uint64_t lastVersion = 0;
+        bool seen = false;
+    };
+
+    void loop();
+    void sample(Series &s, const MotorSnapshot &m, int64_t t);
+    void flush(Agg &agg, Ring &ring, const Acc &acc);
+    int64_t sinceBase(int64_t steadyMs) const;
+
+    Config cfg_;
+    const ControllerPool *pool_ = nullptr;
+    std::vector<std::unique_ptr<Series>> series_;   // by global id - 1
+    int64_t baseSteadyMs_ = 0, baseEpochMs_ = 0;
+
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool dirty_ = false;
+    bool stop_ = true;
+
+    metrics::Counter &samples_ = metrics::counter("history_samples_total", "Telemetry samples recorded over all motors");
+    metrics::Gauge &bytes_ = metrics::gauge("history_bytes", "Memory reserved for telemetry history");
+};
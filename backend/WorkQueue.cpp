@@ -0,0 +1,96 @@
+#include "WorkQueue.hpp"
+#include <algorithm>
+
+WorkQueue::WorkQueue() {}
+WorkQueue::~WorkQueue(){ stop(); }
+
+bool WorkQueue::start(int threads, std::vector<Lane> lanes){
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (running_ || lanes.empty()) return false;
+    lanes_.clear();
+    for (auto &l : lanes){
+        LaneState s;
+        std::string label = "lane=\"" + l.name + "\"";
+        s.depth = &metrics::gauge("http_queue_depth", "API requests waiting for a worker", label);
+        s.rejected = &metrics::counter("http_rejected_total", "API requests refused because their lane was full", label);
+        s.expired = &metrics::counter("http_deadline_expired_total", "API requests dropped at their deadline before running", label);
+        s.wait = &metrics::histogram("http_queue_wait_seconds", "Time from admission to a worker picking the request up", label);
+        s.cfg = std::move(l);
+        if (s.cfg.maxRunning < 1) s.cfg.maxRunning = 1;
+        lanes_.push_back(std::move(s));
+    }
+    running_ = true;
+    for (int i = 0; i < std::max(1, threads); ++i) threads_.emplace_back([this]{ loop(); });
+    return true;
+}
+
+void WorkQueue::stop(){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    for (auto &t : threads_) if (t.joinable()) t.join();
+    threads_.clear();
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto &l : lanes_) { l.q.clear(); l.depth->set(0); }
+}
+
+WorkQueue::Admit WorkQueue::submit(int lane, Clock::time_point deadline, Task task){
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!running_ || lane < 0 || lane >= (int)lanes_.size()) return Admit::Stopped;
+        LaneState &l = lanes_[lane];
+        if (l.q.size() >= l.cfg.maxQueued) { l.rejected->add(); return Admit::LaneFull; }
+        l.q.push_back(Item{std::move(task), deadline, Clock::now()});
+        l.depth->set((int64_t)l.q.size());
+    }
+    cv_.notify_one();
+    return Admit::Ok;
+}
+
+// Expired heads are served regardless of the lane's running limit.
+int WorkQueue::pick(Clock::time_point now, Clock::time_point &wakeAt) const {
+    int best = -1;
+    wakeAt = Clock::time_point::max();
+    for (size_t i = 0; i < lanes_.size(); ++i){
+        const LaneState &l = lanes_[i];
+        if (l.q.empty()) continue;
+        const Item &head = l.q.front();
+        if (head.deadline <= now) return (int)i;
+        wakeAt = std::min(wakeAt, head.deadline);
+        if (l.running >= l.cfg.maxRunning) continue;
+        if (best < 0 || head.queuedAt < lanes_[best].q.front().queuedAt) best = (int)i;
+    }
+    return best;
+}
+
+void WorkQueue::loop(){
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (running_){
+        auto now = Clock::now();
+        Clock::time_point wakeAt;
+        int i = pick(now, wakeAt);
+        if (i < 0){
+            if (wakeAt == Clock::time_point::max()) cv_.wait(lk);
+            else cv_.wait_until(lk, wakeAt);
+            continue;
+        }
+        LaneState &l = lanes_[i];
+        Item item = std::move(l.q.front());
+        l.q.pop_front();
+        l.depth->set((int64_t)l.q.size());
+        bool expired = item.deadline <= now;
+        if (expired) l.expired->add();
+        else { l.running++; l.wait->observe(now - item.queuedAt); }
+        lk.unlock();
+
+        item.task(expired);
+
+        lk.lock();
+        if (!expired){
+            l.running--;
+            cv_.notify_one();   // a slot in this lane opened up
+        }
+    }
+}
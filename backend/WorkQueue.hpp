@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Metrics.hpp"
+
+// Fixed pool of threads running tasks from bounded per-lane FIFOs. Each lane
+// caps how many of its tasks run at once and how many may wait; a full lane
+// rejects at submit time instead of growing. Across lanes the oldest runnable
+// task goes first. A task still queued at its deadline is not run: it is
+// called with expired=true so it can report the failure cheaply.
+class WorkQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void(bool expired)>;
+
+    struct Lane {
+        std::string name;
+        int maxRunning = 4;
+        size_t maxQueued = 64;
+    };
+
+    enum class Admit { Ok, LaneFull, Stopped };
+
+    WorkQueue();
+    ~WorkQueue();
+
+    bool start(int threads, std::vector<Lane> lanes);
+    // Waits for running tasks; queued ones are dropped without being called.
+    void stop();
+
+    Admit submit(int lane, Clock::time_point deadline, Task task);
+
+    bool running() const { return running_; }
+
+private:
+    struct Item {
+        Task task;
+        Clock::time_point deadline, queuedAt;
+    };
+    struct LaneState {
+        Lane cfg;
+        std::deque<Item> q;
+        int running = 0;
+        metrics::Gauge *depth = nullptr;
+        metrics::Counter *rejected = nullptr;
+        metrics::Counter *expired = nullptr;
+        metrics::Histogram *wait = nullptr;
+    };
+
+    void loop();
+    // caller holds mtx_; index of the lane to serve next or -1, `wakeAt` = next deadline to check
+    int pick(Clock::time_point now, Clock::time_point &wakeAt) const;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<LaneState> lanes_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{false};
+};
@@ -1,19 +1,112 @@
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
-#include <regex>
 #include <string>
 #include <algorithm>  // for std::min/std::max
 #include <cctype>
 #include "HttpServer.hpp"
-#include "MotorController.hpp"
+#include "ControllerPool.hpp"
+#include "Journal.hpp"
+#include "StatePublisher.hpp"
+#include "TelemetryHistory.hpp"
+#include "MotionEngine.hpp"
+#include "Router.hpp"
+#include "Log.hpp"
+
+// Parses the POST /api/motors body:
+//   [{"id":1,"action":"start","speed":40,"dir":"CW"}, {"id":2,"action":"stop"}, ...]
+// Only flat objects with string/number values are accepted; id and speed must
+// be numbers, dir and action strings. Error texts never echo the body back.
+static bool parseBatch(const std::string &body, const ControllerPool &pool, std::vector<MotorCommand> &out, std::string &err){
+    size_t i = 0;
+    auto ws = [&]{ while (i < body.size() && std::isspace((unsigned char)body[i])) ++i; };
+    auto expect = [&](char ch){ ws(); if (i < body.size() && body[i]==ch) { ++i; return true; } return false; };
+    auto str = [&](std::string &s){
+        ws(); if (i >= body.size() || body[i] != '"') return false;
+        size_t e = body.find('"', ++i); if (e == std::string::npos) return false;
+        s = body.substr(i, e - i); i = e + 1; return true;
+    };
+
+    if (!expect('[')) { err = "expected JSON array"; return false; }
+    if (expect(']')) return true;
+    do {
+        if (!expect('{')) { err = "expected object"; return false; }
+        MotorCommand c; std::string action = "set";
+        bool haveId = false;
+        if (!expect('}')) {
+            do {
+                std::string key, sval; long nval = 0; bool isNum = false;
+                if (!str(key) || !expect(':')) { err = "bad key"; return false; }
+                ws();
+                if (i < body.size() && body[i]=='"') { if (!str(sval)) { err = "bad string"; return false; } }
+                else {
+                    char *end = nullptr; nval = std::strtol(body.c_str() + i, &end, 10);
+                    if (end == body.c_str() + i) { err = "bad value"; return false; }
+                    i = (size_t)(end - body.c_str()); isNum = true;
+                }
+                if ((key == "id" || key == "speed") && !isNum) { err = key + " must be a number"; return false; }
+                if ((key == "dir" || key == "action") && isNum) { err = key + " must be a string"; return false; }
+                if (key == "id") { c.id = (int)nval; haveId = true; }
+                else if (key == "speed") c.speedPercent = std::max(0, std::min(100, (int)nval));
+                else if (key == "dir") c.dir = (sval.rfind("CCW", 0) == 0 || sval.rfind("ccw", 0) == 0) ? Direction::CCW : Direction::CW;
+                else if (key == "action") action = sval;
+            } while (expect(','));
+            if (!expect('}')) { err = "unterminated object"; return false; }
+        }
+        if (!haveId || !pool.has(c.id)) { err = "unknown motor id"; return false; }
+        if (action == "start") c.action = MotorAction::Start;
+        else if (action == "stop") c.action = MotorAction::Stop;
+        else if (action == "set") c.action = MotorAction::Set;
+        else { err = "invalid action"; return false; }
+        out.push_back(c);
+    } while (expect(','));
+    if (!expect(']')) { err = "expected ]"; return false; }
+    return true;
+}
+
+// "dir" query value: anything starting with CCW (any case, surrounding spaces
+// ignored) is counter-clockwise, everything else clockwise.
+static Direction parseDir(std::string_view v){
+    while (!v.empty() && std::isspace((unsigned char)v.front())) v.remove_prefix(1);
+    if (v.size() < 3) return Direction::CW;
+    for (size_t i = 0; i < 3; ++i)
+        if (std::toupper((unsigned char)v[i]) != "CCW"[i]) return Direction::CW;
+    return Direction::CCW;
+}
+
+// strtod on a query value; `def` if absent or not a number.
+static double queryNum(const Router::Request &req, std::string_view key, double def){
+    std::string v(req.query(key));
+    char *end = nullptr;
+    double d = std::strtod(v.c_str(), &end);
+    return v.empty() || end != v.c_str() + v.size() ? def : d;
+}
+
+// ?delay_ms=N (from now) or ?at_ms=<epoch ms>: when motor commands should
+// take effect, as host steady time (ClockSync::nowUs()); atUs stays 0 if
+// neither is given. False for anything outside the next 30 s.
+static bool queryAt(const Router::Request &req, int64_t &atUs, int64_t &epochMs){
+    constexpr int64_t kMaxAheadMs = 30000;
+    atUs = 0;
+    int64_t nowEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    double delay = queryNum(req, "delay_ms", -1), at = queryNum(req, "at_ms", -1);
+    if (delay < 0 && at < 0) return !req.query("delay_ms").size() && !req.query("at_ms").size();
+    int64_t ahead = delay >= 0 ? (int64_t)delay : (int64_t)at - nowEpoch;
+    if (ahead < -1000 || ahead > kMaxAheadMs) return false;   // a second of client clock skew is let through
+    ahead = std::max<int64_t>(ahead, 0);
+    atUs = ClockSync::nowUs() + ahead * 1000;
+    epochMs = nowEpoch + ahead;
+    return true;
+}
 
 int main() {
-    const char* serialEnv = std::getenv("SERIAL_PORT");
-    std::string serial = serialEnv ? std::string(serialEnv) : std::string();
-    if (serial.empty()) {
-        std::cerr << "Set SERIAL_PORT to your Arduino device (e.g., /dev/serial/by-id/...)\n";
-        return 1;
-    }
+    // LOG_LEVEL=trace|debug|info|warn|error|off (default info); POST /api/log?level=.. at runtime.
+    logging::Level logLevel = logging::Level::Info;
+    const char* logEnv = std::getenv("LOG_LEVEL");
+    if (logEnv) logging::parseLevel(logEnv, logLevel);
+    logging::setLevel(logLevel);
+    logging::start();
+    std::atexit([]{ logging::stop(); });
 
     const char* portEnv = std::getenv("PORT");
     int port = portEnv ? std::atoi(portEnv) : 5173;
@@ -21,121 +114,363 @@ int main() {
     const char* staticEnv = std::getenv("STATIC_DIR");
     std::string staticDir = staticEnv ? std::string(staticEnv) : std::string("./public");
 
-    MotorController mc;
-    if (!mc.connect(serial)) return 2;
+    // SERIAL_PROTOCOL=ascii keeps the text protocol; default negotiates binary frames.
+    const char* protoEnv = std::getenv("SERIAL_PROTOCOL");
+    bool preferBinary = !(protoEnv && std::string(protoEnv) == "ascii");
 
-    HttpServer http;
-auto handler = [&mc](const std::string& method,
-                     const std::string& path,
-                     const std::string& body,
-                     int& status,
-                     std::string& ctype) -> std::string {
-    (void)body;
-    ctype = "application/json";
-
-    // Debug: see exactly what we got
-    std::cerr << "DEBUG handler: method=" << method
-              << " path='" << path << "'" << std::endl;
-
-    // 1) /api/status
-    if (path == "/api/status") {
-        auto s = mc.status();
-        status = 200;
-        return std::string("{\"status\":\"") + (s ? *s : "NO-REPLY") + "\"}";
-    }
+    // SERIAL_BAUD: rate the port opens at (default 115200); SERIAL_MAX_BAUD:
+    // fastest rate to negotiate with the firmware (default 2000000, 0 stays
+    // at SERIAL_BAUD). MOTOR_MAP lines can override both.
+    PortConfig portDefaults;
+    portDefaults.preferBinary = preferBinary;
+    const char* baudEnv = std::getenv("SERIAL_BAUD");
+    if (baudEnv) portDefaults.baud = std::atoi(baudEnv);
+    const char* maxBaudEnv = std::getenv("SERIAL_MAX_BAUD");
+    portDefaults.maxBaud = maxBaudEnv ? std::atoi(maxBaudEnv) : 2000000;
 
-    // 2) /api/motor/{id}/{start|stop|set}?speed=..&dir=..
-    std::smatch m;
-    std::regex rSet(R"(^/api/motor/(\d+)/(start|stop|set)(?:\?([^#]*))?$)");
+    // SERIAL_PROBE: STATUS commands in the startup link probe (0 skips it)
+    const char* probeEnv = std::getenv("SERIAL_PROBE");
+    int probeCount = std::max(0, probeEnv ? std::atoi(probeEnv) : 200);
 
-    if (std::regex_match(path, m, rSet)) {
-        int id = std::stoi(m[1]);
-        std::string cmd = m[2];
-        std::string qs  = (m.size() > 3 && m[3].matched) ? m[3].str() : "";
+    // LINK_DOWN_POLICY=queue|reject: while a port is down (unplugged, board
+    // reset) its commands wait for the reconnect, at most LINK_QUEUE_MS
+    // (default 2000), or fail at once (HTTP 503).
+    MotorController::LinkPolicy linkPolicy;
+    const char* linkPolicyEnv = std::getenv("LINK_DOWN_POLICY");
+    if (linkPolicyEnv && std::string(linkPolicyEnv) == "reject") linkPolicy.queue = false;
+    const char* linkQueueEnv = std::getenv("LINK_QUEUE_MS");
+    if (linkQueueEnv) linkPolicy.queueMs = std::max(0, std::atoi(linkQueueEnv));
 
-        std::cerr << "DEBUG match: id=" << id
-                  << " cmd=" << cmd
-                  << " qs='" << qs << "'" << std::endl;
+    // CLOCK_SYNC_MS: TIME round trips that track each board's clock, one per
+    // period (default 1000) after a burst on connect; 0 turns them and
+    // delay_ms/at_ms commands off.
+    const char* clockSyncEnv = std::getenv("CLOCK_SYNC_MS");
+    int clockSyncMs = std::max(0, clockSyncEnv ? std::atoi(clockSyncEnv) : 1000);
 
-        if (id < 1 || id > 9) {
-            status = 400;
-            return "{\"error\":\"invalid id; expected 1..9\"}";
+    // MOTOR_MAP=<file> spreads global motor ids over several boards (see
+    // ControllerPool.hpp); otherwise SERIAL_PORT drives motors 1..9.
+    std::vector<PortConfig> ports;
+    const char* mapEnv = std::getenv("MOTOR_MAP");
+    if (mapEnv && *mapEnv) {
+        std::string err;
+        if (!ControllerPool::loadConfig(mapEnv, portDefaults, ports, err)) {
+            LOG_ERROR("main", "MOTOR_MAP: %s", err.c_str());
+            return 1;
+        }
+    } else {
+        const char* serialEnv = std::getenv("SERIAL_PORT");
+        std::string serial = serialEnv ? std::string(serialEnv) : std::string();
+        if (serial.empty()) {
+            LOG_ERROR("main", "Set SERIAL_PORT to your Arduino device (e.g., /dev/serial/by-id/...) or MOTOR_MAP to a port map");
+            return 1;
         }
+        PortConfig pc = portDefaults;
+        pc.device = serial;
+        ports.push_back(pc);
+    }
 
-        int speed = 0;
-        std::string dirStr = "CW";   // default direction if none specified
+    const char* recEnv = std::getenv("RECONCILE_MS");
+    int reconcileMs = recEnv ? std::atoi(recEnv) : 5000;
 
-        // --- Simple query string parser: speed=..&dir=.. ---
-        std::istringstream qss(qs);
-        std::string pair;
-        while (std::getline(qss, pair, '&')) {
-            if (pair.empty()) continue;
-            auto eqPos = pair.find('=');
-            if (eqPos == std::string::npos) continue;
+    // RAMP_HZ: set-point rate of the ramp engine
+    const char* rampEnv = std::getenv("RAMP_HZ");
+    int rampHz = rampEnv ? std::atoi(rampEnv) : 100;
 
-            std::string k = pair.substr(0, eqPos);
-            std::string v = pair.substr(eqPos + 1);
+    // HTTP_SERIAL_LIMIT: motor commands served at once (8x as many may queue);
+    // HTTP_DEADLINE_MS: queued API requests older than this get 503 unsent.
+    const char* limitEnv = std::getenv("HTTP_SERIAL_LIMIT");
+    int serialLimit = std::max(1, limitEnv ? std::atoi(limitEnv) : 8);
+    const char* deadlineEnv = std::getenv("HTTP_DEADLINE_MS");
+    int deadlineMs = std::max(1, deadlineEnv ? std::atoi(deadlineEnv) : 2000);
 
-            std::cerr << "DEBUG kv: '" << k << "'='" << v << "'" << std::endl;
+    // JOURNAL=<file>: ring file of every serial command and reply, read back
+    // with journal_replay (default one_motor.journal, JOURNAL=off disables);
+    // JOURNAL_MB sizes it (default 8, ~260k records). A previous file is kept as <file>.1.
+    const char* journalEnv = std::getenv("JOURNAL");
+    std::string journalPath = journalEnv ? std::string(journalEnv) : std::string("one_motor.journal");
+    const char* journalMbEnv = std::getenv("JOURNAL_MB");
+    size_t journalMb = (size_t)std::max(1, journalMbEnv ? std::atoi(journalMbEnv) : 8);
+    Journal journal;
+    if (!journalPath.empty() && journalPath != "off")
+        journal.create(journalPath, (journalMb << 20) / sizeof(JournalRecord));
 
-            if (k == "speed") {
-                speed = std::max(0, std::min(100, std::atoi(v.c_str())));
-            } else if (k == "dir") {
-                dirStr = v;
-            }
-        }
+    // HISTORY_RAW / HISTORY_1S / HISTORY_1M: per-motor ring sizes of the
+    // telemetry history (raw samples, 1 s and 1 min buckets); HISTORY_TICK_MS
+    // samples every motor this often on top of every change.
+    TelemetryHistory::Config historyCfg;
+    auto envSize = [](const char *name, size_t def) {
+        const char *v = std::getenv(name);
+        return v ? (size_t)std::max(0, std::atoi(v)) : def;
+    };
+    historyCfg.raw = envSize("HISTORY_RAW", historyCfg.raw);
+    historyCfg.sec = envSize("HISTORY_1S", historyCfg.sec);
+    historyCfg.min = envSize("HISTORY_1M", historyCfg.min);
+    historyCfg.tickMs = (int)envSize("HISTORY_TICK_MS", (size_t)historyCfg.tickMs);
+    TelemetryHistory history(historyCfg);
 
-        // normalize dir string
-        auto trim = [](std::string &s) {
-            auto is_space = [](unsigned char c){ return std::isspace(c); };
-            while (!s.empty() && is_space(s.front())) s.erase(s.begin());
-            while (!s.empty() && is_space(s.back())) s.pop_back();
-        };
+    HttpServer http;
+    // Push channel: GET /api/events streams "state" events (same JSON as /api/status).
+    StatePublisher publisher(http.events());
+    ControllerPool pool(ports);
+    pool.setOnChange([&publisher, &history]{ publisher.notify(); history.notify(); });
+    if (journal.isOpen()) pool.setJournal(&journal);
+    pool.setClockSync(clockSyncMs);
+    http.setEventStream("/api/events", [&publisher]{ return publisher.snapshot(); });
 
-        trim(dirStr);
-        for (char &c : dirStr) {
-            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
-        }
+    // Link up/down as "link" events: {"port":0,"device":..,"up":true,"outage_ms":..}
+    pool.setOnLink([&http, &pool](size_t port, bool up, int64_t outageMs) {
+        if (!http.events().subscribers()) return;
+        http.events().publish("link", "{\"port\":" + std::to_string(port)
+            + ",\"device\":\"" + pool.portConfig(port).device + "\""
+            + ",\"up\":" + (up ? "true" : "false")
+            + ",\"outage_ms\":" + std::to_string(outageMs) + "}");
+    });
+
+    // Ports that are not up yet come up through the supervisor once their
+    // device appears; until then they show as down in /api/ports.
+    if (pool.connect() == 0) LOG_WARN("main", "no serial port up yet; waiting for devices");
+    if (probeCount > 0) pool.probe(probeCount);
+    pool.startReconciler(reconcileMs);
+    pool.supervise(linkPolicy);
+    publisher.start(pool);
+    history.start(pool);
+
+    // Ramps: progress goes out as "ramp" events on /api/events.
+    MotionEngine motion(pool, rampHz);
+    motion.setListener([&http](const MotionEngine::Progress &p){
+        if (http.events().subscribers()) http.events().publish("ramp", MotionEngine::toJson(p));
+    });
+    motion.start();
 
-        Direction d = Direction::CW;
-        if (dirStr.rfind("CCW", 0) == 0) {
-            d = Direction::CCW;
+    // API routes, registered per method. GET and POST both work for the single
+    // motor commands because the UI drives them with plain fetch() calls.
+    // Routes that wait on the serial link run in a work-queue lane; the rest
+    // (reads from memory, ramps, metrics) run inline on the I/O workers.
+    enum Lane { kLaneSerial, kLaneBatch };
+    Router api;
+
+    // 1) /api/status  (served from the shadow table; ?probe=1 asks the firmware directly)
+    api.add("GET", "/api/status", [&pool](const Router::Request &req, int &, std::string &) -> std::string {
+        if (req.query("probe") == "1") {
+            auto s = pool.status();
+            return std::string("{\"status\":\"") + (s ? *s : "NO-REPLY") + "\"}";
         }
+        return StatePublisher::statusJson(pool, pool.readAll(), MotorStateTable::nowMs());
+    });
+    api.add("GET", "/api/stats", [&pool](const Router::Request &, int &, std::string &) -> std::string {
+        auto st = pool.coalescerStats();
+        return "{\"commands\":" + std::to_string(st.submitted)
+             + ",\"coalesced\":" + std::to_string(st.coalesced)
+             + ",\"sent\":" + std::to_string(st.sent) + "}";
+    });
+
+    // Per-port health: link freshness, protocol, queue depth, command counts
+    api.add("GET", "/api/ports", [&pool](const Router::Request &, int &, std::string &) -> std::string {
+        return pool.healthJson(MotorStateTable::nowMs());
+    });
 
-        std::cerr << "DEBUG parsed: speed=" << speed
-                  << " dirStr='" << dirStr << "' -> "
-                  << (d == Direction::CCW ? "CCW" : "CW")
-                  << std::endl;
+    // POST /api/ports/probe[?n=..]: measure every link again (n STATUS
+    // commands, default SERIAL_PROBE or 200, at most 5000); returns /api/ports
+    api.add("POST", "/api/ports/probe", [&pool, probeCount](const Router::Request &req, int &, std::string &) -> std::string {
+        long n = req.queryInt("n", probeCount > 0 ? probeCount : 200);
+        pool.probe((int)std::max(1L, std::min(n, 5000L)));
+        return pool.healthJson(MotorStateTable::nowMs());
+    }, kLaneSerial);
 
+    // Prometheus scrape target (see Metrics.hpp)
+    api.add("GET", "/api/metrics", [](const Router::Request &, int &, std::string &ctype) -> std::string {
+        ctype = "text/plain; version=0.0.4";
+        return metrics::Registry::global().render();
+    });
 
-        bool ok = false;
-        if (cmd == "start") {
-            ok = mc.start(id, speed, d);
-        } else if (cmd == "stop") {
-            ok = mc.stop(id);
-        } else if (cmd == "set") {
-            ok = mc.set(id, speed, d);
+    // Telemetry history: GET /api/history?motor=N[&from=..][&to=..][&res=raw|1s|1m|auto][&max=..]
+    // from/to are epoch ms (a negative from is relative to now, default the
+    // last hour); without ?motor it reports the ring sizes.
+    api.add("GET", "/api/history", [&history](const Router::Request &req, int &status, std::string &) -> std::string {
+        if (req.query("motor").empty()) return history.configJson();
+        int64_t now = history.nowEpochMs();
+        int64_t from = (int64_t)queryNum(req, "from", -3600000.0);
+        if (from < 0) from += now;
+        int64_t to = (int64_t)queryNum(req, "to", (double)now);
+        long maxPoints = req.queryInt("max", 2000);
+        TelemetryHistory::Res res = TelemetryHistory::Res::Auto;
+        std::string_view resArg = req.query("res");
+        if ((!resArg.empty() && !TelemetryHistory::parseRes(std::string(resArg), res)) || from > to || maxPoints < 1) {
+            status = 400;
+            return "{\"error\":\"res must be raw, 1s, 1m or auto; from <= to; max >= 1\"}";
         }
+        std::string out;
+        if (!history.query((int)req.queryInt("motor", 0), from, to, res, (size_t)std::min(maxPoints, 20000L), out)) {
+            status = 404;
+            return "{\"error\":\"unknown motor id\"}";
+        }
+        return out;
+    });
 
+    // Log level: GET reports it, POST /api/log?level=debug changes it
+    auto logState = [] {
+        return std::string("{\"level\":\"") + logging::levelName(logging::level())
+             + "\",\"dropped\":" + std::to_string(logging::dropped()) + "}";
+    };
+    api.add("GET", "/api/log", [logState](const Router::Request &, int &, std::string &) { return logState(); });
+    api.add("POST", "/api/log", [logState](const Router::Request &req, int &status, std::string &) -> std::string {
+        logging::Level l;
+        if (!logging::parseLevel(std::string(req.query("level")), l)) {
+            status = 400;
+            return "{\"error\":\"level must be one of trace, debug, info, warn, error, off\"}";
+        }
+        logging::setLevel(l);
+        LOG_INFO("main", "log level set to %s", logging::levelName(l));
+        return logState();
+    });
+
+    // Scheduled commands need every board involved up with a synced clock;
+    // 503 with the reason otherwise.
+    auto unschedulable = [&pool](const std::vector<MotorCommand> &cmds, int &status) -> std::string {
+        for (const auto &c : cmds) {
+            if (!pool.linkUp(c.id)) { status = 503; return "{\"ok\":false,\"error\":\"serial link down\"}"; }
+            if (!pool.clockSynced(c.id)) { status = 503; return "{\"ok\":false,\"error\":\"board clock not synced\"}"; }
+        }
+        return std::string();
+    };
+    const char *badAt = "{\"error\":\"delay_ms and at_ms must be within the next 30 s\"}";
+
+    // 2) POST /api/motors[?delay_ms=..|?at_ms=..]  (batch, applied atomically by the
+    //    firmware; with a time, held by each board and run together at that time)
+    api.add("POST", "/api/motors", [&pool, &motion, unschedulable, badAt](const Router::Request &req, int &status, std::string &) -> std::string {
+        std::vector<MotorCommand> cmds;
+        std::string err;
+        if (!parseBatch(std::string(req.body), pool, cmds, err) || !pool.fitsBatch(cmds)) {
+            status = 400;
+            return "{\"error\":\"" + (err.empty() ? std::string("more than 16 commands for one board") : err) + "\"}";
+        }
+        int64_t atUs, atMs = 0;
+        if (!queryAt(req, atUs, atMs)) { status = 400; return badAt; }
+        if (atUs) {
+            std::string why = unschedulable(cmds, status);
+            if (!why.empty()) return why;
+        }
+        for (const auto &c : cmds) motion.cancelMotor(c.id);
+        bool ok = atUs ? pool.batchAt(cmds, atUs) : pool.batch(cmds);
         status = ok ? 200 : 500;
-        return std::string("{\"ok\":") + (ok ? "true" : "false") + "}";
+        if (!ok && std::any_of(cmds.begin(), cmds.end(), [&pool](const MotorCommand &c) { return !pool.linkUp(c.id); }))
+            status = 503;   // serial link down
+        return std::string("{\"ok\":") + (ok ? "true" : "false") + ",\"count\":" + std::to_string(cmds.size())
+             + (atUs ? ",\"at_ms\":" + std::to_string(atMs) : std::string()) + "}";
+    }, kLaneBatch);
+
+    // 3) /api/motor/{id}/{start|stop|set}?speed=..&dir=..[&delay_ms=..|&at_ms=..]
+    auto motorRoute = [&pool, &motion, unschedulable, badAt](MotorAction action) {
+        return [&pool, &motion, unschedulable, badAt, action](const Router::Request &req, int &status, std::string &) -> std::string {
+            long id = req.num(0);
+            if (!pool.has((int)id)) {
+                status = 400;
+                return "{\"error\":\"unknown motor id\"}";
+            }
+            int speed = (int)std::max(0L, std::min(100L, req.queryInt("speed", 0)));
+            Direction d = parseDir(req.query("dir"));
+            int64_t atUs, atMs = 0;
+            if (!queryAt(req, atUs, atMs)) { status = 400; return badAt; }
+            if (atUs) {
+                std::vector<MotorCommand> cmd{{(int)id, action, speed, d}};
+                std::string why = unschedulable(cmd, status);
+                if (!why.empty()) return why;
+                motion.cancelMotor((int)id);
+                bool ok = pool.batchAt(cmd, atUs);
+                status = ok ? 200 : 500;
+                return std::string("{\"ok\":") + (ok ? "true" : "false") + ",\"at_ms\":" + std::to_string(atMs) + "}";
+            }
+            motion.cancelMotor((int)id);   // a manual command takes over from a ramp
+
+            bool ok = false;
+            switch (action) {
+                case MotorAction::Start: ok = pool.start((int)id, speed, d); break;
+                case MotorAction::Stop:  ok = pool.stop((int)id); break;
+                case MotorAction::Set:   ok = pool.set((int)id, speed, d); break;
+            }
+            if (!ok && !pool.linkUp((int)id)) {
+                status = 503;
+                return "{\"ok\":false,\"error\":\"serial link down\"}";
+            }
+            status = ok ? 200 : 500;
+            return std::string("{\"ok\":") + (ok ? "true" : "false") + "}";
+        };
+    };
+    for (const char *method : {"GET", "POST"}) {
+        api.add(method, "/api/motor/{id:int}/start", motorRoute(MotorAction::Start), kLaneSerial);
+        api.add(method, "/api/motor/{id:int}/stop",  motorRoute(MotorAction::Stop), kLaneSerial);
+        api.add(method, "/api/motor/{id:int}/set",   motorRoute(MotorAction::Set), kLaneSerial);
     }
 
-    status = 404;
-    return "{\"error\":\"not found\"}";
-};
+    // 4) Ramps: POST /api/motor/{id}/ramp?speed=..&dir=..&accel=..[&jerk=..|&shape=scurve][&duration_ms=..][&stop=1]
+    //    returns the profile; GET /api/ramp/{n} for progress, DELETE (or POST .../cancel) to stop it
+    //    where it is. accel in %/s, jerk in %/s^2.
+    api.add("POST", "/api/motor/{id:int}/ramp", [&motion](const Router::Request &req, int &status, std::string &) -> std::string {
+        MotionEngine::Spec spec;
+        spec.id = (int)req.num(0);
+        spec.speedPercent = (int)req.queryInt("speed", -1);
+        spec.dir = parseDir(req.query("dir"));
+        spec.accel = queryNum(req, "accel", spec.accel);
+        spec.jerk = queryNum(req, "jerk", 0);
+        spec.durationMs = (int)req.queryInt("duration_ms", 0);
+        spec.stopAtEnd = req.query("stop") == "1";
+        std::string_view shape = req.query("shape");
+        if (shape == "scurve" || (shape.empty() && spec.jerk > 0)) spec.shape = MotionEngine::Shape::SCurve;
+        else if (!shape.empty() && shape != "linear") { status = 400; return "{\"error\":\"shape must be linear or scurve\"}"; }
+
+        std::string err;
+        uint64_t n = motion.submit(spec, err);
+        MotionEngine::Progress p;
+        if (!n || !motion.progress(n, p)) { status = 400; return "{\"error\":\"" + err + "\"}"; }
+        return MotionEngine::toJson(p);
+    });
+    api.add("GET", "/api/ramps", [&motion](const Router::Request &, int &, std::string &) -> std::string {
+        std::string out = "[";
+        for (const auto &p : motion.list()) { if (out.size() > 1) out += ","; out += MotionEngine::toJson(p); }
+        return out + "]";
+    });
+    api.add("GET", "/api/ramp/{n:int}", [&motion](const Router::Request &req, int &status, std::string &) -> std::string {
+        MotionEngine::Progress p;
+        if (!motion.progress((uint64_t)req.num(0), p)) { status = 404; return "{\"error\":\"no such ramp\"}"; }
+        return MotionEngine::toJson(p);
+    });
+    auto cancelRamp = [&motion](const Router::Request &req, int &status, std::string &) -> std::string {
+        uint64_t n = (uint64_t)req.num(0);
+        bool ok = motion.cancel(n);
+        MotionEngine::Progress p;
+        if (!motion.progress(n, p)) { status = 404; return "{\"error\":\"no such ramp\"}"; }
+        if (!ok) status = 409;   // already finished
+        return MotionEngine::toJson(p);
+    };
+    api.add("DELETE", "/api/ramp/{n:int}", cancelRamp);
+    api.add("POST", "/api/ramp/{n:int}/cancel", cancelRamp);
+
+    http.setApiLanes({{"serial", serialLimit, (size_t)serialLimit * 8}, {"batch", 2, 16}},
+        [&api](const std::string &method, const std::string &target) {
+            // ?probe=1 asks the firmware; a plain status read comes from memory
+            if (target.rfind("/api/status", 0) == 0 && target.find("probe=1") != std::string::npos) return (int)kLaneSerial;
+            return api.lane(method, target);
+        }, serialLimit + 2, deadlineMs);
+
+    auto handler = [&api](const std::string& method, const std::string& path, const std::string& body,
+                          int& status, std::string& ctype) {
+        return api.handle(method, path, body, status, ctype);
+    };
 
 
     if (!http.start(static_cast<unsigned short>(port), staticDir, handler)) {
-        std::cerr << "Failed to start HTTP server\n";
+        LOG_ERROR("main", "Failed to start HTTP server");
         return 3;
     }
 
-    std::cerr << "HTTP serving " << staticDir << " on http://127.0.0.1:" << port << "\n";
+    LOG_INFO("main", "HTTP serving %s on http://127.0.0.1:%d", staticDir.c_str(), port);
 
     // block forever
     std::string dummy;
     std::getline(std::cin, dummy);
+    motion.stop();
+    publisher.stop();
+    history.stop();
     http.stop();
     return 0;
 }
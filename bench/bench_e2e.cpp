@@ -0,0 +1,336 @@
+// End-to-end load test: starts fake_arduino and one_motor (or uses --target),
+// then drives a mix of /api/status, /api/motor/{id}/set and static requests
+// from N connections at a constant total rate and prints a JSON report.
+//
+//   ./build/bench_e2e --rate 2000 --conns 16 --duration 10 --mix status=50,set=40,static=10
+//
+// Open loop: request i of a connection is due at start + i * conns / rate and
+// its latency is measured from that due time, not from when it was actually
+// sent, so a stalled server is charged for the requests it held up
+// (no coordinated omission). --close opens a connection per request.
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Kind { kStatus, kSet, kStatic, kKinds };
+const char *kKindNames[kKinds] = {"status", "set", "static"};
+
+struct Options {
+    double rate = 1000;             // requests/s, all connections together
+    int conns = 8;
+    double duration = 10, warmup = 1;
+    int mix[kKinds] = {50, 40, 10};
+    bool close = false;
+    std::string target;             // host:port of a running server; empty = spawn one
+    std::string binDir;             // where one_motor and fake_arduino live
+    std::string staticDir = "./public";
+    std::string staticPath = "/index.html";
+    std::string serialProtocol = "binary";
+    double fwLatencyMs = 1.0;
+    unsigned seed = 1;
+};
+
+struct Sample {
+    uint32_t us;
+    uint8_t kind;
+    bool ok;
+};
+
+void usage(const char *argv0){
+    std::fprintf(stderr,
+        "usage: %s [--rate R] [--conns N] [--duration S] [--warmup S] [--mix status=50,set=40,static=10]\n"
+        "          [--close] [--target host:port] [--bin-dir DIR] [--static-dir DIR] [--static-path /x]\n"
+        "          [--serial-protocol binary|ascii] [--fw-latency-ms F] [--seed N]\n", argv0);
+}
+
+bool parseMix(const std::string &s, int mix[kKinds]){
+    for (int k = 0; k < kKinds; ++k) mix[k] = 0;
+    size_t pos = 0;
+    while (pos < s.size()){
+        size_t comma = s.find(',', pos);
+        std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        pos = comma == std::string::npos ? s.size() : comma + 1;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        int k = 0;
+        while (k < kKinds && item.compare(0, eq, kKindNames[k]) != 0) ++k;
+        if (k == kKinds) return false;
+        mix[k] = std::atoi(item.c_str() + eq + 1);
+    }
+    return mix[kStatus] + mix[kSet] + mix[kStatic] > 0;
+}
+
+bool parseArgs(int argc, char **argv, Options &o){
+    for (int i = 1; i < argc; ++i){
+        std::string a = argv[i];
+        if (a == "--close") { o.close = true; continue; }
+        if (i + 1 >= argc) return false;
+        std::string v = argv[++i];
+        if (a == "--rate") o.rate = std::atof(v.c_str());
+        else if (a == "--conns") o.conns = std::max(1, std::atoi(v.c_str()));
+        else if (a == "--duration") o.duration = std::atof(v.c_str());
+        else if (a == "--warmup") o.warmup = std::atof(v.c_str());
+        else if (a == "--mix") { if (!parseMix(v, o.mix)) return false; }
+        else if (a == "--target") o.target = v;
+        else if (a == "--bin-dir") o.binDir = v;
+        else if (a == "--static-dir") o.staticDir = v;
+        else if (a == "--static-path") o.staticPath = v;
+        else if (a == "--serial-protocol") o.serialProtocol = v;
+        else if (a == "--fw-latency-ms") o.fwLatencyMs = std::atof(v.c_str());
+        else if (a == "--seed") o.seed = (unsigned)std::strtoul(v.c_str(), nullptr, 10);
+        else return false;
+    }
+    return o.rate > 0 && o.duration > 0;
+}
+
+int connectTo(const sockaddr_in &addr){
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const sockaddr *)&addr, sizeof(addr)) < 0) { ::close(fd); return -1; }
+    int one = 1; setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool sendAll(int fd, const std::string &s){
+    size_t off = 0;
+    while (off < s.size()){
+        ssize_t n = ::send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        off += (size_t)n;
+    }
+    return true;
+}
+
+// Reads one response (headers + Content-Length body). `buf` keeps any bytes
+// past it. Returns the status code, or -1 on a broken connection.
+int readResponse(int fd, std::string &buf, bool &serverCloses){
+    size_t hdrEnd;
+    char chunk[16384];
+    while ((hdrEnd = buf.find("\r\n\r\n")) == std::string::npos){
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return -1;
+        buf.append(chunk, (size_t)n);
+    }
+    int status = std::atoi(buf.c_str() + 9);
+    size_t len = 0;
+    std::string head = buf.substr(0, hdrEnd);
+    for (auto &c : head) c = (char)std::tolower((unsigned char)c);
+    size_t cl = head.find("\r\ncontent-length:");
+    if (cl != std::string::npos) len = std::strtoul(head.c_str() + cl + 17, nullptr, 10);
+    serverCloses = head.find("\r\nconnection: close") != std::string::npos;
+    size_t total = hdrEnd + 4 + len;
+    while (buf.size() < total){
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return -1;
+        buf.append(chunk, (size_t)n);
+    }
+    buf.erase(0, total);
+    return status;
+}
+
+std::string requestFor(Kind k, std::mt19937 &rng, const Options &o){
+    std::string path;
+    if (k == kStatus) path = "/api/status";
+    else if (k == kSet) path = "/api/motor/" + std::to_string(1 + rng() % 9) + "/set?speed=" + std::to_string(rng() % 101) + "&dir=CW";
+    else path = o.staticPath;
+    return "GET " + path + " HTTP/1.1\r\nHost: bench\r\nConnection: " + (o.close ? "close" : "keep-alive") + "\r\n\r\n";
+}
+
+void runConnection(int idx, const Options &o, const sockaddr_in &addr, Clock::time_point start,
+                   Clock::time_point end, std::vector<Sample> &out){
+    std::mt19937 rng(o.seed * 7919u + (unsigned)idx);
+    int weights = o.mix[kStatus] + o.mix[kSet] + o.mix[kStatic];
+    auto interval = std::chrono::duration<double>(o.conns / o.rate);
+    // Spread the connections' schedules over one interval.
+    auto offset = std::chrono::duration_cast<Clock::duration>(interval * ((double)idx / o.conns));
+    int fd = -1;
+    std::string buf;
+    for (uint64_t i = 0;; ++i){
+        auto due = start + offset + std::chrono::duration_cast<Clock::duration>(interval * (double)i);
+        if (due >= end) break;
+        std::this_thread::sleep_until(due);
+
+        int pick = (int)(rng() % (unsigned)weights);
+        Kind k = pick < o.mix[kStatus] ? kStatus : pick < o.mix[kStatus] + o.mix[kSet] ? kSet : kStatic;
+        bool ok = false;
+        for (int attempt = 0; attempt < 2 && !ok; ++attempt){
+            if (fd < 0) { fd = connectTo(addr); buf.clear(); }
+            if (fd < 0) break;
+            bool closes = false;
+            int status = sendAll(fd, requestFor(k, rng, o)) ? readResponse(fd, buf, closes) : -1;
+            if (status < 0 || closes || o.close) { ::close(fd); fd = -1; }
+            if (status >= 0) ok = status >= 200 && status < 400;
+            if (status >= 0) break;    // only retry a keep-alive connection the server dropped
+        }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due).count();
+        out.push_back(Sample{(uint32_t)std::min<int64_t>(us, UINT32_MAX), (uint8_t)k, ok});
+    }
+    if (fd >= 0) ::close(fd);
+}
+
+std::string percentiles(std::vector<uint32_t> &v){
+    if (v.empty()) return "{}";
+    std::sort(v.begin(), v.end());
+    auto at = [&](double q){ return v[std::min(v.size() - 1, (size_t)(q * (double)v.size()))] / 1000.0; };
+    double sum = 0;
+    for (auto x : v) sum += x;
+    char s[256];
+    std::snprintf(s, sizeof(s), "{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f,\"mean\":%.3f}",
+                  at(0.50), at(0.90), at(0.99), at(0.999), v.back() / 1000.0, sum / (double)v.size() / 1000.0);
+    return s;
+}
+
+struct Child { pid_t pid = -1; int stdinFd = -1; };
+
+// stdout/stderr of the child go to outFd/errFd (inherited if -1); its stdin
+// stays open on a pipe until we close it (one_motor exits on EOF).
+Child spawn(const std::vector<std::string> &args, const std::vector<std::string> &env, int outFd, int errFd = -1){
+    int in[2];
+    if (pipe(in) < 0) return {};
+    Child c;
+    c.pid = fork();
+    if (c.pid == 0){
+        dup2(in[0], 0);
+        if (outFd >= 0) dup2(outFd, 1);
+        if (errFd >= 0) dup2(errFd, 2);
+        ::close(in[1]);
+        for (const auto &e : env) putenv(const_cast<char *>(e.c_str()));
+        std::vector<char *> argv;
+        for (const auto &a : args) argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        std::perror(argv[0]);
+        _exit(127);
+    }
+    ::close(in[0]);
+    c.stdinFd = in[1];
+    return c;
+}
+
+// one_motor exits when its stdin closes; anything still running after 3 s is killed.
+void stopChild(Child &c){
+    if (c.pid <= 0) return;
+    if (c.stdinFd >= 0) ::close(c.stdinFd);
+    else kill(c.pid, SIGTERM);
+    for (int i = 0; i < 300; ++i){
+        if (waitpid(c.pid, nullptr, WNOHANG) == c.pid) return;
+        usleep(10000);
+    }
+    kill(c.pid, SIGKILL);
+    waitpid(c.pid, nullptr, 0);
+}
+
+bool waitForPort(const sockaddr_in &addr, int ms){
+    auto deadline = Clock::now() + std::chrono::milliseconds(ms);
+    while (Clock::now() < deadline){
+        int fd = connectTo(addr);
+        if (fd >= 0) { ::close(fd); return true; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char **argv){
+    Options o;
+    if (!parseArgs(argc, argv, o)) { usage(argv[0]); return 1; }
+    if (o.binDir.empty()){
+        std::string self = argv[0];
+        size_t slash = self.rfind('/');
+        o.binDir = slash == std::string::npos ? "." : self.substr(0, slash);
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    Child fake, server;
+    std::string link;
+    if (o.target.empty()){
+        int port = 20000 + (int)(getpid() % 20000);
+        link = "/tmp/bench_e2e_" + std::to_string(getpid());
+        char lat[32]; std::snprintf(lat, sizeof(lat), "%g", o.fwLatencyMs);
+        int devnull = ::open("/dev/null", O_WRONLY);
+        fake = spawn({o.binDir + "/fake_arduino", "--link", link, "--latency-ms", lat, "--boot-ms", "0"}, {}, devnull, devnull);
+        for (int i = 0; i < 100 && access(link.c_str(), F_OK) != 0; ++i) usleep(20000);
+        server = spawn({o.binDir + "/one_motor"},
+                       {"SERIAL_PORT=" + link, "PORT=" + std::to_string(port), "STATIC_DIR=" + o.staticDir,
+                        "SERIAL_PROTOCOL=" + o.serialProtocol, "LOG_LEVEL=warn"}, devnull);
+        ::close(devnull);
+        addr.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    } else {
+        size_t colon = o.target.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : o.target.substr(0, colon);
+        addr.sin_port = htons((uint16_t)std::atoi(o.target.c_str() + (colon == std::string::npos ? 0 : colon + 1)));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) { std::fprintf(stderr, "bad --target\n"); return 1; }
+    }
+
+    int rc = 0;
+    if (!waitForPort(addr, 15000)){
+        std::fprintf(stderr, "bench_e2e: server did not come up\n");
+        rc = 2;
+    } else {
+        auto start = Clock::now() + std::chrono::milliseconds(100);
+        auto measureFrom = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.warmup));
+        auto end = measureFrom + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.duration));
+        std::vector<std::vector<Sample>> samples(o.conns);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < o.conns; ++i){
+            samples[i].reserve((size_t)((o.warmup + o.duration) * o.rate / o.conns) + 16);
+            threads.emplace_back(runConnection, i, std::cref(o), std::cref(addr), start, end, std::ref(samples[i]));
+        }
+        for (auto &t : threads) t.join();
+
+        // Drop the warm-up: samples are in due-time order per connection.
+        double interval = o.conns / o.rate;
+        size_t skip = (size_t)(o.warmup / interval);
+        std::vector<uint32_t> all, byKind[kKinds];
+        uint64_t errors = 0;
+        for (auto &v : samples){
+            for (size_t i = std::min(skip, v.size()); i < v.size(); ++i){
+                if (!v[i].ok) { ++errors; continue; }
+                all.push_back(v[i].us);
+                byKind[v[i].kind].push_back(v[i].us);
+            }
+        }
+
+        // The firmware latency is only ours to report when we run fake_arduino
+        char fwLat[48] = "";
+        if (o.target.empty()) std::snprintf(fwLat, sizeof(fwLat), ",\"fw_latency_ms\":%g", o.fwLatencyMs);
+        std::printf("{\"config\":{\"rate\":%g,\"conns\":%d,\"duration_s\":%g,\"warmup_s\":%g,\"mix\":{\"status\":%d,\"set\":%d,\"static\":%d},"
+                    "\"connection\":\"%s\",\"serial_protocol\":\"%s\"%s},\n",
+                    o.rate, o.conns, o.duration, o.warmup, o.mix[kStatus], o.mix[kSet], o.mix[kStatic],
+                    o.close ? "close" : "keep-alive", o.target.empty() ? o.serialProtocol.c_str() : "external", fwLat);
+        std::printf(" \"requests\":%zu,\"errors\":%llu,\"throughput_rps\":%.1f,\n", all.size(),
+                    (unsigned long long)errors, (double)all.size() / o.duration);
+        std::printf(" \"latency_ms\":%s,\n \"by_kind\":{", percentiles(all).c_str());
+        for (int k = 0; k < kKinds; ++k)
+            std::printf("%s\"%s\":{\"requests\":%zu,\"latency_ms\":%s}", k ? "," : "", kKindNames[k],
+                        byKind[k].size(), percentiles(byKind[k]).c_str());
+        std::printf("}}\n");
+    }
+
+    stopChild(server);
+    if (fake.pid > 0) { ::close(fake.stdinFd); fake.stdinFd = -1; }
+    stopChild(fake);
+    return rc;
+}
@@ -0,0 +1,175 @@
+// Commands per second through the MotorControlNine protocol core built for
+// the host (MotorCore.cpp against firmware/host), for typical backend
+// traffic in both protocols. FirmwareModel, which parses with a std::string
+// per field much like the sketch's old String code did, is timed on the same
+// bytes for comparison. The second table is the I2C cost of typical updates
+// on the host bus model: one setPWM() per channel as the sketch used to do,
+// against PwmBank bursts per board and with both boards on one STOP. Build with
+//   cmake -S . -B build -DONE_MOTOR_BENCH=ON && cmake --build build --target firmware_bench
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Adafruit_PWMServoDriver.h"
+#include "FirmwareModel.hpp"
+#include "MotorCore.h"
+
+namespace {
+
+constexpr int kPerRound = 1000;
+
+std::string frame(const uint8_t *p, size_t n){
+    uint8_t out[WIRE_MAX_ENCODED];
+    return std::string((const char *)out, wireEncodeFrame(p, n, out));
+}
+
+// kPerRound commands, the n-th tagged/sequenced with n.
+std::string stream(const char *kind){
+    std::string s = std::string(kind).rfind("binary", 0) == 0 ? std::string("\0HELLO 1\n\0", 10) : std::string();
+    char line[128];
+    for (int n = 0; n < kPerRound; ++n){
+        int id = 1 + n % 9;
+        if (!std::strcmp(kind, "ascii set")) std::snprintf(line, sizeof(line), "@%d M%d:SET:%d:%s\n", n, id, n % 101, n & 1 ? "CW" : "CCW");
+        else if (!std::strcmp(kind, "ascii start")) std::snprintf(line, sizeof(line), "@%d M%d:START:%d:CW\n", n, id, n % 101);
+        else if (!std::strcmp(kind, "ascii batch9")) std::snprintf(line, sizeof(line), "@%d B:1S40C;2U55A;3X;4S10C;5S20A;6U30C;7X;8S90C;9U%dA\n", n, n % 101);
+        else if (!std::strcmp(kind, "ascii state")) std::snprintf(line, sizeof(line), "@%d STATE\n", n);
+        else if (!std::strcmp(kind, "binary set")){
+            uint8_t p[] = {(uint8_t)n, (uint8_t)(WOP_SET | (n & 1 ? 0 : WOP_CCW)), (uint8_t)id, (uint8_t)(n % 101)};
+            s += frame(p, sizeof(p));
+            continue;
+        } else {
+            uint8_t p[sizeof(WireCmd) + 9 * sizeof(WireItem)] = {(uint8_t)n, WOP_BATCH, 9, 0};
+            for (int i = 0; i < 9; ++i){
+                p[4 + i * 3] = (uint8_t)(i + 1);
+                p[5 + i * 3] = (uint8_t)(i % 3 == 2 ? WOP_STOP : WOP_START);
+                p[6 + i * 3] = (uint8_t)(n % 101);
+            }
+            s += frame(p, sizeof(p));
+            continue;
+        }
+        s += line;
+    }
+    return s;
+}
+
+// Every command must have been acked without an error.
+bool verify(const std::string &out, bool binary){
+    size_t replies = 0;
+    for (char c : out) replies += binary ? c == 0 : c == '\n';   // the HELLO reply has no 0x00
+    return replies == (size_t)kPerRound && out.find("ERR") == std::string::npos;
+}
+
+// A motor's new output, as driveMotorRaw() takes it.
+struct Drive {
+    uint8_t id;
+    uint16_t duty;
+    bool cw;
+};
+
+uint8_t boardOf(uint8_t id){ return id == 9 ? 1 : 0; }
+uint8_t in1Of(uint8_t id){ return (uint8_t)(((id - 1) % 8) * 2); }
+
+std::vector<Drive> allMotors(uint8_t pct, bool cw){
+    std::vector<Drive> v;
+    for (uint8_t id = 1; id <= 9; ++id) v.push_back({id, (uint16_t)(pct * 4095UL / 100UL), cw});
+    return v;
+}
+
+// The sketch before PwmBank: two setPWM() transactions per motor.
+void legacyDrive(Adafruit_PWMServoDriver *pwm, const std::vector<Drive> &v){
+    for (const auto &d : v){
+        Adafruit_PWMServoDriver &drv = pwm[boardOf(d.id)];
+        drv.setPWM(in1Of(d.id), 0, d.cw ? d.duty : 0);
+        drv.setPWM(in1Of(d.id) + 1, 0, d.cw ? 0 : d.duty);
+    }
+}
+
+void bankDrive(PwmBank &bank, const std::vector<Drive> &v){
+    for (const auto &d : v){
+        bank.set(boardOf(d.id), in1Of(d.id), d.cw ? d.duty : 0);
+        bank.set(boardOf(d.id), in1Of(d.id) + 1, d.cw ? 0 : d.duty);
+    }
+    bank.flush();
+}
+
+void i2cReport(){
+    struct Case {
+        const char *name;
+        std::vector<Drive> before, update;
+    };
+    std::vector<Case> cases = {
+        {"set 1 motor", allMotors(40, true), {{3, 55 * 4095 / 100, true}}},
+        {"set 9", allMotors(40, true), allMotors(60, true)},
+        {"reverse 9", allMotors(40, true), allMotors(60, false)},
+        {"stop 9", allMotors(40, true), allMotors(0, true)},
+    };
+    std::printf("\nI2C per update        transactions  bytes  bus us@400k  output changes\n");
+    for (const auto &c : cases){
+        for (int mode = 0; mode < 3; ++mode){
+            TwoWire bus;
+            Adafruit_PWMServoDriver pwm[2] = {Adafruit_PWMServoDriver(0x40, bus), Adafruit_PWMServoDriver(0x41, bus)};
+            PwmBank bank(bus, 0x40, 0x41, mode == 2 ? PwmBank::SYNC_BOARDS | PwmBank::ALL_CALL : 0);
+            for (auto &p : pwm) { p.begin(); p.setPWMFreq(1600); }
+            if (mode == 0) legacyDrive(pwm, c.before);
+            else { bank.begin(); bankDrive(bank, c.before); }
+            bus.resetStats();
+            if (mode == 0) legacyDrive(pwm, c.update);
+            else bankDrive(bank, c.update);
+            const TwoWire::Stats &st = bus.stats();
+            // 9 clocks per byte, plus START and STOP
+            double us = (double)(st.bytes * 9 + st.transactions + st.stops) / 0.4;
+            std::printf("%-12s %-9s %5lu %8lu %10.0f %12lu\n", mode == 0 ? c.name : "",
+                        mode == 0 ? "setPWM" : mode == 1 ? "bursts" : "sync", st.transactions, st.bytes, us, st.latches);
+        }
+    }
+}
+
+template <class F>
+double nsPerCommand(int rounds, F f){
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)rounds * kPerRound);
+}
+
+}
+
+int main(int argc, char **argv){
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+    std::printf("%-14s %12s %12s %16s %8s\n", "", "ns/cmd", "cmds/s", "FirmwareModel", "bytes");
+    for (const char *kind : {"ascii set", "ascii start", "ascii batch9", "ascii state", "binary set", "binary batch9"}){
+        const std::string in = stream(kind);
+        bool binary = std::string(kind).rfind("binary", 0) == 0;
+
+        TwoWire bus;
+        PwmBank bank(bus, 0x40, 0x41, PwmBank::SYNC_BOARDS | PwmBank::ALL_CALL);
+        bank.begin();
+        HostSerial serial;
+        MotorCore core(bank, serial);
+        serial.inject(in.data(), in.size());
+        core.poll(serial);
+        FirmwareModel model;
+        model.reset();
+        std::string expected;
+        model.feed((const uint8_t *)in.data(), in.size(), expected);
+        if (!verify(serial.output(), binary) || serial.output() != expected){
+            std::fprintf(stderr, "%s: replies wrong or differ from FirmwareModel\n", kind);
+            return 1;
+        }
+
+        double core_ns = nsPerCommand(rounds, [&]{
+            serial.output().clear();
+            serial.inject(in.data(), in.size());
+            core.poll(serial);
+        });
+        double model_ns = nsPerCommand(rounds / 4 + 1, [&]{
+            expected.clear();
+            model.feed((const uint8_t *)in.data(), in.size(), expected);
+        });
+        std::printf("%-14s %12.1f %12.0f %13.1f ns %8zu\n", kind, core_ns, 1e9 / core_ns, model_ns, in.size() / kPerRound);
+    }
+    i2cReport();
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Per-request parsing cost: the old istringstream parser in HttpServer against
+// HttpParser, for a browser-style GET, a small JSON POST, the same GET arriving
+// in 16-byte reads, and a chunked POST (HttpParser only). Build with
+//   cmake -S . -B build -DONE_MOTOR_BENCH=ON && cmake --build build --target http_parser_bench
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "HttpParser.hpp"
+
+namespace {
+
+volatile size_t sink;
+
+struct LegacyRequest {
+    std::string method, target, body;
+    std::string ifNoneMatch;
+    bool acceptGzip = false;
+    bool keepAlive = true;
+};
+
+bool iequals(const std::string &a, const char *b){
+    size_t n = std::strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i=0;i<n;++i) if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    return true;
+}
+
+// processRequests before HttpParser: one request from the start of `in`, or
+// 0 if it is not complete yet.
+size_t legacyParse(const std::string &in, LegacyRequest &req){
+    size_t hdrEnd = in.find("\r\n\r\n");
+    if (hdrEnd == std::string::npos) return 0;
+    std::istringstream hs(in.substr(0, hdrEnd));
+    std::string line;
+    std::getline(hs, line);
+    std::istringstream rl(line);
+    std::string version; rl >> req.method >> req.target >> version;
+    req.keepAlive = version != "HTTP/1.0";
+    size_t contentLength = 0;
+    while (std::getline(hs, line)){
+        if (!line.empty() && line.back()=='\r') line.pop_back();
+        auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        size_t vs = line.find_first_not_of(" \t", colon+1);
+        std::string value = vs==std::string::npos ? std::string() : line.substr(vs);
+        if (iequals(name, "Content-Length")) contentLength = (size_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (iequals(name, "Connection")){
+            if (iequals(value, "close")) req.keepAlive = false;
+            else if (iequals(value, "keep-alive")) req.keepAlive = true;
+        }
+        else if (iequals(name, "If-None-Match")) req.ifNoneMatch = value;
+        else if (iequals(name, "Accept-Encoding")) req.acceptGzip = value.find("gzip") != std::string::npos;
+    }
+    size_t bodyStart = hdrEnd + 4;
+    if (in.size() - bodyStart < contentLength) return 0;
+    req.body = in.substr(bodyStart, contentLength);
+    return bodyStart + contentLength;
+}
+
+template <class F>
+double nsPerCall(int iters, F f){
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) f(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+const char kGet[] =
+    "GET /app.js HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: */*\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://127.0.0.1:8080/\r\n"
+    "If-None-Match: \"1a2b3c-4d5e\"\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n\r\n";
+
+const char kPost[] =
+    "POST /api/motors HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 57\r\n\r\n"
+    "[{\"id\":1,\"speed\":40,\"dir\":\"CW\"},{\"id\":2,\"action\":\"stop\"}]";
+
+const char kChunked[] =
+    "POST /api/motors HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "Content-Type: application/json\r\n"
+    "Transfer-Encoding: chunked\r\n\r\n"
+    "20\r\n[{\"id\":1,\"speed\":40,\"dir\":\"CW\"},\r\n"
+    "19\r\n{\"id\":2,\"action\":\"stop\"}]\r\n"
+    "0\r\n\r\n";
+
+void report(const char *name, double legacy, double parsed){
+    if (legacy > 0) std::printf("%-12s istringstream %8.1f ns  HttpParser %8.1f ns  (%.0fx)\n", name, legacy, parsed, legacy / parsed);
+    else std::printf("%-12s istringstream      n/a     HttpParser %8.1f ns\n", name, parsed);
+}
+
+}
+
+int main(int argc, char **argv){
+    int iters = argc > 1 ? std::atoi(argv[1]) : 200000;
+    HttpParser parser;
+    HttpParser::Request req;
+    for (const char *raw : {kGet, kPost, kChunked}){
+        std::string in = raw;
+        if (parser.parse(&in[0], in.size(), req) != HttpParser::Status::Complete || parser.consumed() != in.size()){
+            std::fprintf(stderr, "sample request does not parse: %d\n", parser.errorStatus());
+            return 1;
+        }
+    }
+
+    for (const char *raw : {kGet, kPost}){
+        std::string in = raw;
+        double legacy = nsPerCall(iters / 10, [&](int){ LegacyRequest r; sink = legacyParse(in, r); });
+        double parsed = nsPerCall(iters, [&](int){
+            parser.parse(&in[0], in.size(), req);
+            sink = parser.consumed() + req.nheaders;
+        });
+        report(raw == kGet ? "GET" : "POST", legacy, parsed);
+    }
+
+    {
+        // Every read re-runs the parser over what has arrived so far.
+        const std::string full = kGet;
+        std::string in;
+        in.reserve(full.size());
+        double legacy = nsPerCall(iters / 100, [&](int){
+            in.clear();
+            LegacyRequest r;
+            for (size_t n = 0; n < full.size(); ){
+                size_t step = std::min<size_t>(16, full.size() - n);
+                in.append(full, n, step); n += step;
+                sink = legacyParse(in, r);
+            }
+        });
+        double parsed = nsPerCall(iters / 10, [&](int){
+            in.clear();
+            for (size_t n = 0; n < full.size(); ){
+                size_t step = std::min<size_t>(16, full.size() - n);
+                in.append(full, n, step); n += step;
+                if (parser.parse(&in[0], in.size(), req) == HttpParser::Status::Complete) sink = parser.consumed();
+            }
+        });
+        report("GET/16B", legacy, parsed);
+    }
+
+    {
+        // Chunked bodies are decoded in place, so each round parses a fresh copy.
+        const std::string raw = kChunked;
+        std::string in = raw;
+        double parsed = nsPerCall(iters, [&](int){
+            std::memcpy(&in[0], raw.data(), raw.size());
+            parser.parse(&in[0], in.size(), req);
+            sink = req.body.size();
+        });
+        report("chunked", 0, parsed);
+    }
+    return 0;
+}
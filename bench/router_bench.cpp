@@ -0,0 +1,75 @@
+// Per-request routing cost: the old handler (std::regex built per request,
+// istringstream query parsing) against Router. Build with
+//   cmake -S . -B build -DONE_MOTOR_BENCH=ON && cmake --build build --target router_bench
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Router.hpp"
+
+namespace {
+
+volatile long sink;
+
+// Routing part of the handler before the Router (no serial I/O, no logging).
+long legacyRoute(const std::string &path){
+    std::smatch m;
+    std::regex rSet(R"(^/api/motor/(\d+)/(start|stop|set)(?:\?([^#]*))?$)");
+    if (!std::regex_match(path, m, rSet)) return -1;
+    int id = std::stoi(m[1]);
+    std::string cmd = m[2];
+    std::string qs = (m.size() > 3 && m[3].matched) ? m[3].str() : "";
+    int speed = 0;
+    std::string dirStr = "CW";
+    std::istringstream qss(qs);
+    std::string pair;
+    while (std::getline(qss, pair, '&')) {
+        auto eqPos = pair.find('=');
+        if (eqPos == std::string::npos) continue;
+        std::string k = pair.substr(0, eqPos);
+        std::string v = pair.substr(eqPos + 1);
+        if (k == "speed") speed = std::max(0, std::min(100, std::atoi(v.c_str())));
+        else if (k == "dir") dirStr = v;
+    }
+    return id * 1000 + speed + (dirStr.rfind("CCW", 0) == 0) + (long)cmd.size();
+}
+
+template <class F>
+double nsPerCall(int iters, F f){
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) f(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+}
+
+int main(int argc, char **argv){
+    int iters = argc > 1 ? std::atoi(argv[1]) : 200000;
+    std::vector<std::string> paths;
+    for (int id = 1; id <= 9; ++id){
+        paths.push_back("/api/motor/" + std::to_string(id) + "/set?speed=" + std::to_string(id * 10) + "&dir=CCW");
+        paths.push_back("/api/motor/" + std::to_string(id) + "/stop");
+    }
+
+    Router r;
+    for (const char *action : {"start", "stop", "set"})
+        r.add("GET", std::string("/api/motor/{id:int}/") + action, [](const Router::Request &req, int &, std::string &){
+            sink = req.num(0) * 1000 + req.queryInt("speed", 0) + (req.query("dir") == "CCW");
+            return std::string();
+        });
+
+    const std::string method = "GET", body;
+    double legacy = nsPerCall(iters / 20, [&](int i){ sink = legacyRoute(paths[i % paths.size()]); });
+    double routed = nsPerCall(iters, [&](int i){
+        int status; std::string ct;
+        r.handle(method, paths[i % paths.size()], body, status, ct);
+    });
+    std::printf("regex handler: %8.1f ns/request\n", legacy);
+    std::printf("Router:        %8.1f ns/request  (%.0fx)\n", routed, legacy / routed);
+    return 0;
+}
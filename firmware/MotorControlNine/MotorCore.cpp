@@ -0,0 +1,656 @@
+#include "MotorCore.h"
+#include <stdlib.h>
+
+// Map 9 motors to (board, IN1 channel, IN2 channel)
+// Motor IDs are 1..9
+struct PwmMap {
+  uint8_t board;   // 0 or 1
+  uint8_t ch_in1;  // PCA channel for IN1
+  uint8_t ch_in2;  // PCA channel for IN2
+};
+
+static const PwmMap pwmMap[10] = {
+  {0, 0,  0},   // index 0 unused
+
+  {0, 0,  1},   // M1 -> board0 ch0,1
+  {0, 2,  3},   // M2 -> board0 ch2,3
+  {0, 4,  5},   // M3 -> board0 ch4,5
+  {0, 6,  7},   // M4 -> board0 ch6,7
+  {0, 8,  9},   // M5 -> board0 ch8,9
+  {0, 10, 11},  // M6 -> board0 ch10,11
+  {0, 12, 13},  // M7 -> board0 ch12,13
+  {0, 14, 15},  // M8 -> board0 ch14,15
+
+  {1, 0,  1},   // M9 -> board1 ch0,1
+};
+
+// Rates a 16 MHz AVR UART hits within 2.1% (U2X): 115200, then the exact
+// divisors of 2 MHz. Ascending.
+static const uint32_t baudRates[] = {115200, 250000, 500000, 1000000, 2000000};
+static const uint8_t BAUD_RATES = sizeof(baudRates) / sizeof(baudRates[0]);
+
+// Convert 0..100% to PCA9685 12-bit (0..4095)
+static uint16_t pctToPwm(uint8_t pct) {
+  if (pct == 0) return 0;
+  if (pct > 100) pct = 100;
+  return (uint16_t)((pct * 4095UL) / 100UL);
+}
+
+// Same set as String::trim(): isspace() without the locale.
+static bool isSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Decimal digits of v at w; returns the end. snprintf() is far slower on the AVR.
+static char *putUint(char *w, uint8_t v) {
+  if (v >= 100) *w++ = '0' + v / 100;
+  if (v >= 10) *w++ = '0' + v / 10 % 10;
+  *w++ = '0' + v % 10;
+  return w;
+}
+
+static char *putUlong(char *w, uint32_t v) {
+  char tmp[10];
+  uint8_t n = 0;
+  do {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) *w++ = tmp[--n];
+  return w;
+}
+
+static char *putLong(char *w, int32_t v) {
+  if (v < 0) {
+    *w++ = '-';
+    return putUlong(w, 0UL - (uint32_t)v);
+  }
+  return putUlong(w, (uint32_t)v);
+}
+
+// Decimal digits at p into v, advancing p; false if there are none or the
+// value does not fit 32 bits.
+static bool parseUlong(const char *&p, uint32_t &v) {
+  if (*p < '0' || *p > '9') return false;
+  v = 0;
+  while (*p >= '0' && *p <= '9') {
+    uint8_t d = *p++ - '0';
+    if (v > (0xFFFFFFFFUL - d) / 10) return false;
+    v = v * 10 + d;
+  }
+  return true;
+}
+
+static char *trim(char *s) {
+  while (isSpace(*s)) s++;
+  char *e = s + strlen(s);
+  while (e > s && isSpace(e[-1])) e--;
+  *e = 0;
+  return s;
+}
+
+MotorCore::MotorCore(PwmBank &pwm, Print &out)
+  : pwm_(pwm), out_(out), binaryMode_(false), baudFn_(0), baud_(BAUD_DEFAULT), baudOk_(BAUD_DEFAULT),
+    baudPending_(false), baudSince_(0), schedLen_(0), tag_(0), timed_(false), at_(0), rxLen_(0),
+    rxOverflow_(false) {
+  memset(speedPct_, 0, sizeof(speedPct_));
+  memset(dir_, 0, sizeof(dir_));
+  memset(enabled_, 0, sizeof(enabled_));
+}
+
+// Low-level: set both channels for a motor (written out by the next flush)
+void MotorCore::driveMotorRaw(uint8_t id, uint16_t duty, bool cw) {
+  if (id < 1 || id > MOTORS) return;
+
+  const PwmMap &m = pwmMap[id];
+
+  // Motor off: both low. CW: IN1 = PWM, IN2 = 0. CCW: IN1 = 0, IN2 = PWM.
+  pwm_.set(m.board, m.ch_in1, cw ? duty : 0);
+  pwm_.set(m.board, m.ch_in2, cw ? 0 : duty);
+}
+
+void MotorCore::startMotor(uint8_t id, uint8_t sp, bool cw) {
+  if (id < 1 || id > MOTORS) return;
+  speedPct_[id] = sp;
+  enabled_[id]  = true;
+  dir_[id]      = cw ? 'C' : 'A';
+  driveMotorRaw(id, pctToPwm(sp), cw);
+}
+
+void MotorCore::stopMotor(uint8_t id) {
+  if (id < 1 || id > MOTORS) return;
+  enabled_[id] = false;
+  driveMotorRaw(id, 0, true);  // direction doesn't matter when duty=0
+}
+
+void MotorCore::setMotor(uint8_t id, uint8_t sp, bool cw) {
+  if (id < 1 || id > MOTORS) return;
+  speedPct_[id] = sp;
+  dir_[id]      = cw ? 'C' : 'A';
+  if (enabled_[id]) {
+    driveMotorRaw(id, pctToPwm(sp), cw);
+  }
+}
+
+void MotorCore::applyBatch(const BatchItem *items, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    const BatchItem &it = items[i];
+    if (it.op == 'S')      startMotor(it.id, it.sp, it.cw);
+    else if (it.op == 'U') setMotor(it.id, it.sp, it.cw);
+    else                   stopMotor(it.id);
+  }
+}
+
+// Immediate commands: whatever is held for these motors goes first.
+void MotorCore::applyNow(const BatchItem *items, uint8_t n) {
+  unschedule(items, n);
+  applyBatch(items, n);
+}
+
+// Holds items until micros() reaches `at`, after those already held for the
+// same time; false if they do not all fit. `lead` gets the microseconds to
+// go. Already due: runs now, so the ack still means the outputs have it.
+bool MotorCore::schedule(const BatchItem *items, uint8_t n, uint32_t at, int32_t &lead) {
+  if (n > SCHED_MAX - schedLen_) return false;
+  uint32_t now = micros();
+  lead = (int32_t)(at - now);
+  uint8_t pos = schedLen_;
+  while (pos > 0 && (int32_t)(sched_[pos - 1].at - now) > lead) pos--;
+  memmove(sched_ + pos + n, sched_ + pos, (schedLen_ - pos) * sizeof(Timed));
+  for (uint8_t i = 0; i < n; i++) {
+    sched_[pos + i].at   = at;
+    sched_[pos + i].item = items[i];
+  }
+  schedLen_ += n;
+  if (lead <= 0) runDue();
+  return true;
+}
+
+void MotorCore::unschedule(const BatchItem *items, uint8_t n) {
+  uint8_t w = 0;
+  for (uint8_t r = 0; r < schedLen_; r++) {
+    bool hit = false;
+    for (uint8_t i = 0; i < n && !hit; i++) hit = sched_[r].item.id == items[i].id;
+    if (!hit) sched_[w++] = sched_[r];
+  }
+  schedLen_ = w;
+}
+
+// Everything due goes out in one pass: with SYNC_BOARDS the motors change
+// on the same STOP, whichever board they are on.
+void MotorCore::runDue() {
+  uint32_t now = micros();
+  uint8_t k = 0;
+  while (k < schedLen_ && (int32_t)(sched_[k].at - now) <= 0) k++;
+  if (k == 0) return;
+  BatchItem items[SCHED_MAX];
+  for (uint8_t i = 0; i < k; i++) items[i] = sched_[i].item;
+  schedLen_ -= k;
+  memmove(sched_, sched_ + k, schedLen_ * sizeof(Timed));
+  applyBatch(items, k);
+  pwm_.flush();
+}
+
+// Validated ASCII command: applied now with `ok` as the ack, or held under AT.
+void MotorCore::runLine(const BatchItem *items, uint8_t n, const char *ok) {
+  if (!timed_) {
+    applyNow(items, n);
+    reply(ok);
+    return;
+  }
+  int32_t lead;
+  if (!schedule(items, n, at_, lead)) {
+    reply("ERR FULL");
+    return;
+  }
+  char msg[20] = "OK AT ";
+  *putLong(msg + 6, lead) = 0;
+  reply(msg);
+}
+
+void MotorCore::setBaud(uint32_t baud) {
+  baud_ = baud;
+  if (baudFn_) baudFn_(baud);
+}
+
+// "BAUD?" or "BAUD <rate>"; false if the line is neither.
+bool MotorCore::handleBaud(const char *line) {
+  if (strncmp(line, "BAUD", 4) != 0) return false;
+  if (strcmp(line + 4, "?") == 0) {
+    char msg[8 + BAUD_RATES * 11] = "BAUDS ";
+    char *w = msg + 6;
+    for (uint8_t i = 0; i < BAUD_RATES; i++) {
+      if (i) *w++ = ',';
+      w = putUlong(w, baudRates[i]);
+    }
+    *w = 0;
+    reply(msg);
+    return true;
+  }
+  if (line[4] != ' ' || line[5] < '0' || line[5] > '9') return false;
+  char *end;
+  unsigned long rate = strtoul(line + 5, &end, 10);
+  if (*end) return false;
+
+  uint8_t i = 0;
+  while (i < BAUD_RATES && baudRates[i] != rate) i++;
+  if (i == BAUD_RATES) {
+    reply("ERR ARGS");
+    return true;
+  }
+  char msg[20] = "BAUD ";
+  memcpy(putUlong(msg + 5, rate), " OK", 4);
+  reply(msg);   // still at the old rate
+  if (!baudPending_) baudOk_ = baud_;
+  baudPending_ = true;
+  baudSince_   = millis();
+  setBaud(rate);
+  return true;
+}
+
+// Tag, message and CR LF in one write: on the Leonardo every print() can
+// cost a USB packet of its own.
+void MotorCore::reply(const char *msg) {
+  pwm_.flush();
+  char buf[RX_MAX + 72];
+  size_t n = 0;
+  if (tag_) {
+    size_t t = strlen(tag_);
+    memcpy(buf, tag_, t);
+    n = t;
+    buf[n++] = ' ';
+  }
+  size_t m = strlen(msg);
+  if (m > sizeof(buf) - n - 2) m = sizeof(buf) - n - 2;
+  memcpy(buf + n, msg, m);
+  n += m;
+  buf[n++] = '\r';
+  buf[n++] = '\n';
+  out_.write((const uint8_t *)buf, n);
+}
+
+// Batch frame body (after "B:"): items separated by ';'
+//   <id>S<pct><C|A>  START    e.g. 1S40C
+//   <id>U<pct><C|A>  SET      e.g. 3U55A
+//   <id>X            STOP     e.g. 2X
+// The whole frame is validated first; only then is every motor updated in
+// one pass, so a bad item leaves all motors untouched. One ack: "OK B<n>".
+void MotorCore::handleBatch(const char *p) {
+  BatchItem items[WIRE_MAX_ITEMS];
+  uint8_t n = 0;
+
+  while (*p) {
+    if (n == WIRE_MAX_ITEMS) {
+      reply("ERR BATCH");
+      return;
+    }
+    BatchItem &it = items[n];
+
+    uint16_t id = 0;
+    if (*p < '0' || *p > '9') {
+      reply("ERR BADFMT");
+      return;
+    }
+    while (*p >= '0' && *p <= '9' && id < 100) id = id * 10 + (*p++ - '0');
+    if (id < 1 || id > MOTORS) {
+      reply("ERR ID");
+      return;
+    }
+    it.id = (uint8_t)id;
+    it.op = *p++;
+    it.sp = 0;
+    it.cw = true;
+
+    if (it.op == 'S' || it.op == 'U') {
+      uint16_t sp = 0;
+      bool digits = false;
+      while (*p >= '0' && *p <= '9') {
+        if (sp < 1000) sp = sp * 10 + (*p - '0');
+        p++;
+        digits = true;
+      }
+      if (!digits || (*p != 'C' && *p != 'A')) {
+        reply("ERR ARGS");
+        return;
+      }
+      it.sp = (uint8_t)(sp > 100 ? 100 : sp);
+      it.cw = (*p++ == 'C');
+    } else if (it.op != 'X') {
+      reply("ERR CMD");
+      return;
+    }
+
+    n++;
+    if (*p == ';') p++;
+    else if (*p) {
+      reply("ERR BADFMT");
+      return;
+    }
+  }
+
+  if (n == 0) {
+    reply("ERR ARGS");
+    return;
+  }
+
+  char msg[8] = "OK B";
+  *putUint(msg + 4, n) = 0;
+  runLine(items, n, msg);
+}
+
+// One NUL-terminated line in the receive buffer. Fields are cut in place by
+// overwriting their ':' separators, so nothing is copied.
+void MotorCore::handleLine(char *line) {
+  tag_   = 0;
+  timed_ = false;
+  line = trim(line);
+  if (*line == 0) return;
+
+  // Protocol handshake (never tagged): HELLO 1 = binary frames, HELLO 0 = ASCII
+  // and, at a new line rate, its confirmation
+  if (strcmp(line, "HELLO 1") == 0 || strcmp(line, "HELLO 0") == 0) {
+    binaryMode_ = (line[6] == '1');
+    if (baudPending_) {
+      baudPending_ = false;
+      baudOk_      = baud_;
+    }
+    char msg[12];
+    memcpy(msg, line, 7);
+    memcpy(msg + 7, " OK", 4);
+    reply(msg);
+    return;
+  }
+  if (handleBaud(line)) return;
+
+  if (line[0] == '@') {
+    char *sp = strchr(line, ' ');
+    if (!sp) {
+      reply("ERR BADFMT");
+      return;
+    }
+    *sp  = 0;
+    tag_ = line;
+    line = sp + 1;
+  }
+
+  if (strcmp(line, "TIME") == 0) {
+    char msg[16] = "TIME ";
+    *putUlong(msg + 5, micros()) = 0;
+    reply(msg);
+    return;
+  }
+
+  // AT <micros> <M... or B:...>
+  if (line[0] == 'A' && line[1] == 'T' && line[2] == ' ') {
+    const char *p = line + 3;
+    if (!parseUlong(p, at_) || *p != ' ') {
+      reply("ERR ARGS");
+      return;
+    }
+    while (*p == ' ') p++;
+    int32_t lead = (int32_t)(at_ - micros());
+    if (lead > SCHED_HORIZON_US || lead < -SCHED_HORIZON_US) {
+      reply("ERR ARGS");
+      return;
+    }
+    line = (char *)p;
+    if (line[0] != 'M' && !(line[0] == 'B' && line[1] == ':')) {
+      reply("ERR CMD");
+      return;
+    }
+    timed_ = true;
+  }
+
+  if (strcmp(line, "STATUS") == 0) {
+    reply("STATUS OK");
+    return;
+  }
+
+  if (strcmp(line, "STATE") == 0) {
+    char msg[64] = "STATE ";
+    char *w = msg + 6;
+    for (uint8_t id = 1; id <= MOTORS; id++) {
+      if (id > 1) *w++ = ',';
+      w    = putUint(w, speedPct_[id]);
+      *w++ = dir_[id] == 'A' ? 'A' : 'C';
+      *w++ = enabled_[id] ? '1' : '0';
+    }
+    *w = 0;
+    reply(msg);
+    return;
+  }
+
+  if (line[0] == 'B' && line[1] == ':') {
+    handleBatch(line + 2);
+    return;
+  }
+
+  // M<id>:<CMD>[:<speed>:<dir>]; numbers parse like String::toInt()
+  char *c1 = strchr(line, ':');
+  if (line[0] != 'M' || !c1) {
+    reply("ERR BADFMT");
+    return;
+  }
+  *c1 = 0;
+  long id = strtol(line + 1, 0, 10);
+  if (id < 1 || id > MOTORS) {
+    reply("ERR ID");
+    return;
+  }
+
+  char *cmd = c1 + 1;
+  char *c2  = strchr(cmd, ':');
+  if (c2) *c2 = 0;
+
+  if (strcmp(cmd, "STOP") == 0) {
+    BatchItem it = {(uint8_t)id, 'X', 0, true};
+    runLine(&it, 1, "OK");
+    return;
+  }
+
+  // START / SET need speed and dir
+  char *c3 = c2 ? strchr(c2 + 1, ':') : 0;
+  if (!c3) {
+    reply("ERR ARGS");
+    return;
+  }
+  *c3 = 0;
+
+  long sp = strtol(c2 + 1, 0, 10);
+  if (sp < 0) sp = 0;
+  if (sp > 100) sp = 100;
+  bool cw = (strcmp(c3 + 1, "CW") == 0);   // anything else is treated as CCW
+
+  BatchItem it = {(uint8_t)id, 0, (uint8_t)sp, cw};
+  if (strcmp(cmd, "START") == 0) it.op = 'S';
+  else if (strcmp(cmd, "SET") == 0) it.op = 'U';
+  else {
+    reply("ERR CMD");
+    return;
+  }
+  runLine(&it, 1, "OK");
+}
+
+// ---- Binary protocol (WireProtocol.h) ----
+
+void MotorCore::sendWireReply(uint8_t seq, uint8_t status, uint8_t arg) {
+  pwm_.flush();
+  WireReply r = {seq, status, arg};
+  uint8_t out[WIRE_MAX_ENCODED];
+  size_t len = wireEncodeFrame((const uint8_t *)&r, sizeof(r), out);
+  out_.write(out, len);
+}
+
+// Reply with a 32-bit value after the header (TIME, AT).
+void MotorCore::sendWireValue(uint8_t seq, uint8_t arg, uint32_t v) {
+  pwm_.flush();
+  uint8_t p[sizeof(WireReply) + sizeof(v)];
+  WireReply r = {seq, WST_OK, arg};
+  memcpy(p, &r, sizeof(r));
+  memcpy(p + sizeof(r), &v, sizeof(v));
+  uint8_t out[WIRE_MAX_ENCODED];
+  size_t len = wireEncodeFrame(p, sizeof(p), out);
+  out_.write(out, len);
+}
+
+// Full motor table for the backend's reconciler.
+void MotorCore::sendWireState(uint8_t seq) {
+  uint8_t p[sizeof(WireReply) + MOTORS * sizeof(WireMotorState)];
+  WireReply r = {seq, WST_OK, MOTORS};
+  memcpy(p, &r, sizeof(r));
+  for (uint8_t id = 1; id <= MOTORS; id++) {
+    WireMotorState m;
+    m.speed = speedPct_[id];
+    m.flags = (dir_[id] == 'A' ? WMS_CCW : 0) | (enabled_[id] ? WMS_ENABLED : 0);
+    memcpy(p + sizeof(r) + (id - 1) * sizeof(m), &m, sizeof(m));
+  }
+  uint8_t out[WIRE_MAX_ENCODED];
+  size_t len = wireEncodeFrame(p, sizeof(p), out);
+  out_.write(out, len);
+}
+
+// One COBS frame without its 0x00 delimiter. Decoded into a fixed buffer,
+// nothing is allocated.
+void MotorCore::handleFrame(const uint8_t *frame, uint8_t len) {
+  uint8_t p[WIRE_MAX_PAYLOAD];
+  size_t n = wireDecodeFrame(frame, len, p, sizeof(p));
+  if (n < sizeof(WireCmd)) {
+    // Not a valid frame: may be the handshake sent while we are in binary mode.
+    if (len >= 7 && memcmp(frame, "HELLO ", 6) == 0) {
+      char txt[8];
+      memcpy(txt, frame, 7);
+      txt[7] = 0;
+      handleLine(txt);
+    } else if (len >= 5 && len < 16 && memcmp(frame, "BAUD", 4) == 0) {
+      char txt[16];
+      memcpy(txt, frame, len);
+      txt[len] = 0;
+      tag_ = 0;
+      if (!handleBaud(trim(txt)) && binaryMode_) sendWireReply(0, WST_CRC, 0);
+    } else if (binaryMode_) {
+      sendWireReply(0, WST_CRC, 0);
+    }
+    return;
+  }
+
+  WireCmd cmd;
+  memcpy(&cmd, p, sizeof(cmd));
+  uint8_t op = cmd.op & ~WOP_CCW;
+  bool cw    = !(cmd.op & WOP_CCW);
+  uint8_t sp = cmd.speed > 100 ? 100 : cmd.speed;
+
+  if (op == WOP_STATUS) {
+    sendWireReply(cmd.seq, WST_OK, 0);
+    return;
+  }
+  if (op == WOP_STATE) {
+    sendWireState(cmd.seq);
+    return;
+  }
+  if (op == WOP_TIME) {
+    sendWireValue(cmd.seq, 0, micros());
+    return;
+  }
+
+  if (op == WOP_BATCH || op == WOP_AT) {
+    uint8_t count = cmd.id;
+    size_t head   = sizeof(WireCmd) + (op == WOP_AT ? sizeof(uint32_t) : 0);
+    if (count == 0 || count > WIRE_MAX_ITEMS || n != head + count * sizeof(WireItem)) {
+      sendWireReply(cmd.seq, WST_BATCH, 0);
+      return;
+    }
+    BatchItem items[WIRE_MAX_ITEMS];
+    for (uint8_t i = 0; i < count; i++) {
+      WireItem w;
+      memcpy(&w, p + head + i * sizeof(WireItem), sizeof(w));
+      uint8_t wop = w.op & ~WOP_CCW;
+      if (w.id < 1 || w.id > MOTORS) {
+        sendWireReply(cmd.seq, WST_ID, i);
+        return;
+      }
+      if (wop != WOP_START && wop != WOP_SET && wop != WOP_STOP) {
+        sendWireReply(cmd.seq, WST_CMD, i);
+        return;
+      }
+      items[i].id = w.id;
+      items[i].op = (wop == WOP_START) ? 'S' : (wop == WOP_SET) ? 'U' : 'X';
+      items[i].sp = w.speed > 100 ? 100 : w.speed;
+      items[i].cw = !(w.op & WOP_CCW);
+    }
+    if (op == WOP_BATCH) {
+      applyNow(items, count);
+      sendWireReply(cmd.seq, WST_OK, count);
+      return;
+    }
+    uint32_t at;
+    memcpy(&at, p + sizeof(WireCmd), sizeof(at));
+    int32_t lead = (int32_t)(at - micros());
+    if (lead > SCHED_HORIZON_US || lead < -SCHED_HORIZON_US) {
+      sendWireReply(cmd.seq, WST_ARGS, 0);
+      return;
+    }
+    if (!schedule(items, count, at, lead)) {
+      sendWireReply(cmd.seq, WST_FULL, 0);
+      return;
+    }
+    sendWireValue(cmd.seq, count, (uint32_t)lead);
+    return;
+  }
+
+  if (n != sizeof(WireCmd)) {
+    sendWireReply(cmd.seq, WST_ARGS, 0);
+    return;
+  }
+  if (cmd.id < 1 || cmd.id > MOTORS) {
+    sendWireReply(cmd.seq, WST_ID, 0);
+    return;
+  }
+  BatchItem it = {cmd.id, 0, sp, cw};
+  if (op == WOP_START)     it.op = 'S';
+  else if (op == WOP_SET)  it.op = 'U';
+  else if (op == WOP_STOP) it.op = 'X';
+  else {
+    sendWireReply(cmd.seq, WST_CMD, 0);
+    return;
+  }
+  applyNow(&it, 1);
+  sendWireReply(cmd.seq, WST_OK, 0);
+}
+
+// ASCII lines end at '\n', binary frames at 0x00. A 0x00 always terminates
+// whatever was collected, which lets the host resynchronise from either mode.
+void MotorCore::feed(uint8_t c) {
+  if (c == 0) {
+    if (rxLen_ > 0 && !rxOverflow_) handleFrame(rxBuf_, rxLen_);
+    rxLen_      = 0;
+    rxOverflow_ = false;
+    return;
+  }
+  if (c == '\n' && !binaryMode_) {
+    if (rxOverflow_) {
+      tag_ = 0;
+      reply("ERR BADFMT");
+    } else {
+      rxBuf_[rxLen_] = 0;
+      handleLine((char *)rxBuf_);
+    }
+    rxLen_      = 0;
+    rxOverflow_ = false;
+    return;
+  }
+  if (rxLen_ < RX_MAX) rxBuf_[rxLen_++] = c;
+  else rxOverflow_ = true;
+}
+
+void MotorCore::poll(Stream &in) {
+  if (schedLen_) runDue();
+  if (baudPending_ && millis() - baudSince_ >= BAUD_CONFIRM_MS) {
+    baudPending_ = false;
+    setBaud(baudOk_);
+  }
+  for (int n = in.available(); n > 0; n--) {
+    int c = in.read();
+    if (c < 0) break;
+    feed((uint8_t)c);
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <Arduino.h>
+#include "PwmBank.h"
+#include "WireProtocol.h"
+
+// Protocol core of MotorControlNine: receive state machine, ASCII and binary
+// command handling and the motor table, driving 9 motors over two PCA9685s
+// through a PwmBank. It only needs Print/Stream and Wire, so the same file
+// also builds on the host against the stand-ins in firmware/host.
+//
+// feed() takes one byte and never waits. Bytes collect in a fixed buffer; the
+// byte that completes a command ('\n' for an ASCII line, 0x00 for a frame or
+// anything collected in either mode) runs it in place. Nothing is allocated,
+// and each reply goes out in a single write, after the command's PWM changes
+// have been flushed, so an ack means the outputs have it.
+//
+// ASCII commands (any of them may be prefixed with "@<seq> ", echoed in front
+// of the reply):
+//   STATUS
+//   STATE            -> "STATE 40C1,0C0,..." (speed, C/A, enabled) for M1..M9
+//   M3:START:80:CW
+//   M3:STOP
+//   M7:SET:55:CCW
+//   B:1S40C;2X;3U55A
+//
+// Line rate (never tagged, also understood as "\0BAUD ...\n\0" in binary mode):
+//   BAUD?            -> "BAUDS 115200,250000,..." (rates this board can run)
+//   BAUD 1000000     -> "BAUD 1000000 OK" at the old rate, then the switch
+// A switch stands only once a HELLO arrives at the new rate; after
+// BAUD_CONFIRM_MS without one the board goes back to the last confirmed
+// rate, so a link that cannot carry the new rate recovers by itself.
+//
+// Clock and held commands (both may be tagged):
+//   TIME                           -> "TIME 123456789" (micros())
+//   AT 123456789 M3:START:80:CW    -> "OK AT 4850", runs when micros() gets there
+//   AT 123456789 B:1S40C;2S40C        (4850 = microseconds to go, <= 0: late, ran now)
+// Held items wait in a fixed, time-ordered queue of SCHED_MAX (a batch takes
+// one per item, "ERR FULL" if they do not fit); everything due together is
+// applied in one pass and latched on one STOP. Times more than
+// SCHED_HORIZON_US away either way get ERR ARGS. An immediate command drops
+// what is held for its motors: the latest command wins.
+class MotorCore {
+public:
+  static const uint8_t MOTORS = 9;
+  static const uint8_t RX_MAX = 96;
+  static const uint32_t BAUD_DEFAULT = 115200;
+  static const uint16_t BAUD_CONFIRM_MS = 1000;
+  static const uint8_t SCHED_MAX = 16;
+  static const int32_t SCHED_HORIZON_US = 60000000L;
+
+  // Changes the UART rate after the pending output has gone out.
+  typedef void (*BaudFn)(uint32_t baud);
+
+  MotorCore(PwmBank &pwm, Print &out);
+  // Without a hook BAUD is acknowledged but nothing switches (USB CDC).
+  void setBaudHook(BaudFn fn) { baudFn_ = fn; }
+
+  void feed(uint8_t c);
+  // Runs held commands that are due, then feeds whatever has been received.
+  void poll(Stream &in);
+
+  // ids 1..9
+  uint8_t speed(uint8_t id) const { return speedPct_[id]; }
+  bool cw(uint8_t id) const { return dir_[id] != 'A'; }
+  bool enabled(uint8_t id) const { return enabled_[id]; }
+  bool binaryMode() const { return binaryMode_; }
+  uint32_t baud() const { return baud_; }
+  bool baudPending() const { return baudPending_; }
+  uint8_t scheduled() const { return schedLen_; }
+
+private:
+  struct BatchItem {
+    uint8_t id;
+    char    op;   // 'S' START, 'U' SET, 'X' STOP
+    uint8_t sp;
+    bool    cw;
+  };
+
+  void driveMotorRaw(uint8_t id, uint16_t duty, bool cw);
+  void startMotor(uint8_t id, uint8_t sp, bool cw);
+  void stopMotor(uint8_t id);
+  void setMotor(uint8_t id, uint8_t sp, bool cw);
+  void applyBatch(const BatchItem *items, uint8_t n);
+  void applyNow(const BatchItem *items, uint8_t n);
+  bool schedule(const BatchItem *items, uint8_t n, uint32_t at, int32_t &lead);
+  void unschedule(const BatchItem *items, uint8_t n);
+  void runDue();
+  void runLine(const BatchItem *items, uint8_t n, const char *ok);
+
+  void handleLine(char *line);
+  bool handleBaud(const char *line);
+  void setBaud(uint32_t baud);
+  void handleBatch(const char *p);
+  void handleFrame(const uint8_t *frame, uint8_t len);
+  void reply(const char *msg);
+  void sendWireReply(uint8_t seq, uint8_t status, uint8_t arg);
+  void sendWireValue(uint8_t seq, uint8_t arg, uint32_t v);
+  void sendWireState(uint8_t seq);
+
+  PwmBank &pwm_;
+  Print &out_;
+
+  uint8_t speedPct_[MOTORS + 1];
+  char    dir_[MOTORS + 1];       // 'C' for CW, 'A' for CCW
+  bool    enabled_[MOTORS + 1];
+  bool    binaryMode_;
+
+  BaudFn   baudFn_;
+  uint32_t baud_;
+  uint32_t baudOk_;        // last confirmed rate, restored on timeout
+  bool     baudPending_;
+  unsigned long baudSince_;
+
+  struct Timed {
+    uint32_t  at;
+    BatchItem item;
+  };
+  Timed   sched_[SCHED_MAX];    // ordered by time, same time in arrival order
+  uint8_t schedLen_;
+
+  // Tag of the line being handled (points into rxBuf_), null if untagged.
+  const char *tag_;
+  // AT prefix of the line being handled
+  bool     timed_;
+  uint32_t at_;
+
+  uint8_t rxBuf_[RX_MAX + 1];
+  uint8_t rxLen_;
+  bool    rxOverflow_;
+};
@@ -0,0 +1,95 @@
+#include "PwmBank.h"
+
+// PCA9685 registers
+static const uint8_t REG_MODE1   = 0x00;
+static const uint8_t REG_MODE2   = 0x01;
+static const uint8_t REG_LED0    = 0x06;   // LEDn_ON_L = 0x06 + 4n, then ON_H, OFF_L, OFF_H
+static const uint8_t REG_ALL_LED = 0xFA;
+static const uint8_t MODE1_AI      = 0x20;
+static const uint8_t MODE1_ALLCALL = 0x01;
+static const uint8_t MODE2_OUTDRV  = 0x04;   // totem pole, OCH = 0: update on STOP
+static const uint8_t ALL_CALL_ADDR = 0x70;   // power-on ALLCALLADR
+
+// Register pointer + 4 bytes per channel must fit the AVR Wire buffer (32).
+static const uint8_t RUN_MAX = 7;
+
+PwmBank::PwmBank(TwoWire &wire, uint8_t addr0, uint8_t addr1, uint8_t options)
+  : wire_(wire), options_(options) {
+  addr_[0] = addr0;
+  addr_[1] = addr1;
+  memset(off_, 0, sizeof(off_));
+  memset(dirty_, 0, sizeof(dirty_));
+}
+
+void PwmBank::write8(uint8_t addr, uint8_t reg, uint8_t v) {
+  wire_.beginTransmission(addr);
+  wire_.write(reg);
+  wire_.write(v);
+  wire_.endTransmission();
+}
+
+void PwmBank::begin() {
+  for (uint8_t b = 0; b < BOARDS; b++) {
+    write8(addr_[b], REG_MODE1, MODE1_AI | MODE1_ALLCALL);
+    write8(addr_[b], REG_MODE2, MODE2_OUTDRV);
+  }
+  memset(off_, 0, sizeof(off_));
+  for (uint8_t b = 0; b < BOARDS; b++) dirty_[b] = 0xFFFF;
+  flush();
+}
+
+void PwmBank::flush() {
+  if (!(dirty_[0] | dirty_[1])) return;
+
+  if (options_ & ALL_CALL) {
+    bool allOff = true;
+    for (uint8_t b = 0; b < BOARDS && allOff; b++)
+      for (uint8_t ch = 0; ch < CHANNELS; ch++)
+        if (off_[b][ch]) { allOff = false; break; }
+    if (allOff) {
+      // ALL_LED_ON/OFF = 0 on every board at once
+      wire_.beginTransmission(ALL_CALL_ADDR);
+      wire_.write(REG_ALL_LED);
+      for (uint8_t i = 0; i < 4; i++) wire_.write(0);
+      wire_.endTransmission();
+      dirty_[0] = dirty_[1] = 0;
+      return;
+    }
+  }
+
+  // Runs of dirty channels as (board, first channel, count)
+  struct Run {
+    uint8_t board, ch, n;
+  };
+  Run runs[BOARDS * CHANNELS];
+  uint8_t nruns = 0;
+  for (uint8_t b = 0; b < BOARDS; b++) {
+    uint8_t ch = 0;
+    while (ch < CHANNELS) {
+      if (!(dirty_[b] >> ch & 1)) { ch++; continue; }
+      uint8_t first = ch;
+      while (ch < CHANNELS && (dirty_[b] >> ch & 1) && ch - first < RUN_MAX) ch++;
+      runs[nruns].board = b;
+      runs[nruns].ch    = first;
+      runs[nruns].n     = ch - first;
+      nruns++;
+    }
+    dirty_[b] = 0;
+  }
+
+  for (uint8_t i = 0; i < nruns; i++) {
+    const Run &r = runs[i];
+    wire_.beginTransmission(addr_[r.board]);
+    wire_.write(REG_LED0 + 4 * r.ch);
+    for (uint8_t k = 0; k < r.n; k++) {
+      uint16_t off = off_[r.board][r.ch + k];
+      wire_.write(0);
+      wire_.write(0);
+      wire_.write((uint8_t)off);
+      wire_.write((uint8_t)(off >> 8));
+    }
+    // STOP only after the board's (or, in sync, the bank's) last run
+    bool last = i + 1 == nruns || (!(options_ & SYNC_BOARDS) && runs[i + 1].board != r.board);
+    wire_.endTransmission(last);
+  }
+}
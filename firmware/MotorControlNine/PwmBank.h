@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+// Shadow copy of the 32 PWM channels on the two PCA9685 boards. set() only
+// touches the shadow and marks the channel dirty; flush() writes what changed
+// as auto-increment bursts, one transaction per contiguous run of dirty
+// channels (split to fit the 32-byte Wire buffer), instead of one
+// transaction per channel.
+//
+// A board's transactions are chained with repeated STARTs and end in a
+// single STOP. With MODE2 OCH clear, the PCA9685 applies new register values
+// at the STOP, so all of that board's outputs change at the same moment.
+//   SYNC_BOARDS  chain both boards the same way, so all 32 outputs change on one STOP
+//   ALL_CALL     "everything off" becomes a single ALL_LED_* write to 0x70;
+//                leave it out if another device on the bus answers 0x70
+class PwmBank {
+public:
+  static const uint8_t BOARDS   = 2;
+  static const uint8_t CHANNELS = 16;
+  enum { SYNC_BOARDS = 0x01, ALL_CALL = 0x02 };
+
+  PwmBank(TwoWire &wire, uint8_t addr0, uint8_t addr1, uint8_t options);
+
+  // After the boards' begin()/setPWMFreq(): sets MODE1 AI | ALLCALL and
+  // MODE2 OCH = 0 on both, then drives every channel low.
+  void begin();
+
+  // On-time 0..4095 of a channel whose on-point is 0.
+  void set(uint8_t board, uint8_t ch, uint16_t off) {
+    if (off_[board][ch] == off) return;
+    off_[board][ch] = off;
+    dirty_[board] |= (uint16_t)1 << ch;
+  }
+  void flush();
+
+private:
+  void write8(uint8_t addr, uint8_t reg, uint8_t v);
+
+  TwoWire &wire_;
+  uint8_t  addr_[BOARDS];
+  uint8_t  options_;
+  uint16_t off_[BOARDS][CHANNELS];
+  uint16_t dirty_[BOARDS];   // bit per channel
+};
@@ -0,0 +1,147 @@
+#pragma once
+// Binary framing shared by MotorControlNine and the backend (which adds this
+// directory to its include path), so both sides use the same layouts.
+//
+// A frame is COBS(payload + CRC-16/CCITT-FALSE little-endian) followed by a
+// single 0x00 delimiter. Payloads are the packed structs below; both the AVR
+// and the x86/ARM host are little-endian.
+//
+// The link starts in ASCII mode. "HELLO 1" (answered "HELLO 1 OK") switches
+// the firmware to binary frames, "HELLO 0" back to ASCII. The host sends the
+// handshake as "\0HELLO n\n\0" so it is understood in either mode; the
+// line-rate commands ("BAUD?", "BAUD <rate>", see MotorCore.h) travel the same way.
+//
+// Clock values are the board's micros(): 32 bits, wrapping about every 71 min.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define WIRE_PROTO_VERSION 1
+
+enum WireOp {
+  WOP_STATUS = 1,
+  WOP_START  = 2,
+  WOP_STOP   = 3,
+  WOP_SET    = 4,
+  WOP_BATCH  = 5,   // WireCmd.id = item count, followed by that many WireItems
+  WOP_STATE  = 6,   // reply: WireReply{arg = count} followed by count WireMotorState
+  WOP_TIME   = 7,   // reply: WireReply followed by the board clock, uint32
+  WOP_AT     = 8,   // WireCmd.id = item count, then the uint32 board time to run
+                    // them at and the WireItems; reply: WireReply{arg = count}
+                    // followed by int32 microseconds to go (<= 0: ran late)
+};
+static const uint8_t WOP_CCW = 0x80;   // direction flag or'ed into op
+
+enum WireStatus {
+  WST_OK     = 0,
+  WST_BADFMT = 1,
+  WST_ID     = 2,
+  WST_ARGS   = 3,
+  WST_CMD    = 4,
+  WST_CRC    = 5,
+  WST_BATCH  = 6,
+  WST_FULL   = 7,   // WOP_AT: no room in the firmware's queue
+};
+
+struct __attribute__((packed)) WireCmd {
+  uint8_t seq;     // low byte of the host sequence number, echoed in the reply
+  uint8_t op;      // WireOp | WOP_CCW
+  uint8_t id;      // motor id (1..9) or batch item count
+  uint8_t speed;   // 0..100
+};
+
+struct __attribute__((packed)) WireItem {
+  uint8_t id;
+  uint8_t op;      // WOP_START / WOP_SET / WOP_STOP | WOP_CCW
+  uint8_t speed;
+};
+
+struct __attribute__((packed)) WireReply {
+  uint8_t seq;
+  uint8_t status;  // WireStatus
+  uint8_t arg;     // e.g. number of batch items applied
+};
+
+struct __attribute__((packed)) WireMotorState {
+  uint8_t speed;
+  uint8_t flags;   // WMS_*
+};
+static const uint8_t WMS_CCW     = 0x01;
+static const uint8_t WMS_ENABLED = 0x02;
+
+static const uint8_t WIRE_MAX_ITEMS   = 16;
+static const size_t  WIRE_MAX_PAYLOAD = sizeof(WireCmd) + sizeof(uint32_t) + WIRE_MAX_ITEMS * sizeof(WireItem) + 2;
+static const size_t  WIRE_MAX_ENCODED = WIRE_MAX_PAYLOAD + WIRE_MAX_PAYLOAD / 254 + 2;   // + delimiter
+
+inline uint16_t wireCrc16(const uint8_t *p, size_t n) {
+  uint16_t crc = 0xFFFF;
+  while (n--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+// Consistent Overhead Byte Stuffing; output never contains 0x00.
+inline size_t wireCobsEncode(const uint8_t *in, size_t n, uint8_t *out) {
+  uint8_t *code = out;
+  uint8_t *dst  = out + 1;
+  uint8_t run   = 1;
+  for (size_t i = 0; i < n; i++) {
+    if (in[i] == 0) {
+      *code = run;
+      code  = dst++;
+      run   = 1;
+    } else {
+      *dst++ = in[i];
+      if (++run == 0xFF) {
+        *code = run;
+        code  = dst++;
+        run   = 1;
+      }
+    }
+  }
+  *code = run;
+  return (size_t)(dst - out);
+}
+
+// Returns the decoded length, or 0 if the input is malformed or too long.
+inline size_t wireCobsDecode(const uint8_t *in, size_t n, uint8_t *out, size_t cap) {
+  size_t r = 0, w = 0;
+  while (r < n) {
+    uint8_t run = in[r++];
+    if (run == 0) return 0;
+    for (uint8_t i = 1; i < run; i++) {
+      if (r >= n || w >= cap || in[r] == 0) return 0;
+      out[w++] = in[r++];
+    }
+    if (run != 0xFF && r < n) {
+      if (w >= cap) return 0;
+      out[w++] = 0;
+    }
+  }
+  return w;
+}
+
+// payload -> COBS frame including the trailing 0x00. `out` must hold WIRE_MAX_ENCODED.
+inline size_t wireEncodeFrame(const uint8_t *payload, size_t n, uint8_t *out) {
+  uint8_t tmp[WIRE_MAX_PAYLOAD];
+  if (n + 2 > sizeof(tmp)) return 0;
+  memcpy(tmp, payload, n);
+  uint16_t crc = wireCrc16(payload, n);
+  tmp[n]     = (uint8_t)(crc & 0xFF);
+  tmp[n + 1] = (uint8_t)(crc >> 8);
+  size_t len = wireCobsEncode(tmp, n + 2, out);
+  out[len++] = 0;
+  return len;
+}
+
+// COBS frame (without delimiter) -> payload length, or 0 on COBS/CRC error.
+inline size_t wireDecodeFrame(const uint8_t *frame, size_t n, uint8_t *payload, size_t cap) {
+  size_t len = wireCobsDecode(frame, n, payload, cap);
+  if (len < 3) return 0;
+  len -= 2;
+  uint16_t crc = (uint16_t)(payload[len] | (payload[len + 1] << 8));
+  return wireCrc16(payload, len) == crc ? len : 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+// Host stand-in for the PCA9685 driver. Every call turns into the same I2C
+// writes the library makes, on the TwoWire bus model: one transaction per
+// setPWM() (LEDn register pointer + 4 bytes), and the library's reset and
+// prescaler sequence, which leaves MODE1 at AI | RESTART.
+#include <stdint.h>
+#include "Wire.h"
+
+class Adafruit_PWMServoDriver {
+public:
+  explicit Adafruit_PWMServoDriver(uint8_t addr = 0x40, TwoWire &i2c = Wire) : addr_(addr), i2c_(i2c) {}
+
+  void begin() { write8(0x00, 0x80); }   // reset: MODE1 = RESTART
+  void setPWMFreq(float freq) {
+    float pre = 25000000.0f / (4096.0f * freq) - 1.0f;
+    write8(0x00, 0x10);                  // sleep to change the prescaler
+    write8(0xFE, (uint8_t)(pre + 0.5f));
+    write8(0x00, 0x00);
+    write8(0x00, 0xA0);                  // RESTART | AI
+  }
+  uint8_t setPWM(uint8_t num, uint16_t on, uint16_t off) {
+    i2c_.beginTransmission(addr_);
+    i2c_.write((uint8_t)(0x06 + 4 * num));
+    i2c_.write((uint8_t)on);
+    i2c_.write((uint8_t)(on >> 8));
+    i2c_.write((uint8_t)off);
+    i2c_.write((uint8_t)(off >> 8));
+    return i2c_.endTransmission();
+  }
+
+private:
+  void write8(uint8_t reg, uint8_t v) {
+    i2c_.beginTransmission(addr_);
+    i2c_.write(reg);
+    i2c_.write(v);
+    i2c_.endTransmission();
+  }
+
+  uint8_t addr_;
+  TwoWire &i2c_;
+};
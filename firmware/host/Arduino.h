@@ -0,0 +1,59 @@
+#pragma once
+// Just enough of the Arduino core to build the MotorControlNine protocol core
+// (MotorCore.cpp) on the host. Serial is a HostSerial: bytes queued with
+// inject() come out of read(), everything written is appended to output().
+// The clock follows steady_clock until hostClockSet() pins it, for runs that
+// must be repeatable (the fuzz target steps it by hand).
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+unsigned long millis();
+unsigned long micros();   // wraps at 32 bits, as on the AVR
+// From now on micros() is the low 32 bits of `us` and millis() is us / 1000.
+void hostClockSet(unsigned long long us);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) {
+    size_t w = 0;
+    while (n--) w += write(*buf++);
+    return w;
+  }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t println() { return print("\r\n"); }
+  size_t println(const char *s) { return print(s) + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+class HostSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+
+  int available() override { return (int)(in_.size() - pos_); }
+  int read() override { return pos_ < in_.size() ? (uint8_t)in_[pos_++] : -1; }
+  size_t write(uint8_t c) override { out_ += (char)c; return 1; }
+  size_t write(const uint8_t *buf, size_t n) override { out_.append((const char *)buf, n); return n; }
+
+  void inject(const void *p, size_t n) {
+    if (pos_ == in_.size()) { in_.clear(); pos_ = 0; }
+    in_.append((const char *)p, n);
+  }
+  std::string &output() { return out_; }
+
+private:
+  std::string in_, out_;
+  size_t pos_ = 0;
+};
+
+extern HostSerial Serial;
@@ -0,0 +1,26 @@
+#include "Arduino.h"
+#include <chrono>
+
+HostSerial Serial;
+
+static bool pinned = false;
+static unsigned long long pinnedUs = 0;
+
+static unsigned long long elapsedUs() {
+  if (pinned) return pinnedUs;
+  static const auto t0 = std::chrono::steady_clock::now();
+  return (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+unsigned long millis() {
+  return (unsigned long)(elapsedUs() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)elapsedUs();
+}
+
+void hostClockSet(unsigned long long us) {
+  pinned   = true;
+  pinnedUs = us;
+}
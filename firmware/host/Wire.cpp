@@ -0,0 +1,101 @@
+#include "Wire.h"
+#include <string.h>
+
+namespace {
+
+const uint8_t MODE1 = 0x00, MODE2 = 0x01, LED0 = 0x06, ALL_LED = 0xFA;
+const uint8_t MODE1_AI = 0x20, MODE1_ALLCALL = 0x01, MODE2_OCH = 0x08;
+
+uint16_t onTime(const uint8_t *led) {
+  if (led[3] & 0x10) return 0;       // full off wins
+  if (led[1] & 0x10) return 4096;
+  uint16_t on  = (uint16_t)(led[0] | (led[1] & 0x0F) << 8);
+  uint16_t off = (uint16_t)(led[2] | (led[3] & 0x0F) << 8);
+  return (uint16_t)((off - on) & 0x0FFF);
+}
+
+}
+
+TwoWire::Chip::Chip() {
+  memset(reg, 0, sizeof(reg));
+  reg[MODE1] = 0x11;                 // SLEEP | ALLCALL
+  reg[MODE2] = 0x04;
+  for (int ch = 0; ch < 16; ch++) reg[LED0 + 4 * ch + 3] = 0x10;   // full off
+  reg[ALL_LED + 3] = 0x10;
+  memset(out, 0, sizeof(out));
+}
+
+void TwoWire::Chip::write(uint8_t r, uint8_t v) {
+  reg[r] = v;
+  if (r >= ALL_LED && r < ALL_LED + 4)
+    for (int ch = 0; ch < 16; ch++) reg[LED0 + 4 * ch + (r - ALL_LED)] = v;
+  if (reg[MODE2] & MODE2_OCH) latch();   // outputs change on ACK
+}
+
+bool TwoWire::Chip::latch() {
+  bool changed = false;
+  for (int ch = 0; ch < 16; ch++) {
+    uint16_t d = onTime(reg + LED0 + 4 * ch);
+    changed |= d != out[ch];
+    out[ch] = d;
+  }
+  return changed;
+}
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  addr_     = addr;
+  len_      = 0;
+  overflow_ = false;
+}
+
+size_t TwoWire::write(uint8_t b) {
+  if (len_ == BUFFER_LENGTH) {
+    overflow_ = true;
+    return 0;
+  }
+  buf_[len_++] = b;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *p, size_t n) {
+  size_t w = 0;
+  while (n-- && write(*p++)) w++;
+  return w;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  stats_.transactions++;
+  stats_.bytes += 1u + len_;
+  stats_.overflows += overflow_;
+  if (len_ > 0) {
+    if (addr_ != ALL_CALL_ADDR) chips_[addr_];
+    for (auto &kv : chips_) {
+      Chip &c = kv.second;
+      if (addr_ == ALL_CALL_ADDR ? !(c.reg[MODE1] & MODE1_ALLCALL) : kv.first != addr_) continue;
+      uint8_t r = buf_[0];
+      for (uint8_t i = 1; i < len_; i++) {
+        c.write(r, buf_[i]);
+        if (c.reg[MODE1] & MODE1_AI) r = (r == 0x45) ? 0 : (uint8_t)(r + 1);
+      }
+    }
+  }
+  if (stop) {
+    stats_.stops++;
+    bool changed = false;
+    for (auto &kv : chips_) changed |= kv.second.latch();
+    if (changed) stats_.latches++;
+  }
+  return overflow_ ? 1 : 0;
+}
+
+uint16_t TwoWire::duty(uint8_t addr, uint8_t ch) const {
+  auto it = chips_.find(addr);
+  return it == chips_.end() || ch >= 16 ? 0 : it->second.out[ch];
+}
+
+uint8_t TwoWire::reg(uint8_t addr, uint8_t r) const {
+  auto it = chips_.find(addr);
+  return it == chips_.end() ? 0 : it->second.reg[r];
+}
@@ -0,0 +1,57 @@
+#pragma once
+// Host stand-in for the Arduino I2C library: a bus of PCA9685 register
+// models, one per address as soon as it is addressed. Writes behave like the
+// chip: the first byte sets the register pointer, MODE1 AI advances it,
+// ALL_LED_* fan out to every channel, and 0x70 (ALL_CALL) reaches every board
+// with MODE1 ALLCALL set. With MODE2 OCH clear, outputs change on the STOP
+// condition, so repeated-START transactions that end in one STOP change them
+// all at the same instant. stats() counts what a full update costs.
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+
+class TwoWire {
+public:
+  static const uint8_t BUFFER_LENGTH = 32;   // the AVR twi buffer
+  static const uint8_t ALL_CALL_ADDR = 0x70;
+
+  struct Stats {
+    unsigned long transactions = 0;   // endTransmission() calls
+    unsigned long bytes = 0;          // address byte + data, as clocked on the bus
+    unsigned long stops = 0;          // STOP conditions
+    unsigned long latches = 0;        // STOPs at which some output changed
+    unsigned long overflows = 0;      // transactions longer than BUFFER_LENGTH
+  };
+
+  void begin() {}
+  void beginTransmission(uint8_t addr);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *p, size_t n);
+  // 0 ok, 1 more than BUFFER_LENGTH bytes written (the rest was dropped)
+  uint8_t endTransmission(bool stop = true);
+
+  // Latched on-time of a channel, 0..4095, 4096 = full on.
+  uint16_t duty(uint8_t addr, uint8_t ch) const;
+  uint8_t reg(uint8_t addr, uint8_t r) const;
+
+  const Stats &stats() const { return stats_; }
+  void resetStats() { stats_ = Stats(); }
+
+private:
+  struct Chip {
+    uint8_t reg[256];
+    uint16_t out[16];
+    Chip();
+    void write(uint8_t r, uint8_t v);
+    bool latch();   // true if an output changed
+  };
+
+  std::map<uint8_t, Chip> chips_;
+  uint8_t addr_ = 0;
+  uint8_t buf_[BUFFER_LENGTH];
+  uint8_t len_ = 0;
+  bool overflow_ = false;
+  Stats stats_;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,174 @@
+// Differential fuzz target for the MotorControlNine protocol core built on the
+// host (firmware/MotorControlNine/MotorCore.cpp against firmware/host). Each
+// input is fed to MotorCore in pieces, the way loop() sees it arrive, and in
+// one go to fake_arduino's FirmwareModel: the replies and the motor tables
+// must match byte for byte, and every motor's PCA9685 channels, as latched on
+// the host I2C bus model, must carry the duty its table entry implies. Both
+// sides share a pinned clock that the input moves forward piece by piece,
+// starting just before micros() wraps; at the end it jumps past every held
+// command and the tables are compared again. Runs once per PwmBank mode. With clang the target links libFuzzer:
+//   cmake -S . -B fuzz-build -DONE_MOTOR_FUZZ=ON -DCMAKE_CXX_COMPILER=clang++
+//   ./fuzz-build/firmware_fuzz -max_len=1024
+// Other compilers get the standalone ASan/UBSan driver: ./firmware_fuzz [iterations]
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "FirmwareModel.hpp"
+#include "MotorCore.h"
+
+namespace {
+
+void check(bool ok, const char *what){
+    if (ok) return;
+    std::fprintf(stderr, "firmware_fuzz: %s\n", what);
+    std::abort();
+}
+
+const unsigned long long kClockStart = 0xFFFF0000ull;   // micros() wraps 65.5 ms in
+
+uint16_t duty(const TwoWire &bus, int id, bool in2){
+    int ch = ((id - 1) % 8) * 2 + (in2 ? 1 : 0);
+    return bus.duty(id <= 8 ? 0x40 : 0x41, (uint8_t)ch);
+}
+
+void checkTables(const MotorCore &core, const FirmwareModel &model, const TwoWire &bus){
+    check(core.scheduled() == model.scheduled(), "held commands differ");
+    for (int id = 1; id <= 9; ++id){
+        const FirmwareModel::Motor &m = model.motor(id);
+        check(core.speed((uint8_t)id) == m.speed && core.cw((uint8_t)id) == m.cw && core.enabled((uint8_t)id) == m.enabled,
+              "motor table differs");
+        uint16_t want = m.enabled ? (uint16_t)(m.speed * 4095UL / 100UL) : 0;
+        check(duty(bus, id, false) == (m.cw ? want : 0) && duty(bus, id, true) == (m.cw ? 0 : want),
+              "PWM output does not match the motor table");
+    }
+}
+
+void run(const uint8_t *data, size_t size, uint8_t options){
+    TwoWire bus;
+    PwmBank pwm(bus, 0x40, 0x41, options);
+    pwm.begin();
+    HostSerial serial;
+    MotorCore core(pwm, serial);
+    FirmwareModel model;
+    model.reset();
+    std::string expected;
+    unsigned long long now = kClockStart;
+    size_t fed = 0, i = 0;
+    while (fed < size){
+        size_t step = 1 + data[i++ % size] % 23;
+        if (step > size - fed) step = size - fed;
+        now += (data[fed + step - 1] % 16) * 500ull;
+        hostClockSet(now);
+        model.setClock((uint32_t)now);
+        model.runDue();
+        serial.inject(data + fed, step);
+        model.feed(data + fed, step, expected);
+        fed += step;
+        core.poll(serial);
+        check(serial.available() == 0, "poll left input behind");
+    }
+
+    check(serial.output() == expected, "replies differ from FirmwareModel");
+    check(core.binaryMode() == model.binaryMode(), "protocol mode differs");
+    check(core.baud() == model.baud() && core.baudPending() == model.baudPending(), "line rate differs");
+    checkTables(core, model, bus);
+    check(bus.stats().overflows == 0, "I2C transaction longer than the Wire buffer");
+
+    // Past the horizon: everything held has run
+    now += MotorCore::SCHED_HORIZON_US + 1000000ull;
+    hostClockSet(now);
+    core.poll(serial);
+    model.setClock((uint32_t)now);
+    model.runDue();
+    check(core.scheduled() == 0, "held commands left past the horizon");
+    checkTables(core, model, bus);
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+    run(data, size, 0);
+    run(data, size, PwmBank::SYNC_BOARDS | PwmBank::ALL_CALL);
+    return 0;
+}
+
+#ifndef ONE_MOTOR_LIBFUZZER
+namespace {
+
+std::string frame(std::initializer_list<uint8_t> payload){
+    uint8_t p[WIRE_MAX_PAYLOAD], out[WIRE_MAX_ENCODED];
+    size_t n = 0;
+    for (uint8_t b : payload) p[n++] = b;
+    return std::string((const char *)out, wireEncodeFrame(p, n, out));
+}
+
+std::string seed(size_t k){
+    switch (k % 12){
+    case 0: return "M1:START:40:CW\nM2:SET:55:CCW\nM1:STOP\nSTATE\n";
+    case 1: return "@17 M3:START:80:CCW\n@18 STATUS\n@19 B:1S40C;2X;3U55A\n@20 STATE\n";
+    case 2: return "  M9:START:+120:CW\r\nM0:STOP\nM1:FOO:1:CW\nM1:START:5\n@x\nB:\nB:1S;\n";
+    case 3: return std::string("\0HELLO 1\n\0", 10) + frame({1, WOP_START, 4, 70}) + frame({2, WOP_STATE, 0, 0});
+    case 4: return std::string("\0HELLO 1\n\0", 10) + frame({5, WOP_BATCH, 2, 0, 1, WOP_START | WOP_CCW, 30, 9, WOP_STOP, 0})
+                 + frame({6, WOP_SET, 12, 5}) + std::string("\x05garbage\0", 9) + std::string("HELLO 0\n\0", 9) + "M1:STOP\n";
+    case 5: return std::string(120, 'M') + "\nM2:START:10:CW\n";
+    case 6: return std::string("BAUD?\nBAUD 1000000\nM1:STOP\nHELLO 0\n\0BAUD 2000000\n\0BAUD 9600\n", 60)
+                 + std::string("\0HELLO 1\n\0\0BAUD 250000\n\0\0BAUD?\n\0\0BAUD x\n\0", 41);
+    case 7: return "B:1S1C;2S2C;3S3C;4S4C;5S5C;6S6C;7S7C;8S8C;9S9C;1X;2X;3X;4X;5X;6X;7X;8X\n";
+    case 8: return "TIME\n@3 AT 4294903000 M1:START:40:CW\nAT 4294950000 B:2S30A;3S30A\n@4 AT 2000 M2:STOP\n"
+                   "AT 4294900000 M4:START:10:CW\nAT 1000000000 M5:STOP\nAT 4294903000 STATUS\nM3:SET:20:CW\nTIME\n";
+    case 9: return std::string("\0HELLO 1\n\0", 10) + frame({1, WOP_TIME, 0, 0})
+                 + frame({2, WOP_AT, 2, 0, 0xA8, 0x0C, 0xFF, 0xFF, 1, WOP_START, 30, 9, WOP_START | WOP_CCW, 60})
+                 + frame({3, WOP_AT, 1, 0, 0x00, 0x10, 0, 0, 5, WOP_SET | WOP_CCW, 50})
+                 + frame({4, WOP_STOP, 1, 0}) + frame({5, WOP_AT, 1, 0, 0, 0, 0, 0x40, 2, WOP_STOP, 0});
+    case 10: return "AT 4294960000 B:1S1C;2S2C;3S3C;4S4C;5S5C;6S6C;7S7C;8S8C;9S9C\n"
+                    "AT 4294960000 B:1X;2X;3X;4X;5X;6X;7X;8X\nAT 4294904000 M9:START:70:CCW\nAT 4294960000 M7:STOP\n";
+    default: return "\v\fM4:START:99:CW\t\nHELLO 0\nHELLO 1\n";
+    }
+}
+
+std::string mutate(std::string s, unsigned &rng){
+    auto next = [&]{ rng = rng * 1103515245u + 12345u; return rng >> 8; };
+    static const char *kTokens[] = {"\n", ":", "@", " ", ";", "M1:", "START", "CW", "B:", "HELLO 1\n", "\r\n",
+                                    "BAUD", "BAUD?\n", "BAUD 500000\n", "TIME\n", "AT 4294903000 ", "AT "};
+    int n = 1 + (int)(next() % 6);
+    for (int k = 0; k < n; ++k){
+        size_t pos = s.empty() ? 0 : next() % (s.size() + 1);
+        switch (next() % 6){
+        case 0: if (!s.empty() && pos < s.size()) s.erase(pos, 1 + next() % 4); break;
+        case 1: s.insert(pos, 1, (char)(next() & 0xff)); break;
+        case 2: if (pos < s.size()) s[pos] = (char)(next() & 0xff); break;
+        case 3: s.insert(pos, kTokens[next() % (sizeof(kTokens) / sizeof(kTokens[0]))]); break;
+        case 4: s.insert(pos, 1, '\0'); break;
+        case 5: s += seed(next()); break;
+        }
+    }
+    return s;
+}
+
+}
+
+int main(int argc, char **argv){
+    if (argc > 1 && std::atol(argv[1]) == 0){
+        for (int i = 1; i < argc; ++i){
+            FILE *f = std::fopen(argv[i], "rb");
+            if (!f) { std::perror(argv[i]); return 1; }
+            std::string s; char buf[4096]; size_t n;
+            while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+            std::fclose(f);
+            LLVMFuzzerTestOneInput((const uint8_t *)s.data(), s.size());
+        }
+        std::printf("%d inputs ok\n", argc - 1);
+        return 0;
+    }
+    long iters = argc > 1 ? std::atol(argv[1]) : 200000;
+    unsigned rng = 1;
+    for (long i = 0; i < iters; ++i){
+        std::string s = mutate(seed((size_t)i), rng);
+        LLVMFuzzerTestOneInput((const uint8_t *)s.data(), s.size());
+    }
+    std::printf("%ld inputs ok\n", iters);
+    return 0;
+}
+#endif
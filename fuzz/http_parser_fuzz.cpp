@@ -0,0 +1,167 @@
+// Fuzz target for HttpParser. Each input is parsed twice, once as a whole and
+// once delivered in pieces (piece sizes taken from the input itself), and the
+// two must yield the same requests and the same final status. Every view must
+// point into the buffer. With clang the target links libFuzzer:
+//   cmake -S . -B fuzz-build -DONE_MOTOR_FUZZ=ON -DCMAKE_CXX_COMPILER=clang++
+//   ./fuzz-build/http_parser_fuzz -max_len=4096
+// Other compilers get a standalone driver under ASan/UBSan that replays the
+// files given on the command line, or runs random mutations of a few seed
+// requests: ./http_parser_fuzz [iterations]
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HttpParser.hpp"
+
+namespace {
+
+constexpr size_t kMaxBody = 4096;
+
+struct Parsed {
+    std::string method, target, path, query, body;
+    size_t nheaders = 0, consumed = 0;
+    bool keepAlive = false;
+
+    bool operator==(const Parsed &o) const {
+        return method == o.method && target == o.target && path == o.path && query == o.query && body == o.body &&
+               nheaders == o.nheaders && consumed == o.consumed && keepAlive == o.keepAlive;
+    }
+};
+
+struct Outcome {
+    std::vector<Parsed> requests;
+    HttpParser::Status last = HttpParser::Status::Incomplete;
+    int error = 0;
+};
+
+void check(bool ok, const char *what){
+    if (ok) return;
+    std::fprintf(stderr, "http_parser_fuzz: %s\n", what);
+    std::abort();
+}
+
+bool inside(std::string_view v, const char *buf, size_t len){
+    return v.empty() || (v.data() >= buf && v.data() + v.size() <= buf + len);
+}
+
+Parsed record(const HttpParser &p, const HttpParser::Request &req, const char *buf, size_t len){
+    check(p.consumed() > 0 && p.consumed() <= len, "consumed out of range");
+    for (auto v : {req.method, req.target, req.path, req.query, req.body}) check(inside(v, buf, len), "view outside buffer");
+    check(req.nheaders <= HttpParser::kMaxHeaders, "too many headers");
+    for (size_t i = 0; i < req.nheaders; ++i)
+        check(inside(req.headers[i].name, buf, len) && inside(req.headers[i].value, buf, len), "header outside buffer");
+    check(!req.method.empty() && !req.target.empty(), "empty request line");
+    check(req.body.size() <= kMaxBody, "body over limit");
+    return Parsed{std::string(req.method), std::string(req.target), std::string(req.path), std::string(req.query),
+                  std::string(req.body), req.nheaders, p.consumed(), req.keepAlive};
+}
+
+Outcome whole(const uint8_t *data, size_t size){
+    std::string in((const char *)data, size);
+    HttpParser p(kMaxBody);
+    HttpParser::Request req;
+    Outcome o;
+    size_t off = 0;
+    while (off < in.size()){
+        o.last = p.parse(&in[off], in.size() - off, req);
+        if (o.last != HttpParser::Status::Complete) break;
+        o.requests.push_back(record(p, req, &in[off], in.size() - off));
+        off += p.consumed();
+    }
+    if (o.last == HttpParser::Status::Error) o.error = p.errorStatus();
+    if (o.last == HttpParser::Status::Complete) o.last = HttpParser::Status::Incomplete;   // ran out of input
+    return o;
+}
+
+// Like HttpServer: append what arrived, parse, drop consumed bytes.
+Outcome pieces(const uint8_t *data, size_t size){
+    std::string in;
+    HttpParser p(kMaxBody);
+    HttpParser::Request req;
+    Outcome o;
+    size_t fed = 0, i = 0;
+    while (fed < size){
+        size_t step = 1 + data[i++ % size] % 37;
+        if (step > size - fed) step = size - fed;
+        in.append((const char *)data + fed, step);
+        fed += step;
+        while (!in.empty()){
+            o.last = p.parse(&in[0], in.size(), req);
+            if (o.last != HttpParser::Status::Complete) break;
+            o.requests.push_back(record(p, req, in.data(), in.size()));
+            in.erase(0, p.consumed());
+        }
+        if (o.last == HttpParser::Status::Error) { o.error = p.errorStatus(); break; }
+    }
+    if (o.last == HttpParser::Status::Complete) o.last = HttpParser::Status::Incomplete;
+    return o;
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+    if (size == 0) return 0;
+    Outcome a = whole(data, size), b = pieces(data, size);
+    check(a.requests.size() == b.requests.size(), "request count differs when split");
+    for (size_t i = 0; i < a.requests.size(); ++i) check(a.requests[i] == b.requests[i], "request differs when split");
+    check(a.last == b.last && a.error == b.error, "final status differs when split");
+    if (a.last == HttpParser::Status::Error)
+        check(a.error == 400 || a.error == 413 || a.error == 431 || a.error == 501, "unexpected error status");
+    return 0;
+}
+
+#ifndef ONE_MOTOR_LIBFUZZER
+namespace {
+
+const char *kSeeds[] = {
+    "GET /api/status?probe=1 HTTP/1.1\r\nHost: x\r\n\r\n",
+    "GET / HTTP/1.0\r\nConnection: keep-alive\r\nAccept-Encoding: gzip\r\n\r\nGET /app.js HTTP/1.1\r\n\r\n",
+    "POST /api/motors HTTP/1.1\r\nContent-Length: 11\r\n\r\n[{\"id\":1}]xGET / HTTP/1.1\r\n\r\n",
+    "POST /api/motors HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4;x=y\r\nabcd\r\n2\r\nef\r\n0\r\nX-T: 1\r\n\r\n",
+    "PUT /x HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\nConnection: close\r\n\r\nabc",
+};
+
+std::string mutate(std::string s, unsigned &rng){
+    auto next = [&]{ rng = rng * 1103515245u + 12345u; return rng >> 8; };
+    static const char *kTokens[] = {"\r\n", "\r\n\r\n", ":", " ", "0\r\n", "ffffffff", "Content-Length: ", "Transfer-Encoding: chunked\r\n", "?"};
+    int n = 1 + (int)(next() % 6);
+    for (int k = 0; k < n; ++k){
+        size_t pos = s.empty() ? 0 : next() % (s.size() + 1);
+        switch (next() % 5){
+        case 0: if (!s.empty() && pos < s.size()) s.erase(pos, 1 + next() % 4); break;
+        case 1: s.insert(pos, 1, (char)(next() & 0xff)); break;
+        case 2: if (pos < s.size()) s[pos] = (char)(next() & 0xff); break;
+        case 3: s.insert(pos, kTokens[next() % (sizeof(kTokens) / sizeof(kTokens[0]))]); break;
+        case 4: s += kSeeds[next() % (sizeof(kSeeds) / sizeof(kSeeds[0]))]; break;
+        }
+    }
+    return s;
+}
+
+}
+
+int main(int argc, char **argv){
+    if (argc > 1 && std::atol(argv[1]) == 0){
+        for (int i = 1; i < argc; ++i){
+            FILE *f = std::fopen(argv[i], "rb");
+            if (!f) { std::perror(argv[i]); return 1; }
+            std::string s; char buf[4096]; size_t n;
+            while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+            std::fclose(f);
+            LLVMFuzzerTestOneInput((const uint8_t *)s.data(), s.size());
+        }
+        std::printf("%d inputs ok\n", argc - 1);
+        return 0;
+    }
+    long iters = argc > 1 ? std::atol(argv[1]) : 200000;
+    unsigned rng = 1;
+    for (long i = 0; i < iters; ++i){
+        std::string s = mutate(kSeeds[i % (sizeof(kSeeds) / sizeof(kSeeds[0]))], rng);
+        LLVMFuzzerTestOneInput((const uint8_t *)s.data(), s.size());
+    }
+    std::printf("%ld inputs ok\n", iters);
+    return 0;
+}
+#endif
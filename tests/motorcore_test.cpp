@@ -0,0 +1,174 @@
+// MotorControlNine protocol core on the host (firmware/MotorControlNine/MotorCore.cpp
+// against firmware/host): line assembly, every ERR reply, all-or-nothing
+// batches and the AT queue, in ASCII and as binary frames. Registered with ctest:
+//   cmake -S . -B build && cmake --build build && ctest --test-dir build
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include "MotorCore.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *test, const char *what){
+    if (ok) return;
+    std::fprintf(stderr, "FAIL %s: %s\n", test, what);
+    ++failures;
+}
+
+const unsigned long long kClock = 10000000ull;   // 10 s, pinned
+
+struct Board {
+    TwoWire bus;
+    PwmBank pwm{bus, 0x40, 0x41, 0};
+    HostSerial serial;
+    MotorCore core{pwm, serial};
+
+    Board() { pwm.begin(); hostClockSet(kClock); }
+
+    // Feeds `in` as one read and returns what came back.
+    std::string send(const std::string &in){
+        serial.output().clear();
+        serial.inject(in.data(), in.size());
+        core.poll(serial);
+        return serial.output();
+    }
+
+    bool idle() const {
+        for (uint8_t id = 1; id <= MotorCore::MOTORS; ++id)
+            if (core.enabled(id)) return false;
+        return true;
+    }
+};
+
+std::string frame(std::initializer_list<uint8_t> payload){
+    uint8_t p[WIRE_MAX_PAYLOAD], out[WIRE_MAX_ENCODED];
+    size_t n = 0;
+    for (uint8_t b : payload) p[n++] = b;
+    return std::string((const char *)out, wireEncodeFrame(p, n, out));
+}
+
+// Status of the single reply frame in `out`, -1 if it does not decode.
+int wireStatus(const std::string &out){
+    uint8_t p[WIRE_MAX_PAYLOAD];
+    if (out.size() < 2 || out.back() != 0) return -1;
+    size_t n = wireDecodeFrame((const uint8_t *)out.data(), out.size() - 1, p, sizeof(p));
+    return n < sizeof(WireReply) ? -1 : p[1];
+}
+
+void partialLines(){
+    Board b;
+    check(b.send("M1:STA").empty(), "partial", "reply before the newline");
+    check(b.send("RT:40:").empty(), "partial", "reply before the newline");
+    check(b.send("CW\n") == "OK\r\n", "partial", "line split over reads not run once");
+    check(b.core.enabled(1) && b.core.speed(1) == 40 && b.core.cw(1), "partial", "motor 1 not started");
+    check(b.send("@7 STAT").empty() && b.send("US\r\n") == "@7 STATUS OK\r\n", "partial", "tagged line split over reads");
+}
+
+void overlongLines(){
+    Board b;
+    check(b.send(std::string(MotorCore::RX_MAX, 'M') + "\n") == "ERR BADFMT\r\n", "overlong", "RX_MAX bytes not handled as a line");
+    check(b.send(std::string(MotorCore::RX_MAX + 30, 'M') + "\n") == "ERR BADFMT\r\n", "overlong", "over-long line not rejected");
+    check(b.send("@9 " + std::string(120, 'x') + "\n") == "ERR BADFMT\r\n", "overlong", "over-long tagged line echoed its tag");
+    check(b.send("M2:START:10:CW\n") == "OK\r\n", "overlong", "next line lost after an over-long one");
+    check(b.core.enabled(2), "overlong", "motor 2 not started");
+}
+
+void asciiErrors(){
+    Board b;
+    struct { const char *in, *want; } cases[] = {
+        {"FOO\n", "ERR BADFMT\r\n"},
+        {"@5\n", "ERR BADFMT\r\n"},
+        {"B:1S40C;x\n", "ERR BADFMT\r\n"},
+        {"M0:STOP\n", "ERR ID\r\n"},
+        {"M10:START:5:CW\n", "ERR ID\r\n"},
+        {"B:1X;12X\n", "ERR ID\r\n"},
+        {"M1:START:5\n", "ERR ARGS\r\n"},
+        {"B:\n", "ERR ARGS\r\n"},
+        {"B:1S;\n", "ERR ARGS\r\n"},
+        {"AT x M1:STOP\n", "ERR ARGS\r\n"},
+        {"AT 90000000 M1:STOP\n", "ERR ARGS\r\n"},   // beyond SCHED_HORIZON_US
+        {"BAUD 1234\n", "ERR ARGS\r\n"},
+        {"M1:FOO:1:CW\n", "ERR CMD\r\n"},
+        {"B:1Q\n", "ERR CMD\r\n"},
+        {"AT 10000100 STATUS\n", "ERR CMD\r\n"},
+        {"B:1X;2X;3X;4X;5X;6X;7X;8X;9X;1X;2X;3X;4X;5X;6X;7X;8X\n", "ERR BATCH\r\n"},
+        {"@3 M0:STOP\n", "@3 ERR ID\r\n"},
+    };
+    for (const auto &c : cases){
+        std::string got = b.send(c.in);
+        if (got != c.want) std::fprintf(stderr, "  %s-> %s", c.in, got.c_str());
+        check(got == c.want, "ascii errors", "wrong reply");
+    }
+    check(b.idle() && b.core.scheduled() == 0, "ascii errors", "a rejected command changed something");
+}
+
+void batchAllOrNothing(){
+    Board b;
+    check(b.send("B:1S40C;2S50A;12X\n") == "ERR ID\r\n", "batch", "bad id not rejected");
+    check(b.send("B:1S40C;2S50A;3Q\n") == "ERR CMD\r\n", "batch", "bad op not rejected");
+    check(b.send("B:1S40C;2S50A;3S\n") == "ERR ARGS\r\n", "batch", "missing speed not rejected");
+    check(b.idle(), "batch", "items before the bad one were applied");
+    check(b.send("B:1S40C;2S50A;3X\n") == "OK B3\r\n", "batch", "valid batch not acked");
+    check(b.core.speed(1) == 40 && b.core.speed(2) == 50 && !b.core.cw(2) && b.core.enabled(2), "batch", "valid batch not applied");
+}
+
+void atQueueFull(){
+    Board b;
+    // Nine held, eight more do not fit, seven fill it to SCHED_MAX
+    check(b.send("AT 11000000 B:1S1C;2S2C;3S3C;4S4C;5S5C;6S6C;7S7C;8S8C;9S9C\n") == "OK AT 1000000\r\n", "at", "batch not held");
+    check(b.send("@1 AT 12000000 B:1X;2X;3X;4X;5X;6X;7X;8X\n") == "@1 ERR FULL\r\n", "at", "overflowing batch not refused");
+    check(b.core.scheduled() == 9, "at", "refused batch was partly queued");
+    check(b.send("AT 12000000 B:1X;2X;3X;4X;5X;6X;7X\n") == "OK AT 2000000\r\n", "at", "fitting batch not held");
+    check(b.core.scheduled() == MotorCore::SCHED_MAX, "at", "queue not full");
+    check(b.send("AT 10500000 M9:STOP\n") == "ERR FULL\r\n", "at", "single command into a full queue not refused");
+    check(b.idle(), "at", "held commands ran early");
+
+    hostClockSet(kClock + 1000000ull);
+    b.send("");
+    check(b.core.scheduled() == 7 && b.core.enabled(9) && b.core.speed(9) == 9, "at", "first batch did not run on time");
+    hostClockSet(kClock + 2000000ull);
+    b.send("");
+    check(b.core.scheduled() == 0 && b.core.enabled(8) && !b.core.enabled(1), "at", "second batch did not run on time");
+}
+
+void wireErrors(){
+    Board b;
+    check(b.send(std::string("\0HELLO 1\n\0", 10)) == "HELLO 1 OK\r\n", "wire", "no binary handshake");
+
+    std::string bad = frame({1, WOP_START, 1, 40});
+    bad[2] ^= 0x10;
+    check(wireStatus(b.send(bad)) == WST_CRC, "wire", "corrupt frame not WST_CRC");
+    check(wireStatus(b.send(frame({2, WOP_START, 0, 40}))) == WST_ID, "wire", "id 0 not WST_ID");
+    check(wireStatus(b.send(frame({3, 0x33, 1, 40}))) == WST_CMD, "wire", "unknown op not WST_CMD");
+    check(wireStatus(b.send(frame({4, WOP_START, 1, 40, 0}))) == WST_ARGS, "wire", "long command not WST_ARGS");
+    check(wireStatus(b.send(frame({5, WOP_BATCH, 2, 0, 1, WOP_START, 30}))) == WST_BATCH, "wire", "short batch not WST_BATCH");
+    check(wireStatus(b.send(frame({6, WOP_BATCH, 2, 0, 1, WOP_START, 30, 11, WOP_STOP, 0}))) == WST_ID, "wire", "batch bad id not WST_ID");
+    check(b.idle(), "wire", "rejected frame changed a motor");
+
+    // Sixteen items held for 11 s (0x00A7D8C0), then one too many
+    std::string at = frame({7, WOP_AT, 16, 0, 0xC0, 0xD8, 0xA7, 0x00,
+                            1, WOP_START, 1, 2, WOP_START, 2, 3, WOP_START, 3, 4, WOP_START, 4,
+                            5, WOP_START, 5, 6, WOP_START, 6, 7, WOP_START, 7, 8, WOP_START, 8,
+                            9, WOP_START, 9, 1, WOP_STOP, 0, 2, WOP_STOP, 0, 3, WOP_STOP, 0,
+                            4, WOP_STOP, 0, 5, WOP_STOP, 0, 6, WOP_STOP, 0, 7, WOP_STOP, 0});
+    check(wireStatus(b.send(at)) == WST_OK && b.core.scheduled() == 16, "wire", "AT frame not held");
+    check(wireStatus(b.send(frame({8, WOP_AT, 1, 0, 0xC0, 0xD8, 0xA7, 0x00, 9, WOP_STOP, 0}))) == WST_FULL, "wire", "full queue not WST_FULL");
+    check(wireStatus(b.send(frame({9, WOP_START, 1, 40}))) == WST_OK && b.core.enabled(1), "wire", "valid frame not applied");
+}
+
+}
+
+int main(){
+    partialLines();
+    overlongLines();
+    asciiErrors();
+    batchAllOrNothing();
+    atQueueFull();
+    wireErrors();
+    if (failures) { std::fprintf(stderr, "%d check(s) failed\n", failures); return 1; }
+    std::printf("motorcore_test: all checks passed\n");
+    return 0;
+}
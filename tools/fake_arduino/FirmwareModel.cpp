@@ -0,0 +1,398 @@
+#include "FirmwareModel.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "WireProtocol.h"
+
+namespace {
+
+// Arduino String::toInt(): leading sign and digits, 0 if none.
+long toInt(const std::string &s){
+    return std::strtol(s.c_str(), nullptr, 10);
+}
+
+std::string trim(const std::string &s){
+    size_t b = s.find_first_not_of(" \t\r\n\v\f");
+    if (b == std::string::npos) return std::string();
+    size_t e = s.find_last_not_of(" \t\r\n\v\f");
+    return s.substr(b, e - b + 1);
+}
+
+// MotorCore's parseUlong(): digits, no 32-bit overflow.
+bool parseUlong(const std::string &s, size_t &p, uint32_t &v){
+    if (p >= s.size() || s[p] < '0' || s[p] > '9') return false;
+    uint64_t x = 0;
+    while (p < s.size() && s[p] >= '0' && s[p] <= '9'){
+        x = x * 10 + (uint64_t)(s[p++] - '0');
+        if (x > 0xFFFFFFFFull) return false;
+    }
+    v = (uint32_t)x;
+    return true;
+}
+
+// MotorCore's baudRates[]
+const uint32_t kBaudRates[] = {115200, 250000, 500000, 1000000, 2000000};
+
+}
+
+std::string FirmwareModel::reset(){
+    motors_ = {};
+    binary_ = false;
+    baud_ = baudOk_ = kBaudDefault;
+    baudPending_ = false;
+    sched_.clear();
+    tag_.clear();
+    timed_ = false;
+    rxLen_ = 0;
+    rxOverflow_ = false;
+    return "READY\r\n";
+}
+
+void FirmwareModel::start(int id, uint8_t sp, bool cw){
+    if (id < 1 || id > 9) return;
+    motors_[id].speed = sp; motors_[id].enabled = true; motors_[id].cw = cw;
+}
+
+void FirmwareModel::stop(int id){
+    if (id < 1 || id > 9) return;
+    motors_[id].enabled = false;
+}
+
+void FirmwareModel::set(int id, uint8_t sp, bool cw){
+    if (id < 1 || id > 9) return;
+    motors_[id].speed = sp; motors_[id].cw = cw;
+}
+
+// Serial.println: the tag (if any), the message, CR LF.
+void FirmwareModel::reply(const std::string &msg, std::string &out){
+    if (!tag_.empty()) { out += tag_; out += ' '; }
+    out += msg;
+    out += "\r\n";
+    ++replies_;
+    if (msg.rfind("ERR", 0) == 0) ++errors_;
+}
+
+void FirmwareModel::wireReply(uint8_t seq, uint8_t status, uint8_t arg, std::string &out){
+    WireReply r = {seq, status, arg};
+    uint8_t enc[WIRE_MAX_ENCODED];
+    size_t len = wireEncodeFrame((const uint8_t *)&r, sizeof(r), enc);
+    out.append((const char *)enc, len);
+    ++replies_;
+    if (status != WST_OK) ++errors_;
+}
+
+void FirmwareModel::wireState(uint8_t seq, std::string &out){
+    uint8_t p[sizeof(WireReply) + 9 * sizeof(WireMotorState)];
+    WireReply r = {seq, WST_OK, 9};
+    std::memcpy(p, &r, sizeof(r));
+    for (int id = 1; id <= 9; ++id){
+        WireMotorState m;
+        m.speed = motors_[id].speed;
+        m.flags = (uint8_t)((motors_[id].cw ? 0 : WMS_CCW) | (motors_[id].enabled ? WMS_ENABLED : 0));
+        std::memcpy(p + sizeof(r) + (id - 1) * sizeof(m), &m, sizeof(m));
+    }
+    uint8_t enc[WIRE_MAX_ENCODED];
+    size_t len = wireEncodeFrame(p, sizeof(p), enc);
+    out.append((const char *)enc, len);
+    ++replies_;
+}
+
+void FirmwareModel::applyBatch(const BatchItem *items, uint8_t n){
+    for (uint8_t i = 0; i < n; ++i){
+        const BatchItem &it = items[i];
+        if (it.op == 'S') start(it.id, it.sp, it.cw);
+        else if (it.op == 'U') set(it.id, it.sp, it.cw);
+        else stop(it.id);
+    }
+}
+
+void FirmwareModel::wireValue(uint8_t seq, uint8_t arg, uint32_t v, std::string &out){
+    uint8_t p[sizeof(WireReply) + sizeof(v)];
+    WireReply r = {seq, WST_OK, arg};
+    std::memcpy(p, &r, sizeof(r));
+    std::memcpy(p + sizeof(r), &v, sizeof(v));
+    uint8_t enc[WIRE_MAX_ENCODED];
+    size_t len = wireEncodeFrame(p, sizeof(p), enc);
+    out.append((const char *)enc, len);
+    ++replies_;
+}
+
+// An immediate command drops what is held for its motors.
+void FirmwareModel::applyNow(const BatchItem *items, uint8_t n){
+    sched_.erase(std::remove_if(sched_.begin(), sched_.end(), [&](const Timed &t){
+        for (uint8_t i = 0; i < n; ++i) if (t.item.id == items[i].id) return true;
+        return false;
+    }), sched_.end());
+    applyBatch(items, n);
+}
+
+bool FirmwareModel::schedule(const BatchItem *items, uint8_t n, uint32_t at, int32_t &lead){
+    if (sched_.size() + n > kSchedMax) return false;
+    lead = (int32_t)(at - clock_);
+    size_t pos = sched_.size();
+    while (pos > 0 && (int32_t)(sched_[pos - 1].at - clock_) > lead) --pos;
+    std::vector<Timed> add;
+    for (uint8_t i = 0; i < n; ++i) add.push_back(Timed{at, items[i]});
+    sched_.insert(sched_.begin() + (long)pos, add.begin(), add.end());
+    if (lead <= 0) runDue();
+    return true;
+}
+
+int FirmwareModel::runDue(){
+    size_t k = 0;
+    while (k < sched_.size() && (int32_t)(sched_[k].at - clock_) <= 0) ++k;
+    if (k == 0) return 0;
+    std::vector<BatchItem> items;
+    for (size_t i = 0; i < k; ++i) items.push_back(sched_[i].item);
+    sched_.erase(sched_.begin(), sched_.begin() + (long)k);
+    applyBatch(items.data(), (uint8_t)items.size());
+    return (int)k;
+}
+
+int64_t FirmwareModel::nextDueUs() const {
+    if (sched_.empty()) return -1;
+    int32_t lead = (int32_t)(sched_.front().at - clock_);
+    return lead < 0 ? 0 : lead;
+}
+
+void FirmwareModel::runLine(const BatchItem *items, uint8_t n, const std::string &ok, std::string &out){
+    if (!timed_) { applyNow(items, n); reply(ok, out); return; }
+    int32_t lead;
+    if (!schedule(items, n, at_, lead)) { reply("ERR FULL", out); return; }
+    reply("OK AT " + std::to_string(lead), out);
+}
+
+void FirmwareModel::handleBatch(const char *p, std::string &out){
+    BatchItem items[WIRE_MAX_ITEMS];
+    uint8_t n = 0;
+    while (*p){
+        if (n == WIRE_MAX_ITEMS) { reply("ERR BATCH", out); return; }
+        BatchItem &it = items[n];
+        unsigned id = 0;
+        if (*p < '0' || *p > '9') { reply("ERR BADFMT", out); return; }
+        while (*p >= '0' && *p <= '9' && id < 100) id = id * 10 + (unsigned)(*p++ - '0');
+        if (id < 1 || id > 9) { reply("ERR ID", out); return; }
+        it.id = (uint8_t)id;
+        it.op = *p++;
+        it.sp = 0;
+        it.cw = true;
+        if (it.op == 'S' || it.op == 'U'){
+            unsigned sp = 0; bool digits = false;
+            while (*p >= '0' && *p <= '9') { if (sp < 1000) sp = sp * 10 + (unsigned)(*p - '0'); ++p; digits = true; }
+            if (!digits || (*p != 'C' && *p != 'A')) { reply("ERR ARGS", out); return; }
+            it.sp = (uint8_t)(sp > 100 ? 100 : sp);
+            it.cw = (*p++ == 'C');
+        } else if (it.op != 'X') {
+            reply("ERR CMD", out); return;
+        }
+        ++n;
+        if (*p == ';') ++p;
+        else if (*p) { reply("ERR BADFMT", out); return; }
+    }
+    if (n == 0) { reply("ERR ARGS", out); return; }
+    runLine(items, n, "OK B" + std::to_string(n), out);
+}
+
+bool FirmwareModel::handleBaud(const std::string &line, std::string &out){
+    if (line.compare(0, 4, "BAUD") != 0) return false;
+    if (line == "BAUD?"){
+        std::string msg = "BAUDS ";
+        for (uint32_t r : kBaudRates){
+            if (r != kBaudRates[0]) msg += ',';
+            msg += std::to_string(r);
+        }
+        reply(msg, out);
+        return true;
+    }
+    if (line.size() < 6 || line[4] != ' ' || line[5] < '0' || line[5] > '9') return false;
+    char *end;
+    unsigned long rate = std::strtoul(line.c_str() + 5, &end, 10);
+    if (*end) return false;
+    bool known = false;
+    for (uint32_t r : kBaudRates) known |= r == rate;
+    if (!known) { reply("ERR ARGS", out); return true; }
+    reply("BAUD " + std::to_string(rate) + " OK", out);
+    if (!baudPending_) baudOk_ = baud_;
+    baudPending_ = true;
+    baud_ = (uint32_t)rate;
+    return true;
+}
+
+void FirmwareModel::handleLine(std::string line, std::string &out){
+    line = trim(line);
+    if (line.empty()) return;
+    ++commands_;
+    timed_ = false;
+
+    if (line == "HELLO 1" || line == "HELLO 0"){
+        binary_ = line[6] == '1';
+        if (baudPending_) { baudPending_ = false; baudOk_ = baud_; }
+        out += line + " OK\r\n";
+        ++replies_;
+        return;
+    }
+
+    tag_.clear();
+    if (handleBaud(line, out)) return;
+
+    if (line[0] == '@'){
+        size_t sp = line.find(' ');
+        if (sp == std::string::npos) { reply("ERR BADFMT", out); return; }
+        tag_ = line.substr(0, sp);
+        line = line.substr(sp + 1);
+    }
+
+    if (line == "TIME") { reply("TIME " + std::to_string(clock_), out); return; }
+    if (line.compare(0, 3, "AT ") == 0){
+        size_t p = 3;
+        if (!parseUlong(line, p, at_) || p >= line.size() || line[p] != ' ') { reply("ERR ARGS", out); return; }
+        while (p < line.size() && line[p] == ' ') ++p;
+        int32_t lead = (int32_t)(at_ - clock_);
+        if (lead > kSchedHorizonUs || lead < -kSchedHorizonUs) { reply("ERR ARGS", out); return; }
+        line = line.substr(p);
+        if (line.empty() || (line[0] != 'M' && line.compare(0, 2, "B:") != 0)) { reply("ERR CMD", out); return; }
+        timed_ = true;
+    }
+
+    if (line == "STATUS") { reply("STATUS OK", out); return; }
+    if (line == "STATE"){
+        std::string msg = "STATE ";
+        for (int id = 1; id <= 9; ++id){
+            if (id > 1) msg += ',';
+            msg += std::to_string(motors_[id].speed);
+            msg += motors_[id].cw ? 'C' : 'A';
+            msg += motors_[id].enabled ? '1' : '0';
+        }
+        reply(msg, out);
+        return;
+    }
+    if (line.rfind("B:", 0) == 0) { handleBatch(line.c_str() + 2, out); return; }
+
+    size_t pColon = line.find(':');
+    if (line[0] != 'M' || pColon == std::string::npos) { reply("ERR BADFMT", out); return; }
+    long id = toInt(line.substr(1, pColon - 1));
+    if (id < 1 || id > 9) { reply("ERR ID", out); return; }
+
+    std::string rest = line.substr(pColon + 1);
+    size_t p2 = rest.find(':');
+    std::string cmd = p2 != std::string::npos ? rest.substr(0, p2) : rest;
+    if (cmd == "STOP") { BatchItem it{(uint8_t)id, 'X', 0, true}; runLine(&it, 1, "OK", out); return; }
+    if (p2 == std::string::npos) { reply("ERR ARGS", out); return; }
+
+    std::string rest2 = rest.substr(p2 + 1);
+    size_t p3 = rest2.find(':');
+    if (p3 == std::string::npos) { reply("ERR ARGS", out); return; }
+    long sp = toInt(rest2.substr(0, p3));
+    if (sp < 0) sp = 0;
+    if (sp > 100) sp = 100;
+    bool cw = rest2.substr(p3 + 1) == "CW";   // anything else is CCW, as on the board
+
+    BatchItem it{(uint8_t)id, 0, (uint8_t)sp, cw};
+    if (cmd == "START") it.op = 'S';
+    else if (cmd == "SET") it.op = 'U';
+    else { reply("ERR CMD", out); return; }
+    runLine(&it, 1, "OK", out);
+}
+
+void FirmwareModel::handleFrame(const uint8_t *frame, size_t len, std::string &out){
+    uint8_t p[WIRE_MAX_PAYLOAD];
+    size_t n = wireDecodeFrame(frame, len, p, sizeof(p));
+    if (n < sizeof(WireCmd)){
+        // The handshake is framed by 0x00 on both sides so it is seen here in binary mode.
+        if (len >= 7 && std::memcmp(frame, "HELLO ", 6) == 0) handleLine(std::string((const char *)frame, 7), out);
+        else if (len >= 5 && len < 16 && std::memcmp(frame, "BAUD", 4) == 0){
+            ++commands_;
+            tag_.clear();
+            if (!handleBaud(trim(std::string((const char *)frame, len)), out) && binary_) wireReply(0, WST_CRC, 0, out);
+        }
+        else if (binary_) { ++commands_; wireReply(0, WST_CRC, 0, out); }
+        return;
+    }
+    ++commands_;
+
+    WireCmd cmd;
+    std::memcpy(&cmd, p, sizeof(cmd));
+    uint8_t op = cmd.op & (uint8_t)~WOP_CCW;
+    bool cw = !(cmd.op & WOP_CCW);
+    uint8_t sp = cmd.speed > 100 ? 100 : cmd.speed;
+
+    if (op == WOP_STATUS) { wireReply(cmd.seq, WST_OK, 0, out); return; }
+    if (op == WOP_STATE) { wireState(cmd.seq, out); return; }
+    if (op == WOP_TIME) { wireValue(cmd.seq, 0, clock_, out); return; }
+    if (op == WOP_BATCH || op == WOP_AT){
+        uint8_t count = cmd.id;
+        size_t head = sizeof(WireCmd) + (op == WOP_AT ? sizeof(uint32_t) : 0);
+        if (count == 0 || count > WIRE_MAX_ITEMS || n != head + count * sizeof(WireItem)){
+            wireReply(cmd.seq, WST_BATCH, 0, out); return;
+        }
+        BatchItem items[WIRE_MAX_ITEMS];
+        for (uint8_t i = 0; i < count; ++i){
+            WireItem w;
+            std::memcpy(&w, p + head + i * sizeof(WireItem), sizeof(w));
+            uint8_t wop = w.op & (uint8_t)~WOP_CCW;
+            if (w.id < 1 || w.id > 9) { wireReply(cmd.seq, WST_ID, i, out); return; }
+            if (wop != WOP_START && wop != WOP_SET && wop != WOP_STOP) { wireReply(cmd.seq, WST_CMD, i, out); return; }
+            items[i].id = w.id;
+            items[i].op = wop == WOP_START ? 'S' : wop == WOP_SET ? 'U' : 'X';
+            items[i].sp = w.speed > 100 ? 100 : w.speed;
+            items[i].cw = !(w.op & WOP_CCW);
+        }
+        if (op == WOP_BATCH) { applyNow(items, count); wireReply(cmd.seq, WST_OK, count, out); return; }
+        uint32_t at;
+        std::memcpy(&at, p + sizeof(WireCmd), sizeof(at));
+        int32_t lead = (int32_t)(at - clock_);
+        if (lead > kSchedHorizonUs || lead < -kSchedHorizonUs) { wireReply(cmd.seq, WST_ARGS, 0, out); return; }
+        if (!schedule(items, count, at, lead)) { wireReply(cmd.seq, WST_FULL, 0, out); return; }
+        wireValue(cmd.seq, count, (uint32_t)lead, out);
+        return;
+    }
+    if (n != sizeof(WireCmd)) { wireReply(cmd.seq, WST_ARGS, 0, out); return; }
+    if (cmd.id < 1 || cmd.id > 9) { wireReply(cmd.seq, WST_ID, 0, out); return; }
+    BatchItem it{cmd.id, 0, sp, cw};
+    if (op == WOP_START) it.op = 'S';
+    else if (op == WOP_SET) it.op = 'U';
+    else if (op == WOP_STOP) it.op = 'X';
+    else { wireReply(cmd.seq, WST_CMD, 0, out); return; }
+    applyNow(&it, 1);
+    wireReply(cmd.seq, WST_OK, 0, out);
+}
+
+// Same receive loop as the sketch: '\n' ends a line in ASCII mode, 0x00 ends
+// whatever was collected in either mode.
+int FirmwareModel::feed(const uint8_t *data, size_t n, std::string &out){
+    replies_ = 0;
+    for (size_t i = 0; i < n; ++i){
+        uint8_t c = data[i];
+        if (c == 0){
+            if (rxLen_ > 0 && !rxOverflow_) handleFrame(rx_, rxLen_, out);
+            rxLen_ = 0; rxOverflow_ = false;
+            continue;
+        }
+        if (c == '\n' && !binary_){
+            if (rxOverflow_) { out += "ERR BADFMT\r\n"; ++replies_; ++errors_; }
+            else handleLine(std::string((const char *)rx_, rxLen_), out);
+            rxLen_ = 0; rxOverflow_ = false;
+            continue;
+        }
+        if (rxLen_ < kRxMax) rx_[rxLen_++] = c;
+        else rxOverflow_ = true;
+    }
+    return replies_;
+}
+
+std::string FirmwareModel::stateJson() const {
+    std::string s = std::string("{\"binary\":") + (binary_ ? "true" : "false")
+                  + ",\"baud\":" + std::to_string(baud_)
+                  + ",\"clock\":" + std::to_string(clock_)
+                  + ",\"scheduled\":" + std::to_string(sched_.size())
+                  + ",\"commands\":" + std::to_string(commands_)
+                  + ",\"errors\":" + std::to_string(errors_) + ",\"motors\":[";
+    for (int id = 1; id <= 9; ++id){
+        const Motor &m = motors_[id];
+        if (id > 1) s += ",";
+        s += "{\"id\":" + std::to_string(id) + ",\"speed\":" + std::to_string(m.speed)
+           + ",\"dir\":\"" + (m.cw ? "CW" : "CCW") + "\",\"enabled\":" + (m.enabled ? "true" : "false") + "}";
+    }
+    return s + "]}";
+}
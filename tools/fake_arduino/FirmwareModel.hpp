@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Host-side model of firmware/MotorControlNine: the same receive buffer,
+// ASCII commands ("@<seq>" tags, STATUS, STATE, M<id>:..., B:...), HELLO
+// handshake, BAUD negotiation, TIME and held AT commands and binary COBS/CRC
+// frames (WireProtocol.h), with the same replies and ERR codes. Pure and
+// deterministic: bytes in, bytes out; the caller keeps the board clock
+// (setClock()), runs held commands (runDue()) and the BAUD confirmation
+// timer (revertBaud()).
+class FirmwareModel {
+public:
+    struct Motor {
+        uint8_t speed = 0;
+        bool cw = true;
+        bool enabled = false;
+    };
+
+    // Power-on state; returns the boot banner ("READY\r\n").
+    std::string reset();
+
+    // Feeds bytes from the host; each complete command appends one reply to `out`.
+    // Returns how many replies were produced.
+    int feed(const uint8_t *data, size_t n, std::string &out);
+
+    const Motor &motor(int id) const { return motors_[id]; }   // 1..9
+    bool binaryMode() const { return binary_; }
+    uint32_t baud() const { return baud_; }
+    // A BAUD switch waiting for its HELLO at the new rate.
+    bool baudPending() const { return baudPending_; }
+    // The confirmation window ran out: back to the last confirmed rate.
+    void revertBaud() { if (baudPending_) { baudPending_ = false; baud_ = baudOk_; } }
+    // Board micros(), for TIME and AT.
+    void setClock(uint32_t us) { clock_ = us; }
+    uint32_t clock() const { return clock_; }
+    // Applies the held items that are due at the clock; returns how many.
+    int runDue();
+    // Microseconds until the next held item, -1 if none.
+    int64_t nextDueUs() const;
+    size_t scheduled() const { return sched_.size(); }
+    uint64_t commands() const { return commands_; }
+    uint64_t errors() const { return errors_; }
+
+    static constexpr uint32_t kBaudDefault = 115200;
+    static constexpr size_t kSchedMax = 16;              // MotorCore::SCHED_MAX
+    static constexpr int32_t kSchedHorizonUs = 60000000; // MotorCore::SCHED_HORIZON_US
+
+    // {"binary":..,"baud":..,"clock":..,"scheduled":..,"commands":..,"errors":..,
+    //  "motors":[{"id":1,"speed":..,"dir":"CW","enabled":..},..]}
+    std::string stateJson() const;
+
+private:
+    struct BatchItem { uint8_t id; char op; uint8_t sp; bool cw; };
+
+    void handleLine(std::string line, std::string &out);
+    bool handleBaud(const std::string &line, std::string &out);
+    void handleFrame(const uint8_t *frame, size_t len, std::string &out);
+    void handleBatch(const char *p, std::string &out);
+    void applyBatch(const BatchItem *items, uint8_t n);
+    void applyNow(const BatchItem *items, uint8_t n);
+    bool schedule(const BatchItem *items, uint8_t n, uint32_t at, int32_t &lead);
+    void runLine(const BatchItem *items, uint8_t n, const std::string &ok, std::string &out);
+    void reply(const std::string &msg, std::string &out);
+    void wireReply(uint8_t seq, uint8_t status, uint8_t arg, std::string &out);
+    void wireState(uint8_t seq, std::string &out);
+    void wireValue(uint8_t seq, uint8_t arg, uint32_t v, std::string &out);
+    void start(int id, uint8_t sp, bool cw);
+    void stop(int id);
+    void set(int id, uint8_t sp, bool cw);
+
+    static constexpr size_t kRxMax = 96;
+
+    std::array<Motor, 10> motors_{};
+    bool binary_ = false;
+    uint32_t baud_ = kBaudDefault, baudOk_ = kBaudDefault;
+    bool baudPending_ = false;
+    uint32_t clock_ = 0;
+    struct Timed { uint32_t at; BatchItem item; };
+    std::vector<Timed> sched_;      // by time, same time in arrival order
+    std::string tag_;
+    bool timed_ = false;
+    uint32_t at_ = 0;
+    uint8_t rx_[kRxMax + 1] = {};
+    size_t rxLen_ = 0;
+    bool rxOverflow_ = false;
+    uint64_t commands_ = 0, errors_ = 0;
+    int replies_ = 0;
+};
@@ -0,0 +1,313 @@
+// fake_arduino: MotorControlNine on a pseudo-terminal, for running the
+// backend without hardware.
+//
+//   ./build/fake_arduino --link /tmp/arduino --latency-ms 2 --jitter-ms 1 &
+//   SERIAL_PORT=/tmp/arduino ./build/one_motor
+//
+// The slave path is printed on stdout. Opening it "resets" the board like the
+// Leonardo's DTR reset: motors off, ASCII mode, READY after --boot-ms.
+// Replies leave after --latency-ms +/- --jitter-ms (never reordered) and go
+// out in USB full-speed CDC packets: at most --usb-packet bytes per
+// --usb-frame-us. --drop loses a reply after the command was applied;
+// --corrupt flips one bit in a reply byte with the given probability. READY
+// and the HELLO handshake are never faulted.
+// The board's line rate follows BAUD (see MotorCore.h); bytes cross only
+// when the host's termios rate matches it and it is at most --max-baud,
+// otherwise each one arrives as noise, like a UART sampling at the wrong
+// speed. --uart paces replies at that rate (a USB-serial bridge) instead of
+// in CDC packets.
+// The board clock (TIME, AT) restarts at --clock-start on every reset and
+// runs --clock-ppm fast (negative: slow), like a resonator off its nominal
+// frequency; held commands run from the main loop when it gets there.
+// SIGUSR1 prints the motor table; --state-file keeps it on disk after every
+// command, for assertions from scripts.
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>   // termios2: the host's rate, BOTHER included
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include "FirmwareModel.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    double latencyMs = 2.0;
+    double jitterMs = 0.0;
+    double drop = 0.0;
+    double corrupt = 0.0;
+    size_t usbPacket = 64;
+    int usbFrameUs = 1000;
+    int bootMs = 50;
+    long maxBaud = 0;   // 0: any rate gets through
+    double clockPpm = 0.0;
+    uint32_t clockStart = 0;
+    bool uart = false;
+    unsigned seed = 1;
+    std::string link;
+    std::string stateFile;
+};
+
+volatile std::sig_atomic_t gStop = 0, gDump = 0;
+
+void usage(const char *argv0){
+    std::fprintf(stderr,
+        "usage: %s [--latency-ms F] [--jitter-ms F] [--drop P] [--corrupt P]\n"
+        "          [--usb-packet N] [--usb-frame-us N] [--boot-ms N] [--seed N]\n"
+        "          [--max-baud N] [--uart] [--clock-ppm F] [--clock-start N]\n"
+        "          [--link PATH] [--state-file PATH]\n", argv0);
+}
+
+bool parseArgs(int argc, char **argv, Options &o){
+    for (int i = 1; i < argc; ++i){
+        std::string a = argv[i];
+        if (a == "--uart") { o.uart = true; continue; }
+        if (i + 1 >= argc) { usage(argv[0]); return false; }
+        const char *v = argv[++i];
+        if (a == "--latency-ms") o.latencyMs = std::atof(v);
+        else if (a == "--jitter-ms") o.jitterMs = std::atof(v);
+        else if (a == "--drop") o.drop = std::atof(v);
+        else if (a == "--corrupt") o.corrupt = std::atof(v);
+        else if (a == "--usb-packet") o.usbPacket = (size_t)std::max(1, std::atoi(v));
+        else if (a == "--usb-frame-us") o.usbFrameUs = std::max(0, std::atoi(v));
+        else if (a == "--boot-ms") o.bootMs = std::max(0, std::atoi(v));
+        else if (a == "--max-baud") o.maxBaud = std::max(0L, std::atol(v));
+        else if (a == "--clock-ppm") o.clockPpm = std::atof(v);
+        else if (a == "--clock-start") o.clockStart = (uint32_t)std::strtoul(v, nullptr, 10);
+        else if (a == "--seed") o.seed = (unsigned)std::strtoul(v, nullptr, 10);
+        else if (a == "--link") o.link = v;
+        else if (a == "--state-file") o.stateFile = v;
+        else { usage(argv[0]); return false; }
+    }
+    return true;
+}
+
+void writeStateFile(const std::string &path, const FirmwareModel &fw){
+    if (path.empty()) return;
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "w");
+    if (!f) return;
+    std::string s = fw.stateJson() + "\n";
+    std::fwrite(s.data(), 1, s.size(), f);
+    std::fclose(f);
+    std::rename(tmp.c_str(), path.c_str());   // readers never see a partial file
+}
+
+// Rate the host set on its end of the pty (shared with the master).
+long hostBaud(int fd){
+    termios2 tio{};
+    if (ioctl(fd, TCGETS2, &tio) < 0) return 0;
+    return (long)tio.c_ospeed;
+}
+
+class FakeLink {
+public:
+    FakeLink(int master, const Options &o): fd_(master), o_(o), rng_(o.seed) {}
+
+    // Board reset when the host opens the port.
+    void onOpen(Clock::time_point now){
+        pending_.clear(); tx_.clear();
+        lastDue_ = now;
+        boot_ = now;
+        std::string banner = fw_.reset();
+        schedule(banner, now + std::chrono::milliseconds(o_.bootMs), false, fw_.baud());
+        writeStateFile(o_.stateFile, fw_);
+    }
+
+    void onInput(Clock::time_point now){
+        uint8_t buf[512];
+        ssize_t n = ::read(fd_, buf, sizeof(buf));
+        if (n <= 0) return;
+        if (!carries(fw_.baud())) for (ssize_t i = 0; i < n; ++i) buf[i] = (uint8_t)rng_();
+        std::string out;
+        fw_.setClock(boardClock(now));
+        for (ssize_t i = 0; i < n; ++i){
+            out.clear();
+            uint32_t rate = fw_.baud();
+            bool pending = fw_.baudPending();
+            int replies = fw_.feed(buf + i, 1, out);
+            if (fw_.baud() != rate){
+                std::fprintf(stderr, "fake_arduino: line rate %u\n", fw_.baud());
+                if (!pending) baudDeadline_ = now + std::chrono::milliseconds(kBaudConfirmMs);
+            }
+            if (replies == 0) continue;
+            std::uniform_real_distribution<double> jitter(-o_.jitterMs, o_.jitterMs);
+            double ms = std::max(0.0, o_.latencyMs + (o_.jitterMs > 0 ? jitter(rng_) : 0.0));
+            bool handshake = out.rfind("HELLO ", 0) == 0;   // faults only hit command replies
+            schedule(out, now + std::chrono::microseconds((int64_t)(ms * 1000)), !handshake, rate);
+            writeStateFile(o_.stateFile, fw_);
+        }
+    }
+
+    // Runs held commands, moves due replies to the USB buffer and sends at
+    // most one packet per frame.
+    void pump(Clock::time_point now){
+        fw_.setClock(boardClock(now));
+        if (int ran = fw_.runDue()){
+            std::fprintf(stderr, "fake_arduino: %d held item(s) ran at board time %u\n", ran, fw_.clock());
+            writeStateFile(o_.stateFile, fw_);
+        }
+        if (fw_.baudPending() && now >= baudDeadline_){
+            fw_.revertBaud();   // no HELLO at the new rate in time
+            std::fprintf(stderr, "fake_arduino: line rate %u (not confirmed)\n", fw_.baud());
+        }
+        while (!pending_.empty() && pending_.front().due <= now){
+            Pending &p = pending_.front();
+            if (!carries(p.baud)) for (auto &c : p.bytes) c = (char)rng_();
+            tx_ += p.bytes;
+            pending_.pop_front();
+        }
+        while (!tx_.empty() && now >= nextPacket_){
+            size_t len = std::min(tx_.size(), o_.usbPacket);
+            if (o_.uart) len = std::min(tx_.size(), (size_t)std::max(1u, fw_.baud() / 10000));   // 1 ms at 10 bits a byte
+            ssize_t n = ::write(fd_, tx_.data(), len);
+            if (n <= 0) break;   // host not reading: keep the bytes
+            tx_.erase(0, (size_t)n);
+            if (o_.uart) { nextPacket_ = now + std::chrono::microseconds((int64_t)(n * 1e7 / fw_.baud())); break; }
+            nextPacket_ = now + std::chrono::microseconds(o_.usbFrameUs);
+            if (o_.usbFrameUs > 0) break;
+        }
+    }
+
+    // Microseconds until pump() has something to do, -1 if idle.
+    int64_t timeoutUs(Clock::time_point now) const {
+        Clock::time_point next = Clock::time_point::max();
+        if (!tx_.empty()) next = std::max(now, nextPacket_);
+        else if (!pending_.empty()) next = pending_.front().due;
+        int64_t held = fw_.nextDueUs();
+        if (held >= 0) next = std::min(next, now + std::chrono::microseconds((int64_t)(held / (1.0 + o_.clockPpm * 1e-6))));
+        if (next == Clock::time_point::max()) return -1;
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(next - now).count();
+        return us <= 0 ? 0 : us;
+    }
+
+    const FirmwareModel &firmware() const { return fw_; }
+    uint64_t dropped() const { return dropped_; }
+    uint64_t corrupted() const { return corrupted_; }
+
+private:
+    struct Pending {
+        Clock::time_point due;
+        std::string bytes;
+        uint32_t baud;      // the board's rate when it sent them
+    };
+
+    static constexpr int kBaudConfirmMs = 1000;   // MotorCore::BAUD_CONFIRM_MS
+
+    // micros() on the board
+    uint32_t boardClock(Clock::time_point now) const {
+        double us = (double)std::chrono::duration_cast<std::chrono::microseconds>(now - boot_).count();
+        return o_.clockStart + (uint32_t)(uint64_t)(us * (1.0 + o_.clockPpm * 1e-6));
+    }
+
+    // Bytes at the board's `baud` arrive intact.
+    bool carries(uint32_t baud) const {
+        return hostBaud(fd_) == (long)baud && (o_.maxBaud == 0 || (long)baud <= o_.maxBaud);
+    }
+
+    void schedule(std::string bytes, Clock::time_point due, bool faults, uint32_t baud){
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        if (faults && o_.drop > 0 && u(rng_) < o_.drop) { ++dropped_; return; }
+        if (faults && o_.corrupt > 0){
+            for (auto &c : bytes){
+                if (u(rng_) < o_.corrupt) { c = (char)(c ^ (1 << (rng_() % 8))); ++corrupted_; }
+            }
+        }
+        lastDue_ = std::max(lastDue_, due);   // the UART never reorders
+        pending_.push_back(Pending{lastDue_, std::move(bytes), baud});
+    }
+
+    int fd_;
+    const Options &o_;
+    std::mt19937 rng_;
+    FirmwareModel fw_;
+    std::deque<Pending> pending_;
+    std::string tx_;
+    Clock::time_point lastDue_{}, nextPacket_{}, baudDeadline_{}, boot_{};
+    uint64_t dropped_ = 0, corrupted_ = 0;
+};
+
+}
+
+int main(int argc, char **argv){
+    Options o;
+    if (!parseArgs(argc, argv, o)) return 1;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) { std::perror("posix_openpt"); return 2; }
+    std::string slave = ptsname(master);
+
+    // Raw mode on the slave side; closing it again lets us see the host's open as the end of POLLHUP.
+    int sfd = ::open(slave.c_str(), O_RDWR | O_NOCTTY);
+    if (sfd < 0) { std::perror("open slave"); return 2; }
+    termios2 tio{};
+    ioctl(sfd, TCGETS2, &tio);
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);   // cfmakeraw()
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag = (tio.c_cflag & ~(CSIZE | PARENB)) | CS8;
+    ioctl(sfd, TCSETS2, &tio);
+    ::close(sfd);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+
+    if (!o.link.empty()){
+        ::unlink(o.link.c_str());
+        if (::symlink(slave.c_str(), o.link.c_str()) < 0) { std::perror("symlink"); return 2; }
+    }
+    std::printf("%s\n", o.link.empty() ? slave.c_str() : o.link.c_str());
+    std::fflush(stdout);
+
+    struct sigaction sa{};
+    sa.sa_handler = [](int sig){ if (sig == SIGUSR1) gDump = 1; else gStop = 1; };
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    FakeLink link(master, o);
+    bool open = false;
+    while (!gStop){
+        auto now = Clock::now();
+        int64_t timeout = open ? link.timeoutUs(now) : 10000;
+        if (timeout < 0 || timeout > 100000) timeout = 100000;
+        timespec ts{(time_t)(timeout / 1000000), (long)(timeout % 1000000) * 1000};
+        pollfd pfd{master, POLLIN, 0};
+        int rv = ppoll(&pfd, 1, &ts, nullptr);
+        if (rv < 0 && errno != EINTR) { std::perror("poll"); break; }
+        now = Clock::now();
+
+        if (gDump) { gDump = 0; std::printf("%s\n", link.firmware().stateJson().c_str()); std::fflush(stdout); }
+        if (rv > 0 && (pfd.revents & POLLHUP)){
+            if (open) std::fprintf(stderr, "fake_arduino: host closed the port\n");
+            open = false;
+            usleep(10000);
+            continue;
+        }
+        if (!open){
+            open = true;
+            std::fprintf(stderr, "fake_arduino: host opened the port, READY in %d ms\n", o.bootMs);
+            link.onOpen(now);
+        }
+        if (rv > 0 && (pfd.revents & POLLIN)) link.onInput(now);
+        link.pump(now);
+    }
+
+    std::fprintf(stderr, "fake_arduino: %llu commands, %llu ERR, %llu replies dropped, %llu bytes corrupted\n",
+                 (unsigned long long)link.firmware().commands(), (unsigned long long)link.firmware().errors(),
+                 (unsigned long long)link.dropped(), (unsigned long long)link.corrupted());
+    std::printf("%s\n", link.firmware().stateJson().c_str());
+    if (!o.link.empty()) ::unlink(o.link.c_str());
+    ::close(master);
+    return 0;
+}
@@ -0,0 +1,251 @@
+// journal_replay: prints or replays a serial journal written by one_motor
+// (JOURNAL=<file>, see backend/Journal.hpp).
+//
+//   ./build/journal_replay --dump one_motor.journal
+//   ./build/journal_replay --port /tmp/arduino one_motor.journal            # original timing
+//   ./build/journal_replay --port /tmp/arduino --speed 4 one_motor.journal  # 4x faster
+//   ./build/journal_replay --port /tmp/arduino --fast one_motor.journal     # as fast as the link allows
+//
+// The i-th --port replays the commands journaled on pool port i; ports
+// without one are skipped. Commands are sent again as journaled (binary or
+// ASCII as negotiated now, local motor ids); raw text lines are not journaled
+// and are skipped. Held (AT) commands are held again, as far ahead of their
+// send as they originally ran (scaled by --speed, none with --fast), on the
+// replay board's clock; ones whose original lead is unknown are skipped and
+// counted. Prints a JSON report: replies, timeouts, replies whose
+// status differs from the original, and replay vs original ack latency.
+// --record keeps a journal of the replay itself for comparison. Exits with 3
+// if any command timed out or got a different status than originally.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Journal.hpp"
+#include "Log.hpp"
+#include "MotorController.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string journal;
+    std::vector<std::string> ports;
+    double speed = 1.0;
+    bool fast = false;
+    bool dump = false;
+    bool ascii = false;
+    bool verbose = false;
+    int baud = 115200;
+    int timeoutMs = 800;
+    size_t window = 256;        // commands submitted but not answered
+    std::string record;
+};
+
+// One journaled command and what happened to it originally.
+struct Item {
+    uint64_t tNs = 0;
+    uint8_t port = 0;
+    SerialCommand cmd;
+    int origStatus = -1;        // WireStatus, 0x100 = timed out, -1 = unknown (rotated out)
+    uint32_t origLatencyUs = 0;
+    int64_t heldUs = -1;        // timed: send to run on the board originally, -1 = unknown
+};
+
+constexpr int kTimedOut = 0x100;
+
+void usage(const char *argv0){
+    std::fprintf(stderr,
+        "usage: %s [--dump] [--port DEV]... [--speed F | --fast] [--ascii] [--baud N]\n"
+        "          [--timeout-ms N] [--window N] [--record PATH] [--verbose] JOURNAL\n", argv0);
+}
+
+bool parseArgs(int argc, char **argv, Options &o){
+    for (int i = 1; i < argc; ++i){
+        std::string a = argv[i];
+        if (a == "--dump") { o.dump = true; continue; }
+        if (a == "--fast") { o.fast = true; continue; }
+        if (a == "--ascii") { o.ascii = true; continue; }
+        if (a == "--verbose") { o.verbose = true; continue; }
+        if (a.rfind("--", 0) != 0) { o.journal = a; continue; }
+        if (i + 1 >= argc) { usage(argv[0]); return false; }
+        const char *v = argv[++i];
+        if (a == "--port") o.ports.push_back(v);
+        else if (a == "--speed") o.speed = std::atof(v);
+        else if (a == "--baud") o.baud = std::atoi(v);
+        else if (a == "--timeout-ms") o.timeoutMs = std::max(1, std::atoi(v));
+        else if (a == "--window") o.window = (size_t)std::max(1, std::atoi(v));
+        else if (a == "--record") o.record = v;
+        else { usage(argv[0]); return false; }
+    }
+    if (o.journal.empty() || o.speed <= 0 || (!o.dump && o.ports.empty()) || o.ports.size() > Journal::kMaxPorts) { usage(argv[0]); return false; }
+    return true;
+}
+
+void dump(const Journal &j, const std::vector<JournalRecord> &recs){
+    const JournalHeader &h = j.header();
+    std::printf("# %llu records appended, %llu slots, %zu readable\n",
+                (unsigned long long)h.head, (unsigned long long)h.capacity, recs.size());
+    for (uint32_t p = 0; p < h.nports && p < Journal::kMaxPorts; ++p)
+        std::printf("# port %u: %s @%u, motors %u-%u\n", p, h.ports[p].device, h.ports[p].baud,
+                    h.ports[p].firstId, h.ports[p].firstId + h.ports[p].count - 1);
+    for (const auto &r : recs){
+        int64_t realNs = h.startRealNs + ((int64_t)r.tNs - h.startMonoNs);
+        time_t secs = (time_t)(realNs / 1000000000);
+        struct tm tm;
+        gmtime_r(&secs, &tm);
+        char ts[32];
+        std::strftime(ts, sizeof(ts), "%H:%M:%S", &tm);
+        std::printf("%s.%06lldZ %s\n", ts, (long long)(realNs % 1000000000) / 1000, Journal::describe(r).c_str());
+    }
+}
+
+// Groups Out records back into commands and attaches each one's original outcome.
+std::vector<Item> collect(const std::vector<JournalRecord> &recs){
+    std::vector<Item> items;
+    std::unordered_map<uint32_t, std::vector<JournalRecord>> parts;    // (port, seq) -> Out records so far
+    std::unordered_map<uint32_t, size_t> open;                        // (port, seq) -> item awaiting its reply
+    for (const auto &r : recs){
+        uint32_t key = (uint32_t)r.port << 16 | r.seq;
+        if (r.dir == Journal::Out){
+            auto &v = parts[key];
+            if (r.part == 0) v.clear();
+            else if (v.size() != r.part) continue;    // head of this batch rotated out
+            v.push_back(r);
+            if (v.size() < std::max<size_t>(1, r.parts)) continue;
+            Item it;
+            if (Journal::toCommand(v.data(), v.size(), it.cmd)){
+                it.tNs = v.front().tNs;
+                it.port = r.port;
+                open[key] = items.size();
+                items.push_back(std::move(it));
+            }
+            parts.erase(key);
+            continue;
+        }
+        auto o = open.find(key);
+        if (o == open.end()) continue;
+        Item &it = items[o->second];
+        it.origStatus = r.dir == Journal::In ? r.op : kTimedOut;
+        it.origLatencyUs = r.latencyUs;
+        if (it.cmd.timed && r.dir == Journal::In && (r.flags & Journal::kTimed) && r.op == 0)
+            it.heldUs = std::max<int64_t>(0, (int64_t)(r.tNs - it.tNs) / 1000 + (int32_t)r.atUs);
+        open.erase(o);
+    }
+    return items;
+}
+
+std::string percentiles(std::vector<uint32_t> &v){
+    if (v.empty()) return "{}";
+    std::sort(v.begin(), v.end());
+    auto at = [&](double q){ return v[std::min(v.size() - 1, (size_t)(q * (double)v.size()))] / 1000.0; };
+    double sum = 0;
+    for (auto x : v) sum += x;
+    char s[256];
+    std::snprintf(s, sizeof(s), "{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"mean\":%.3f}",
+                  at(0.50), at(0.90), at(0.99), v.back() / 1000.0, sum / (double)v.size() / 1000.0);
+    return s;
+}
+
+}
+
+int main(int argc, char **argv){
+    Options o;
+    if (!parseArgs(argc, argv, o)) return 1;
+    logging::setLevel(o.verbose ? logging::Level::Info : logging::Level::Warn);
+    logging::start();
+    std::atexit([]{ logging::stop(); });
+
+    Journal in;
+    std::string err;
+    if (!in.openRead(o.journal, err)) { std::fprintf(stderr, "journal_replay: %s\n", err.c_str()); return 1; }
+    std::vector<JournalRecord> recs = in.records();
+    if (o.dump) { dump(in, recs); return 0; }
+
+    std::vector<Item> items = collect(recs);
+    size_t skipped = 0;
+    items.erase(std::remove_if(items.begin(), items.end(), [&](const Item &it){
+        bool drop = it.port >= o.ports.size();
+        skipped += drop;
+        return drop;
+    }), items.end());
+    if (items.empty()) { std::fprintf(stderr, "journal_replay: nothing to replay\n"); return 1; }
+
+    Journal rec;
+    if (!o.record.empty() && !rec.create(o.record, std::max<size_t>(recs.size() * 2, 4096))) return 1;
+    std::vector<std::unique_ptr<MotorController>> ctrls;
+    for (size_t p = 0; p < o.ports.size(); ++p){
+        const JournalPort &jp = in.header().ports[p];
+        ctrls.push_back(std::make_unique<MotorController>(std::max<int>(jp.count, 9)));
+        if (rec.isOpen()) {
+            rec.setPort(p, o.ports[p], o.baud, jp.firstId, jp.count);
+            ctrls[p]->setJournal(&rec, (uint8_t)p);
+        }
+        if (!ctrls[p]->connect(o.ports[p], o.baud, !o.ascii)) {
+            std::fprintf(stderr, "journal_replay: cannot open %s\n", o.ports[p].c_str());
+            return 1;
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t outstanding = 0, acked = 0, timeouts = 0, mismatched = 0, errors = 0, skippedTimed = 0;
+    std::vector<uint32_t> lat, origLat;
+    lat.reserve(items.size()); origLat.reserve(items.size());
+    for (const auto &it : items) if (it.origStatus >= 0 && it.origStatus != kTimedOut) origLat.push_back(it.origLatencyUs);
+
+    auto t0 = Clock::now();
+    uint64_t first = items.front().tNs;
+    for (const auto &it : items){
+        if (!o.fast) std::this_thread::sleep_until(t0 + std::chrono::nanoseconds((int64_t)((double)(it.tNs - first) / o.speed)));
+        SerialCommand cmd = it.cmd;
+        if (cmd.timed){
+            // The journaled board time means nothing to this board; keep the lead instead
+            int64_t ahead = o.fast ? 0 : (int64_t)((double)it.heldUs / o.speed);
+            uint32_t board;
+            if (it.heldUs < 0 || !ctrls[it.port]->boardTime(ClockSync::nowUs() + ahead, board)) { ++skippedTimed; continue; }
+            cmd = SerialCommand::at(board, cmd);
+        }
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            cv.wait(lk, [&]{ return outstanding < o.window; });
+            ++outstanding;
+        }
+        auto sent = Clock::now();
+        int orig = it.origStatus;
+        ctrls[it.port]->submit(cmd, o.timeoutMs, [&, sent, orig](const SerialReply &r){
+            uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent).count();
+            uint8_t arg;
+            int status = r.acked ? Journal::replyStatus(r.line, arg) : kTimedOut;
+            std::lock_guard<std::mutex> lk(mtx);
+            if (r.acked) { ++acked; lat.push_back(us); } else ++timeouts;
+            if (r.acked && status != 0) ++errors;
+            if (orig >= 0 && orig != status) ++mismatched;
+            --outstanding;
+            cv.notify_all();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&]{ return outstanding == 0; });
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+    double span = (double)(items.back().tNs - first) / 1e9;
+
+    std::printf("{\"commands\":%zu,\"skipped_ports\":%zu,\"skipped_held\":%zu,\"mode\":\"%s\",\"speed\":%g,\n", items.size(), skipped,
+                skippedTimed, o.fast ? "fast" : "timed", o.fast ? 0.0 : o.speed);
+    std::printf(" \"original_s\":%.3f,\"elapsed_s\":%.3f,\"rate_cps\":%.1f,\n", span, elapsed, (double)items.size() / elapsed);
+    std::printf(" \"acked\":%zu,\"errors\":%zu,\"timeouts\":%zu,\"status_mismatch\":%zu,\n", acked, errors, timeouts, mismatched);
+    std::printf(" \"ack_latency_ms\":%s,\n \"original_ack_latency_ms\":%s}\n", percentiles(lat).c_str(), percentiles(origLat).c_str());
+    return mismatched || timeouts ? 3 : 0;
+}